@@ -2,10 +2,74 @@
 #define SPLOT_BOARD_HPP
 
 #include <cassert>
-#include <cstring>
+#include <cstdint>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// The board's shape is fixed when the program is built, so that every table
+// and mask that depends on it is worked out by the compiler. Build with
+// -DSPLOT_BOARD_SIZE=N for an N x N board (5 to 8; the default is 7), and
+// with -DSPLOT_BLOCKED_SQUARES='"c3 e3 c5 e5"' (square names as in move
+// notation, separated by spaces) to make squares impassable: nothing can
+// move into them, though jumps can go over them.
+#ifndef SPLOT_BOARD_SIZE
+#define SPLOT_BOARD_SIZE 7
+#endif
+#ifndef SPLOT_BLOCKED_SQUARES
+#define SPLOT_BLOCKED_SQUARES ""
+#endif
 
-const int BOARD_SIZE = 7;
+const int BOARD_SIZE = SPLOT_BOARD_SIZE;
 const int NUM_SQUARES = BOARD_SIZE*BOARD_SIZE;
+static_assert(BOARD_SIZE >= 5 && BOARD_SIZE <= 8, "the board must be 5x5 to 8x8 to fit in a bitboard");
+
+constexpr const char* BLOCKED_SQUARE_NAMES = SPLOT_BLOCKED_SQUARES;
+
+// Every name in BLOCKED_SQUARE_NAMES is a square on the board
+constexpr bool checkBlockedSquareNames()
+{
+    const char* names = BLOCKED_SQUARE_NAMES;
+    int i = 0;
+    while(names[i] != '\0') {
+        if(names[i] == ' ') {
+            ++i;
+            continue;
+        }
+        if(names[i] < 'a' || names[i] >= 'a' + BOARD_SIZE || names[i + 1] < '1' || names[i + 1] >= '1' + BOARD_SIZE
+            || (names[i + 2] != ' ' && names[i + 2] != '\0'))
+        {
+            return false;
+        }
+        i += 2;
+    }
+    return true;
+}
+
+static_assert(checkBlockedSquareNames(), "SPLOT_BLOCKED_SQUARES must be square names separated by spaces");
+
+// Bit y*BOARD_SIZE + x is set for each blocked square (x, y), as in a bitboard
+constexpr std::uint64_t makeBlockedSquareMask()
+{
+    const char* names = BLOCKED_SQUARE_NAMES;
+    std::uint64_t mask = 0;
+    for(int i = 0; names[i] != '\0'; ++i) {
+        if(names[i] != ' ') {
+            mask |= std::uint64_t(1) << ((names[i + 1] - '1')*BOARD_SIZE + (names[i] - 'a'));
+            ++i;
+        }
+    }
+    return mask;
+}
+
+constexpr int countBlockedSquares(std::uint64_t mask)
+{
+    return mask ? 1 + countBlockedSquares(mask & (mask - 1)) : 0;
+}
+
+constexpr std::uint64_t BLOCKED_SQUARE_MASK = makeBlockedSquareMask();
+const bool HAS_BLOCKED_SQUARES = BLOCKED_SQUARE_MASK != 0;
+const int NUM_PLAYABLE_SQUARES = NUM_SQUARES - countBlockedSquares(BLOCKED_SQUARE_MASK);
 
 // Order matters! calcHash assumes EMPTY_SQUARE = 0, etc.
 enum Player
@@ -18,62 +82,104 @@ enum Player
     PLAYER4
 };
 
+const int MAX_PLAYERS = 4;
+
 struct Coord
 {
     int x, y;
 
-    Coord(int x_=0, int y_=0)
+    constexpr Coord(int x_=0, int y_=0)
+        : x(x_),
+          y(y_)
     {
-        x = x_;
-        y = y_;
     }
 
-    bool operator==(const Coord& rhs) const
+    constexpr bool operator==(const Coord& rhs) const
     {
         return x == rhs.x && y == rhs.y;
     }
 
-    bool operator!=(const Coord& rhs) const
+    constexpr bool operator!=(const Coord& rhs) const
     {
         return !(*this == rhs);
     }
 };
 
+// Each player's pieces are kept as a bitboard, bit y*BOARD_SIZE + x for the
+// square (x, y), as in the engine, so that copying a board, counting its pieces
+// and handing it to the engine take a few instructions.
 class Board
 {
   public:
-    Board() {}
+    // What operator() gives for a square of a board that can be changed: it
+    // reads as the Player there, and assigning a Player to it moves them in
+    class Square
+    {
+      public:
+        Square(std::uint64_t* pieces, int square_num)
+            : m_pieces(pieces),
+              m_bit(std::uint64_t(1) << square_num)
+        {
+        }
+
+        operator Player() const
+        {
+            return findPlayer(m_pieces, m_bit);
+        }
 
-    Board(const Board& other)
+        Square& operator=(Player player)
+        {
+            assert(player >= EMPTY_SQUARE && player < PLAYER1 + MAX_PLAYERS);
+            assert(player == EMPTY_SQUARE || !(m_bit & BLOCKED_SQUARE_MASK));
+            for(int i = 0; i < MAX_PLAYERS; ++i) {
+                m_pieces[i] &= ~m_bit;
+            }
+            if(player != EMPTY_SQUARE) {
+                m_pieces[player - PLAYER1] |= m_bit;
+            }
+            return *this;
+        }
+
+        // Copies the player there, not the square
+        Square& operator=(const Square& other)
+        {
+            return *this = Player(other);
+        }
+
+      private:
+        std::uint64_t* m_pieces;
+        std::uint64_t m_bit;
+    };
+
+    // Empty
+    Board()
+        : m_pieces()
     {
-        memcpy(m_boarddata, other.m_boarddata, sizeof(m_boarddata));
     }
 
-    Player &operator()(const Coord& coord)
+    Square operator()(const Coord& coord)
     {
         assert(isInRange(coord));
-        return m_boarddata[coord.y][coord.x];
+        return Square(m_pieces, coord.y*BOARD_SIZE + coord.x);
     }
 
-    Player &operator()(int x, int y)
+    Square operator()(int x, int y)
     {
         return (*this)(Coord(x, y));
     }
 
-    // @TODO@ -- fix duplicate code
-    const Player &operator()(const Coord& coord) const
+    Player operator()(const Coord& coord) const
     {
         assert(isInRange(coord));
-        return m_boarddata[coord.y][coord.x];
+        return findPlayer(m_pieces, std::uint64_t(1) << (coord.y*BOARD_SIZE + coord.x));
     }
 
-    // @TODO@ -- fix duplicate code
-    const Player &operator()(int x, int y) const
+    Player operator()(int x, int y) const
     {
         return (*this)(Coord(x, y));
     }
 
-    static bool isInRange(const Coord& coord)
+    static constexpr bool isInRange(const Coord& coord)
     {
         return (coord.x >= 0 && coord.x < BOARD_SIZE &&
                 coord.y >= 0 && coord.y < BOARD_SIZE);
@@ -84,21 +190,61 @@ class Board
         return !isInRange(coord);
     }
 
+    // On the board and not blocked. Blocked squares are always EMPTY_SQUARE,
+    // but no piece can move into one.
+    static constexpr bool isPlayable(const Coord& coord)
+    {
+        return isInRange(coord) && !((BLOCKED_SQUARE_MASK >> (coord.y*BOARD_SIZE + coord.x)) & 1);
+    }
+
+    // player's pieces as a bitboard
+    std::uint64_t getPieces(Player player) const
+    {
+        assert(player >= PLAYER1 && player < PLAYER1 + MAX_PLAYERS);
+        return m_pieces[player - PLAYER1];
+    }
+
+    // Replaces player's pieces with those in pieces. Keeping the players off
+    // each other's squares, and off blocked ones, is up to the caller.
+    void setPieces(Player player, std::uint64_t pieces)
+    {
+        assert(player >= PLAYER1 && player < PLAYER1 + MAX_PLAYERS);
+        assert(!(pieces & BLOCKED_SQUARE_MASK));
+        m_pieces[player - PLAYER1] = pieces;
+    }
+
+    // Everybody's pieces as a bitboard
+    std::uint64_t getOccupied() const
+    {
+        return m_pieces[0] | m_pieces[1] | m_pieces[2] | m_pieces[3];
+    }
+
     int countPieces(Player player) const
     {
-        int count = 0;
-        for(int y = 0; y < BOARD_SIZE; ++y) {
-            for(int x = 0; x < BOARD_SIZE; ++x) {
-                if(m_boarddata[y][x] == player) {
-                    ++count;
-                }
+#ifdef _MSC_VER
+        return int(__popcnt64(getPieces(player)));
+#else
+        return __builtin_popcountll(getPieces(player));
+#endif
+    }
+
+  private:
+    static Player findPlayer(const std::uint64_t* pieces, std::uint64_t bit)
+    {
+        for(int i = 0; i < MAX_PLAYERS; ++i) {
+            if(pieces[i] & bit) {
+                return Player(PLAYER1 + i);
             }
         }
-        return count;
+        return EMPTY_SQUARE;
     }
 
-  private:
-    Player m_boarddata[BOARD_SIZE][BOARD_SIZE];
+    std::uint64_t m_pieces[MAX_PLAYERS];    // m_pieces[i] is player i + 1's
 };
 
+// The start position has pieces in the corners
+static_assert(Board::isPlayable(Coord(0, 0)) && Board::isPlayable(Coord(BOARD_SIZE - 1, 0))
+              && Board::isPlayable(Coord(0, BOARD_SIZE - 1)) && Board::isPlayable(Coord(BOARD_SIZE - 1, BOARD_SIZE - 1)),
+              "corners can't be blocked");
+
 #endif
@@ -8,11 +8,11 @@
 
 using namespace std;
 
-extern mt19937 g_rng;
+extern thread_local mt19937 g_rng;
 
-int random_move(const Board& board, const std::vector<int>& square_order, const std::vector<int>& jump_order, Move& move_out, int& nodes_searched)
+int random_move(const Board& board, const std::vector<int>& square_order, const std::vector<int>& jump_order, Move& move_out, long long& nodes_searched)
 {
-    vector<Move> moves;
+    MoveList moves;
     // @TODO@ -- assumes AI is PLAYER2
     findAllPossibleMoves(board, PLAYER2, moves);
     assert(moves.size() > 0);
@@ -20,16 +20,19 @@ int random_move(const Board& board, const std::vector<int>& square_order, const
     return 0;
 }
 
-int mtdf_impl(const Board& board, int depth, int f, const std::vector<int>& square_order, const std::vector<int>& jump_order, Move& move_out, int& nodes_searched, NegamaxRootFuncPtr fp_negamax_root)
+int mtdf_impl(const Board& board, int depth, int f, const std::vector<int>& square_order, const std::vector<int>& jump_order, Move& move_out, SearchState& ss, NegamaxRootFuncPtr fp_negamax_root)
 {
     int score = f;
-    int lower_bound = -INFINITY;
-    int upper_bound = INFINITY;
+    int lower_bound = -INFINITE_SCORE;
+    int upper_bound = INFINITE_SCORE;
     int beta;
     do {
         Move move;
         beta = (score == lower_bound) ? (score + 1) : score;
-        score = fp_negamax_root(board, depth, beta - 1, beta, square_order, jump_order, move, nodes_searched);
+        score = fp_negamax_root(board, depth, beta - 1, beta, square_order, jump_order, move, ss);
+        if(ss.isAborted()) {
+            break;
+        }
         if(score < beta) {
             // Failed low
             upper_bound = score;
@@ -1,19 +1,91 @@
 #ifndef SPLOT_NEGAMAX_HPP
 #define SPLOT_NEGAMAX_HPP
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
 #include <vector>
 #include "Board.hpp"
 #include "moves.hpp"
+#include "movegen_bb.hpp"
+#include "eval.hpp"
 
 const bool ENABLE_RANDOMNESS = false;
-const bool ENABLE_ALPHA_BETA = true;
-const bool ENABLE_ZOBRIST = true;
-const int MAX_PLY = 9;                  // must be > 0
-const bool ENABLE_BEST_FIRST = true;
-const bool ENABLE_NULL_MOVE = false;
-const bool ENABLE_FUTILITY = true;
-const int FUTILITY_THRESHOLD = 16;      // player's score can increase at most by 16 on a turn w/ current scoring method (player gains 8 pieces, opponent loses 8 pieces)
-const bool CLEAR_ZOBRIST_EVERY_TIME = true;
+const int MAX_PLY = 9;                  // must be > 0; default depth when there's no time limit
+const int MAX_SEARCH_DEPTH = 64;        // deepest a timed search will go; must be < INFINITE_PLY
+
+// Features of the bitboard search. The search is a template over one of these,
+// so every combination gets its own copy with the unused features compiled
+// out. Variations override just what they change. The combinations you can
+// actually pick are registered in SEARCH_CONFIGS.
+struct DefaultSearchPolicy
+{
+    static const bool ALPHA_BETA = true;
+    static const bool ZOBRIST = true;
+    static const bool BEST_FIRST = true;
+    static const bool NULL_MOVE = false;
+    static const bool FUTILITY = true;
+    static const int FUTILITY_THRESHOLD = 16;      // in pieces: player's score can increase at most by 16 on a turn w/ current scoring method (player gains 8 pieces, opponent loses 8 pieces)
+    static const bool CANONICAL_HASH = false;       // see SymmetrySearchPolicy
+    static const bool PVS = false;                  // see PvsSearchPolicy
+    static const bool MOVE_HISTORY = true;          // killers, countermoves and history (see SearchState)
+    static const bool BATCH_FRONTIER = true;        // see evalChildrenBB
+};
+
+struct NullMoveSearchPolicy : DefaultSearchPolicy
+{
+    static const bool NULL_MOVE = true;
+};
+
+struct NoFutilitySearchPolicy : DefaultSearchPolicy
+{
+    static const bool FUTILITY = false;
+};
+
+struct NoZobristSearchPolicy : DefaultSearchPolicy
+{
+    static const bool ZOBRIST = false;
+    static const bool BEST_FIRST = false;       // the best move comes from the table
+};
+
+// Positions that are mirror images or rotations of each other share a table
+// entry (see calcCanonicalHashBB), as long as they have no more than
+// CANONICAL_HASH_MAX_PIECES pieces on the board.
+struct SymmetrySearchPolicy : DefaultSearchPolicy
+{
+    static const bool CANONICAL_HASH = true;
+};
+
+// Moves within each stage in square_order, as they're generated
+struct StaticOrderSearchPolicy : DefaultSearchPolicy
+{
+    static const bool MOVE_HISTORY = false;
+};
+
+// One ply from the frontier, each child is searched (and counted as a node) in turn
+struct NoBatchSearchPolicy : DefaultSearchPolicy
+{
+    static const bool BATCH_FRONTIER = false;
+};
+
+struct MinimaxSearchPolicy : NoZobristSearchPolicy
+{
+    static const bool ALPHA_BETA = false;
+    static const bool FUTILITY = false;
+    static const bool BATCH_FRONTIER = false;
+};
+
+// Principal variation search: any policy plus zero-window searches for every
+// move after the first, which are only searched again with the full window if
+// they turn out better. Also collects the principal variation as it goes (see
+// SearchState). Used by pvs_bb.
+template<class Policy>
+struct PvsSearchPolicy : Policy
+{
+    static const bool PVS = Policy::ALPHA_BETA;
+};
 
 // Largest value that fits in transposition table's "depth" field.
 // Used when the exact score of a position is known (i.e. the game is over).
@@ -26,22 +98,366 @@ const int INFINITE_PLY = 0x7f;
 // That means this value is 1 greater than the R conventionally used.
 const int NULL_MOVE_REDUCTION = 2;
 
+// Symmetric positions mostly turn up in the opening, and working out the
+// canonical hash costs much more than updating the hash, so crowded boards
+// keep their ordinary hash. Whether a position is canonicalized depends only on
+// the position, so it always gets the same entry.
+const int CANONICAL_HASH_MAX_PIECES = 8;
+
 // Arbitrary value. Should fit into a short (for transposition table). It's
 // tempting to use SHRT_MIN for -inf, but this is wrong, because -SHRT_MIN is
 // still SHRT_MIN! (Thanks, two's complement.)
-const int INFINITY = 0x7fff;
+const int INFINITE_SCORE = 0x7fff;
 
-// Must be within the bounds of INFINITY and -INFINITY.
+// Must be within the bounds of INFINITE_SCORE and -INFINITE_SCORE.
 const int WIN = 10000;
 const int LOSS = -WIN;
+static_assert(MAX_EVAL_SCORE < WIN, "evaluations must not look like won games");
+
+// Every position this near the end solves in well under a second (see
+// benchEndgameSolver)
+const int DEFAULT_SOLVER_EMPTIES = 4;
+
+// The endgame solver may spend this fraction of a move's time and nodes. If it
+// runs out, the ordinary search gets what's left.
+const int SOLVER_BUDGET_DIVISOR = 4;
+
+// Time control. With a clock, each move is budgeted the remaining time divided
+// by this, plus the increment. The search may overrun its budget by up to
+// CLOCK_MAX_OVERRUN times to finish an iteration, but never eats into the last
+// CLOCK_SAFETY_MARGIN_MS on the clock.
+const int CLOCK_MOVES_TO_GO = 30;
+const int CLOCK_MAX_OVERRUN = 2;
+const int CLOCK_SAFETY_MARGIN_MS = 50;
+
+// The clock is only read this often (in nodes); must be a power of two
+const int CLOCK_POLL_INTERVAL = 256;
+
+// pvs_bb searches each iteration with a window this many pieces either side of
+// the previous iteration's score, widening it (by twice as much each time) as
+// long as the score falls outside
+const int ASPIRATION_WINDOW = 2;
+
+// See SearchState::feature_swing
+const int FEATURE_SWING = 8;
+
+// Longest principal variation reported to the iteration callback
+const int MAX_PV_LENGTH = 16;
+
+// How much longer an iteration is assumed to take than the one before it, when
+// deciding whether another one will fit in the time left. The ratio actually
+// measured is used if it's larger, up to the maximum.
+const double MIN_ITERATION_GROWTH = 2.0;
+const double MAX_ITERATION_GROWTH = 10.0;
+
+// What a search may spend. 0 means no limit.
+struct SearchLimits
+{
+    int depth = MAX_PLY;
+    long long nodes = 0;            // Counts the main thread's nodes only, so it's reproducible with one thread
+    int move_time_ms = 0;           // Fixed time for every move
+    int clock_ms = 0;               // Time left on the AI's clock; ignored if move_time_ms is set
+    int increment_ms = 0;           // Time added to the clock after every move
+
+    // If set, the search stops when this becomes true, as if it had run out of
+    // time. For stopping a search from another thread.
+    const std::atomic<bool>* stop_request = nullptr;
+
+    // If set, the search is pondering as long as this is true: it searches on
+    // the opponent's time, so the time limits don't apply yet. When it
+    // becomes false (the move pondered was played), the clock starts, as if
+    // the search had only just begun.
+    const std::atomic<bool>* pondering = nullptr;
+
+    // Positions with at most this many empty squares are solved to the end
+    // (see solveEndgameBB) instead of searched. 0 turns the solver off.
+    int solve_empties = DEFAULT_SOLVER_EMPTIES;
+
+    // How the search scores the positions it stops at (see eval.hpp)
+    EvalWeights eval_weights = MATERIAL_EVAL_WEIGHTS;
+};
+
+// A search's limits, worked out when it starts. The deadlines are only set
+// once the clock starts (see checkClock).
+struct SearchBudget
+{
+    long long nodes = 0;
+    const std::atomic<bool>* stop_request = nullptr;
+    const std::atomic<bool>* pondering = nullptr;
+    bool timed = false;
+    bool clock_running = false;
+    std::chrono::milliseconds target_time{0};
+    std::chrono::milliseconds max_time{0};
+    std::chrono::steady_clock::time_point start;
+    std::chrono::steady_clock::time_point soft_deadline;    // Don't start another iteration after this
+    std::chrono::steady_clock::time_point hard_deadline;    // Abort the search in progress at this point
+
+    // Starts the clock if it isn't running and the search isn't pondering.
+    // Returns false if the time limits don't apply yet.
+    bool checkClock()
+    {
+        if(!clock_running && !(pondering && pondering->load(std::memory_order_relaxed))) {
+            // If half the time is gone, there's little hope of finishing another
+            // iteration, which takes longer than all the ones before it put together
+            std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+            soft_deadline = now + target_time / 2;
+            hard_deadline = now + max_time;
+            clock_running = true;
+        }
+        return clock_running;
+    }
+};
+
+// Where the move that caused a beta cutoff came from (see SearchStats)
+enum CutoffStage
+{
+    CUTOFF_NULL_MOVE,
+    CUTOFF_TT_MOVE,
+    CUTOFF_CLONES,                      // The stages of StagedMoveGenBB, in its order
+    CUTOFF_CAPTURING_JUMPS,
+    CUTOFF_QUIET_JUMPS,
+    NUM_CUTOFF_STAGES
+};
+
+extern const char* const CUTOFF_STAGE_NAMES[NUM_CUTOFF_STAGES];
+
+// Beta cutoffs are counted by how many moves the node had searched, this one
+// included; the last slot is for this many or more
+const int NUM_CUTOFF_MOVE_SLOTS = 8;
+
+// One iteration of an iterative deepening search
+struct IterationStats
+{
+    int depth;
+    long long nodes;
+    long long root_searches;            // More than one for MTD(f) passes and aspiration re-searches
+    double secs;
+    bool completed;                     // False if the search was stopped during it
+};
+
+// Counters kept by each search thread. They're plain counters in the thread's
+// own SearchState, so keeping them costs next to nothing; the threads' counts
+// are only added up once the search is over. Arrays indexed by depth count by
+// the depth left to search at the node, as negamax_bb_impl's depth parameter.
+struct SearchStats
+{
+    long long nodes[MAX_SEARCH_DEPTH + 1] = {};
+    long long solver_nodes = 0;                         // Nodes of solveEndgameBB
+    long long tt_probes[MAX_SEARCH_DEPTH + 1] = {};
+    long long tt_hits[MAX_SEARCH_DEPTH + 1] = {};       // Probes that found an entry for the position, of any depth
+    long long tt_cutoffs[MAX_SEARCH_DEPTH + 1] = {};    // Hits whose bounds settled the node without a search
+    long long futility_prunes = 0;
+    long long frontier_batches = 0;                     // Frontier nodes whose children were evaluated in one pass
+    long long cutoffs_by_move[NUM_CUTOFF_MOVE_SLOTS] = {};
+    long long cutoffs_by_stage[NUM_CUTOFF_STAGES] = {};
+    long long root_searches = 0;
+
+    // Each thread's own iterations; add leaves these alone, so the totals
+    // have the main thread's
+    int num_iterations = 0;
+    IterationStats iterations[MAX_SEARCH_DEPTH];
+
+    long long totalNodes() const
+    {
+        return sumByDepth(nodes) + solver_nodes;
+    }
+
+    static long long sumByDepth(const long long counts[MAX_SEARCH_DEPTH + 1])
+    {
+        long long sum = 0;
+        for(int depth = 0; depth <= MAX_SEARCH_DEPTH; ++depth) {
+            sum += counts[depth];
+        }
+        return sum;
+    }
+
+    void add(const SearchStats& other)
+    {
+        for(int depth = 0; depth <= MAX_SEARCH_DEPTH; ++depth) {
+            nodes[depth] += other.nodes[depth];
+            tt_probes[depth] += other.tt_probes[depth];
+            tt_hits[depth] += other.tt_hits[depth];
+            tt_cutoffs[depth] += other.tt_cutoffs[depth];
+        }
+        solver_nodes += other.solver_nodes;
+        futility_prunes += other.futility_prunes;
+        frontier_batches += other.frontier_batches;
+        for(int slot = 0; slot < NUM_CUTOFF_MOVE_SLOTS; ++slot) {
+            cutoffs_by_move[slot] += other.cutoffs_by_move[slot];
+        }
+        for(int stage = 0; stage < NUM_CUTOFF_STAGES; ++stage) {
+            cutoffs_by_stage[stage] += other.cutoffs_by_stage[stage];
+        }
+        root_searches += other.root_searches;
+    }
+
+    // move_number is 1 for the first move the node searched. The null move
+    // only counts towards its stage.
+    void recordCutoff(CutoffStage stage, int move_number)
+    {
+        ++cutoffs_by_stage[stage];
+        if(stage != CUTOFF_NULL_MOVE) {
+            ++cutoffs_by_move[std::min(move_number, NUM_CUTOFF_MOVE_SLOTS) - 1];
+        }
+    }
+};
+
+// Moves are only ordered by their history this far from the frontier, and only
+// cutoffs this far away are recorded. Nearer, sorting a stage costs more than
+// searching all of it.
+const int ORDERING_MIN_DEPTH = 2;
+
+// Once a move's history score gets this high, all of them are halved. That
+// keeps the table weighted towards recent cutoffs, and the scores below the
+// ordering bonuses of killers and countermoves (see movegen_bb.hpp).
+const int HISTORY_LIMIT = 1 << 16;
+
+// Bookkeeping carried down the tree by one search thread. Each thread has its own.
+struct SearchState
+{
+    long long nodes_searched = 0;
+    SearchStats stats;
+
+    // If non-null, the search unwinds as soon as this becomes true. The result
+    // of an aborted search is garbage and must not be used.
+    std::atomic<bool>* stop = nullptr;
+
+    // Only the main thread has a budget; the helpers stop when it does. The
+    // budget is only enforced once there's a move to fall back on.
+    SearchBudget* budget = nullptr;
+    bool have_move = false;
+
+    // XORed into every position's hash (see setSearchTableKey)
+    std::uint64_t table_key = 0;
+
+    // How positions are scored, from the search limits. Margins that are
+    // given in pieces, like FUTILITY_THRESHOLD, are multiplied by piece_value;
+    // feature_swing is added to allow for the other features, which can
+    // change by about FEATURE_SWING times their weight with a move.
+    const EvalWeights* eval_weights = &MATERIAL_EVAL_WEIGHTS;
+    bool pieces_only_eval = true;
+    int piece_value = 1;
+    int feature_swing = 0;
+
+    // Distance from the root. PVS policies keep the best line found from each
+    // ply in pv[ply], so pv[0] is the principal variation once the search is done.
+    int ply = 0;
+    int pv_length[MAX_SEARCH_DEPTH + 1] = {};
+    BitboardMove pv[MAX_SEARCH_DEPTH + 1][MAX_SEARCH_DEPTH + 1];
+
+    // For ordering moves, with policies that use MOVE_HISTORY; all of it is
+    // updated when a move causes a beta cutoff. killers[ply] are the last moves
+    // to do that at ply, countermoves the last to do it in reply to each move,
+    // and history adds up depth squared for each move, wherever it was played,
+    // so moves that cut off big subtrees count for more. path[ply] is the move
+    // being searched at ply.
+    BitboardMove killers[MAX_SEARCH_DEPTH + 1][NUM_KILLERS];
+    BitboardMove countermoves[NUM_MOVE_INDICES];
+    int history[NUM_MOVE_INDICES] = {};
+    BitboardMove path[MAX_SEARCH_DEPTH + 1];
+
+    SearchState()
+    {
+        std::fill(&killers[0][0], &killers[0][0] + (MAX_SEARCH_DEPTH + 1) * NUM_KILLERS, BitboardMove(BBMOVE_NONE, 0, 0));
+        std::fill(countermoves, countermoves + NUM_MOVE_INDICES, BitboardMove(BBMOVE_NONE, 0, 0));
+    }
+
+    bool isAborted() const
+    {
+        return stop && stop->load(std::memory_order_relaxed);
+    }
+
+    // Called at every node. Raises the stop flag if the budget has run out.
+    void checkBudget()
+    {
+        if(!budget || !have_move) {
+            return;
+        }
+        if((budget->nodes > 0 && nodes_searched >= budget->nodes)
+            || (budget->stop_request && budget->stop_request->load(std::memory_order_relaxed))
+            || (budget->timed && (nodes_searched & (CLOCK_POLL_INTERVAL - 1)) == 0
+                && budget->checkClock() && std::chrono::steady_clock::now() >= budget->hard_deadline))
+        {
+            stop->store(true, std::memory_order_relaxed);
+        }
+    }
+};
+
+typedef int (*AiFuncPtr)(const Board& board, const std::vector<int>& square_order, const std::vector<int>& jump_order, Move& move_out, long long& nodes_searched);
+typedef int (*NegamaxRootFuncPtr)(const Board& board, int depth, int alpha, int beta, const std::vector<int>& square_order, const std::vector<int>& jump_order, Move& move_out, SearchState& ss);
+
+// A search policy the bitboard searches can be switched to at runtime
+struct SearchConfig
+{
+    const char* name;
+    const char* description;
+    NegamaxRootFuncPtr negamax_root;
+    NegamaxRootFuncPtr pvs_root;            // The same with PvsSearchPolicy, for pvs_bb
+};
+
+extern const SearchConfig SEARCH_CONFIGS[];
+extern const int NUM_SEARCH_CONFIGS;
+
+// Returns nullptr if there's no such config
+const SearchConfig* findSearchConfig(const std::string& name);
+
+// The settings below (config, thread count, limits, table key) and the last
+// search's results are kept per thread, so searches on different threads can
+// be set up differently, e.g. for games played side by side. A new thread
+// starts out with the defaults.
+
+// negamax_bb, negamax_iterative_bb and mtdf_bb use this config. The default is
+// SEARCH_CONFIGS[0].
+void setSearchConfig(const SearchConfig& config);
+const SearchConfig& getSearchConfig();
+
+// Lazy SMP: negamax_iterative_bb and mtdf_bb run this many threads in total
+// (the calling thread plus helpers), all sharing the transposition table.
+void setNumSearchThreads(int num_threads);
+int getNumSearchThreads();
+
+// Limits for the bitboard searches. negamax_bb only obeys the depth, since it
+// has no earlier iteration to fall back on if it's stopped early.
+void setSearchLimits(const SearchLimits& limits);
+const SearchLimits& getSearchLimits();
+
+// Positions go in the transposition table under their hash XORed with this key
+// (0 by default). Searches with different keys share the table's space but
+// never each other's results, as if each had a table of its own.
+void setSearchTableKey(std::uint64_t key);
+
+// Totals over all threads of the most recent bitboard search
+const SearchStats& getLastSearchStats();
+
+// Deepest iteration the most recent bitboard search completed
+int getLastSearchDepth();
+
+// Called by the iterative searches' main thread each time it completes an
+// iteration, with the move and score it found, the main thread's node count so
+// far, and the time since the search started. board is the position searched.
+// pv starts with the move: it's the line the search collected if it's pvs_bb,
+// or else the one getPrincipalVariation finds.
+typedef void (*IterationCallbackPtr)(const Board& board, const Move& move, int depth, int score, long long nodes, double secs, const std::vector<Move>& pv);
+void setIterationCallback(IterationCallbackPtr callback);
+
+// The expected line of play: first_move, then the best moves the transposition
+// table has for the positions after it, up to max_length moves in all.
+// (Assumes player 2 is to move in board, as the searches do.)
+void getPrincipalVariation(const Board& board, const Move& first_move, int max_length, std::vector<Move>& pv);
+
+// Works out a search's limits as it starts (see SearchBudget)
+SearchBudget makeSearchBudget(const SearchLimits& limits);
 
-typedef int (*AiFuncPtr)(const Board& board, const std::vector<int>& square_order, const std::vector<int>& jump_order, Move& move_out, int& nodes_searched);
-typedef int (*NegamaxRootFuncPtr)(const Board& board, int depth, int alpha, int beta, const std::vector<int>& square_order, const std::vector<int>& jump_order, Move& move_out, int& nodes_searched);
+// The Move for bb_move, which is player's move in board. A clone is made from
+// the first of player's pieces next to its destination. BBMOVE_NONE comes out
+// as a move from and to (-1, -1).
+void convBitboardMoveToMove(const Board& board, Player player, BitboardMove bb_move, Move& move);
 
-int random_move(const Board& board, const std::vector<int>& square_order, const std::vector<int>& jump_order, Move& move, int& nodes_searched);
-int mtdf_impl(const Board &board, int depth, int f, const std::vector<int>& square_order, const std::vector<int>& jump_order, Move& move, int& nodes_searched, NegamaxRootFuncPtr fp_negamax_root);
-int negamax_bb(const Board& board, const std::vector<int>& square_order, const std::vector<int>& jump_order, Move& move, int& nodes_searched);
-int negamax_iterative_bb(const Board& board, const std::vector<int>& square_order, const std::vector<int>& jump_order, Move& move, int& nodes_searched);
-int mtdf_bb(const Board& board, const std::vector<int>& square_order, const std::vector<int>& jump_order, Move& move, int& nodes_searched);
+int random_move(const Board& board, const std::vector<int>& square_order, const std::vector<int>& jump_order, Move& move, long long& nodes_searched);
+int mtdf_impl(const Board &board, int depth, int f, const std::vector<int>& square_order, const std::vector<int>& jump_order, Move& move, SearchState& ss, NegamaxRootFuncPtr fp_negamax_root);
+int negamax_bb(const Board& board, const std::vector<int>& square_order, const std::vector<int>& jump_order, Move& move, long long& nodes_searched);
+int negamax_iterative_bb(const Board& board, const std::vector<int>& square_order, const std::vector<int>& jump_order, Move& move, long long& nodes_searched);
+int mtdf_bb(const Board& board, const std::vector<int>& square_order, const std::vector<int>& jump_order, Move& move, long long& nodes_searched);
+int pvs_bb(const Board& board, const std::vector<int>& square_order, const std::vector<int>& jump_order, Move& move, long long& nodes_searched);
 
 #endif
@@ -1,107 +1,578 @@
 #include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <chrono>
+#include <random>
+#include <thread>
 #include <vector>
 
 #include "Board.hpp"
 #include "moves.hpp"
 #include "ai.hpp"
 #include "bitboards.hpp"
+#include "movegen_bb.hpp"
 #include "zobrist.hpp"
+#include "solver.hpp"
 
 namespace
 {
 
-int negamax_bb_root(const Board& board, int depth, int alpha, int beta, const std::vector<int>& square_order, const std::vector<int>& jump_order, Move& move_out, int& nodes_searched);
-int negamax_bb_impl(Bitboard bb_player1, Bitboard bb_player2, int depth,
+thread_local int g_num_search_threads = 1;
+thread_local const SearchConfig* g_search_config = &SEARCH_CONFIGS[0];
+thread_local SearchLimits g_search_limits;
+thread_local ZobristHash g_search_table_key = 0;
+thread_local SearchStats g_last_search_stats;
+thread_local int g_last_search_depth = 0;
+IterationCallbackPtr g_iteration_callback = nullptr;
+
+// Searches one depth of an iterative deepening search. guess is the score from
+// the previous iteration.
+typedef int (*IterationFuncPtr)(const Board& board, int depth, int guess, const std::vector<int>& square_order, const std::vector<int>& jump_order, Move& move_out, SearchState& ss, NegamaxRootFuncPtr negamax_root);
+
+int lazySmpSearch(const Board& board, const std::vector<int>& square_order, const std::vector<int>& jump_order, Move& move_out, long long& nodes_searched, IterationFuncPtr iteration, NegamaxRootFuncPtr negamax_root);
+bool solveEndgame(const Board& board, const SearchBudget& budget, Move& move_out, int& score, SearchState& ss);
+int deepenSearch(const Board& board, int first_depth, int last_depth, const std::vector<int>& square_order, const std::vector<int>& jump_order, Move& move_out, SearchState& ss, IterationFuncPtr iteration, NegamaxRootFuncPtr negamax_root, int& depth_completed);
+int negamaxIteration(const Board& board, int depth, int guess, const std::vector<int>& square_order, const std::vector<int>& jump_order, Move& move_out, SearchState& ss, NegamaxRootFuncPtr negamax_root);
+int mtdfIteration(const Board& board, int depth, int guess, const std::vector<int>& square_order, const std::vector<int>& jump_order, Move& move_out, SearchState& ss, NegamaxRootFuncPtr negamax_root);
+int pvsIteration(const Board& board, int depth, int guess, const std::vector<int>& square_order, const std::vector<int>& jump_order, Move& move_out, SearchState& ss, NegamaxRootFuncPtr negamax_root);
+void getCollectedPrincipalVariation(const Board& board, const SearchState& ss, std::vector<Move>& pv);
+template<class Policy>
+int negamax_bb_root(const Board& board, int depth, int alpha, int beta, const std::vector<int>& square_order, const std::vector<int>& jump_order, Move& move_out, SearchState& ss);
+template<class Policy>
+int negamax_bb_impl(Bitboard bb_player1, Bitboard bb_player2, ZobristHash hash, int depth,
     int alpha, int beta, int player_sign, bool is_root, bool in_null_branch,
     const std::vector<int>& square_order, const std::vector<int>& jump_order,
-    BitboardMove& move_out, int& nodes_searched);
+    BitboardMove& move_out, SearchState& ss);
+template<class Policy>
 bool searchMove(BitboardMove bbmove, int& score, ZobristValue& zv,
-    Bitboard bb_player1, Bitboard bb_player2, Bitboard bb_me,
-    Bitboard bb_him, int depth, int& best_score, int& alpha, int beta,
+    Bitboard bb_me, Bitboard bb_him, ZobristHash hash, int depth, int& best_score, int& alpha, int beta,
     int player_sign, bool in_null_branch, const std::vector<int>& square_order,
     const std::vector<int>& jump_order, BitboardMove& move_out,
-    int& nodes_searched);
-void makeMoveBB(BitboardMove bbmove, Bitboard& me, Bitboard& him);
+    SearchState& ss);
+template<class Policy>
+void storeResultBB(const SearchState& ss, ZobristHash hash, int symmetry, const ZobristValue& zv);
+void recordCutoffBB(BitboardMove bbmove, int depth, SearchState& ss);
+bool evalChildrenBB(Bitboard bb_me, Bitboard bb_him, int& score_out, BitboardMove& move_out);
 bool checkLegalMoveBB(BitboardMove bbmove, Bitboard bb_me, Bitboard bb_empty);
-int evalPositionBB(Bitboard player1, Bitboard player2);
-void convBoardToBitboards(const Board& board, Bitboard& player1, Bitboard& player2);
-void convBitboardMoveToMove(const Board& board, Player player, BitboardMove bb_move, Move& move);
+void setSearchEval(SearchState& ss, const EvalWeights& weights);
+int scoreFinishedGameBB(Bitboard player1, Bitboard player2);
+int evalPositionBB(Bitboard player1, Bitboard player2, const SearchState& ss);
 void convSquareNumToCoord(int square_num, Coord& coord);
 
-inline void handleCaptures(Bitboard capture_radius, Bitboard& me, Bitboard& him)
+}
+
+#define SEARCH_CONFIG(name, description, Policy) \
+    {name, description, negamax_bb_root<Policy>, negamax_bb_root<PvsSearchPolicy<Policy>>}
+
+const SearchConfig SEARCH_CONFIGS[] = {
+    SEARCH_CONFIG("default", "alpha-beta, transposition table, best move first, futility pruning", DefaultSearchPolicy),
+    SEARCH_CONFIG("nullmove", "default plus null move pruning", NullMoveSearchPolicy),
+    SEARCH_CONFIG("nofutility", "default without futility pruning", NoFutilitySearchPolicy),
+    SEARCH_CONFIG("nott", "default without the transposition table", NoZobristSearchPolicy),
+    SEARCH_CONFIG("symmetry", "default, with mirror images and rotations sharing table entries", SymmetrySearchPolicy),
+    SEARCH_CONFIG("staticorder", "default without killer, countermove and history move ordering", StaticOrderSearchPolicy),
+    SEARCH_CONFIG("nobatch", "default, searching the frontier's children one at a time", NoBatchSearchPolicy),
+    SEARCH_CONFIG("minimax", "plain minimax: no pruning, no transposition table (slow!)", MinimaxSearchPolicy)
+};
+
+#undef SEARCH_CONFIG
+
+const int NUM_SEARCH_CONFIGS = sizeof(SEARCH_CONFIGS) / sizeof(SEARCH_CONFIGS[0]);
+
+const char* const CUTOFF_STAGE_NAMES[NUM_CUTOFF_STAGES] = {
+    "null_move",
+    "tt_move",
+    "clones",
+    "capturing_jumps",
+    "quiet_jumps"
+};
+
+const SearchConfig* findSearchConfig(const std::string& name)
+{
+    for(int i = 0; i < NUM_SEARCH_CONFIGS; ++i) {
+        if(name == SEARCH_CONFIGS[i].name) {
+            return &SEARCH_CONFIGS[i];
+        }
+    }
+    return nullptr;
+}
+
+void setSearchConfig(const SearchConfig& config)
+{
+    g_search_config = &config;
+}
+
+const SearchConfig& getSearchConfig()
 {
-    Bitboard captures = him & capture_radius;
-    me |= captures;
-    him &= ~captures;
+    return *g_search_config;
 }
 
+void setNumSearchThreads(int num_threads)
+{
+    assert(num_threads > 0);
+    g_num_search_threads = num_threads;
 }
 
-int negamax_bb(const Board& board, const std::vector<int>& square_order, const std::vector<int>& jump_order, Move& move_out, int& nodes_searched)
+int getNumSearchThreads()
 {
-    return negamax_bb_root(board, MAX_PLY, -INFINITY, INFINITY, square_order, jump_order, move_out, nodes_searched);
+    return g_num_search_threads;
 }
 
-int negamax_iterative_bb(const Board& board, const std::vector<int>& square_order, const std::vector<int>& jump_order, Move& move_out, int& nodes_searched)
+void setSearchLimits(const SearchLimits& limits)
 {
+    assert(limits.depth > 0 && limits.depth <= MAX_SEARCH_DEPTH);
+    assert(limits.solve_empties >= 0 && limits.solve_empties <= MAX_SOLVER_EMPTIES);
+    g_search_limits = limits;
+}
+
+const SearchLimits& getSearchLimits()
+{
+    return g_search_limits;
+}
+
+void setSearchTableKey(std::uint64_t key)
+{
+    g_search_table_key = key;
+}
+
+const SearchStats& getLastSearchStats()
+{
+    return g_last_search_stats;
+}
+
+int getLastSearchDepth()
+{
+    return g_last_search_depth;
+}
+
+void setIterationCallback(IterationCallbackPtr callback)
+{
+    g_iteration_callback = callback;
+}
+
+void getPrincipalVariation(const Board& board, const Move& first_move, int max_length, std::vector<Move>& pv)
+{
+    pv.clear();
+    if(max_length <= 0 || !checkLegalMove(board, PLAYER2, first_move)) {
+        return;
+    }
+    pv.push_back(first_move);
+    Board position(board);
+    makeMove(position, first_move);
+    Player player = PLAYER1;
+    int player_sign = -1;
+    while(int(pv.size()) < max_length) {
+        Bitboard bb_player1, bb_player2;
+        convBoardToBitboards(position, bb_player1, bb_player2);
+        Bitboard bb_me = (player == PLAYER1) ? bb_player1 : bb_player2;
+        Bitboard bb_empty = invertBitboard(bb_player1 | bb_player2);
+        // The table may have been overwritten since, so make sure the move is legal
+        BitboardMove bbmove = getZobristValueBB(calcHashBB(bb_player1, bb_player2, player_sign) ^ g_search_table_key).best_move;
+        if(bbmove.move_type == BBMOVE_NONE || !checkLegalMoveBB(bbmove, bb_me, bb_empty)) {
+            // Maybe the search stored it under the canonical hash
+            int symmetry;
+            ZobristHash hash = calcCanonicalHashBB(bb_player1, bb_player2, player_sign, symmetry) ^ g_search_table_key;
+            bbmove = transformMoveBB(getZobristValueBB(hash).best_move, INVERSE_SYMMETRIES[symmetry]);
+            if(bbmove.move_type == BBMOVE_NONE || !checkLegalMoveBB(bbmove, bb_me, bb_empty)) {
+                break;
+            }
+        }
+        Move move;
+        convBitboardMoveToMove(position, player, bbmove, move);
+        pv.push_back(move);
+        makeMove(position, move);
+        player = (player == PLAYER1) ? PLAYER2 : PLAYER1;
+        player_sign = -player_sign;
+    }
+}
+
+int negamax_bb(const Board& board, const std::vector<int>& square_order, const std::vector<int>& jump_order, Move& move_out, long long& nodes_searched)
+{
+    SearchState ss;
+    ss.table_key = g_search_table_key;
+    setSearchEval(ss, g_search_limits.eval_weights);
+    // The search itself only stops at the depth, but the solver has to stop in time
+    SearchBudget budget = makeSearchBudget(g_search_limits);
     int score;
-    for(int depth = 1; depth <= MAX_PLY; ++depth) {
-        score = negamax_bb_root(board, depth, -INFINITY, INFINITY, square_order, jump_order, move_out, nodes_searched);
+    if(solveEndgame(board, budget, move_out, score, ss)) {
+        nodes_searched += ss.nodes_searched;
+        g_last_search_stats = ss.stats;
+        return score;
     }
+    score = g_search_config->negamax_root(board, g_search_limits.depth, -INFINITE_SCORE, INFINITE_SCORE, square_order, jump_order, move_out, ss);
+    nodes_searched += ss.nodes_searched;
+    g_last_search_stats = ss.stats;
+    g_last_search_depth = g_search_limits.depth;
     return score;
 }
 
-int mtdf_bb(const Board& board, const std::vector<int>& square_order, const std::vector<int>& jump_order, Move& move_out, int& nodes_searched)
+int negamax_iterative_bb(const Board& board, const std::vector<int>& square_order, const std::vector<int>& jump_order, Move& move_out, long long& nodes_searched)
+{
+    return lazySmpSearch(board, square_order, jump_order, move_out, nodes_searched, negamaxIteration, g_search_config->negamax_root);
+}
+
+int mtdf_bb(const Board& board, const std::vector<int>& square_order, const std::vector<int>& jump_order, Move& move_out, long long& nodes_searched)
+{
+    return lazySmpSearch(board, square_order, jump_order, move_out, nodes_searched, mtdfIteration, g_search_config->negamax_root);
+}
+
+int pvs_bb(const Board& board, const std::vector<int>& square_order, const std::vector<int>& jump_order, Move& move_out, long long& nodes_searched)
+{
+    return lazySmpSearch(board, square_order, jump_order, move_out, nodes_searched, pvsIteration, g_search_config->pvs_root);
+}
+
+SearchBudget makeSearchBudget(const SearchLimits& limits)
+{
+    using namespace std::chrono;
+    SearchBudget budget;
+    budget.nodes = limits.nodes;
+    budget.stop_request = limits.stop_request;
+    budget.pondering = limits.pondering;
+    budget.start = steady_clock::now();
+    int target_ms = 0;
+    int max_ms = 0;
+    if(limits.move_time_ms > 0) {
+        target_ms = max_ms = limits.move_time_ms;
+    } else if(limits.clock_ms > 0) {
+        int usable_ms = std::max(1, limits.clock_ms - CLOCK_SAFETY_MARGIN_MS);
+        target_ms = std::min(usable_ms, limits.clock_ms / CLOCK_MOVES_TO_GO + limits.increment_ms);
+        max_ms = std::min(usable_ms, target_ms * CLOCK_MAX_OVERRUN);
+    }
+    if(target_ms > 0) {
+        budget.timed = true;
+        budget.target_time = milliseconds(target_ms);
+        budget.max_time = milliseconds(max_ms);
+        budget.checkClock();
+    }
+    return budget;
+}
+
+void convBitboardMoveToMove(const Board& board, Player player, BitboardMove bb_move, Move& move)
 {
-    int f = 0;
-    for(int depth = 1; depth <= MAX_PLY; ++depth) {
-        f = mtdf_impl(board, depth, f, square_order, jump_order, move_out, nodes_searched, negamax_bb_root);
+    switch(bb_move.move_type) {
+      case BBMOVE_CLONE:
+        convSquareNumToCoord(bb_move.square, move.dst);
+        for(int y = move.dst.y - 1; y <= move.dst.y + 1; ++y) {
+            for(int x = move.dst.x - 1; x <= move.dst.x + 1; ++x) {
+                Coord coord(x, y);
+                if(board.isInRange(coord) && board(x, y) == player) {
+                    move.src = coord;
+                    return;
+                }
+            }
+        }
+        // We only get here if a clone move was generated, but no friendly
+        // piece neighbors the destination square
+        assert(false);
+
+      case BBMOVE_JUMP:
+        convSquareNumToCoord(bb_move.square, move.src);
+        move.dst.x = move.src.x + JUMP_COORDS[bb_move.jump_type].x;
+        move.dst.y = move.src.y + JUMP_COORDS[bb_move.jump_type].y;
+        break;
+
+      case BBMOVE_NONE:
+        // MTD(f) will generate this when negamax fails low.
+        // So we can't assert(false) here.
+        // What we can do, though, is mark this move and check for it
+        // when it isn't expected.
+        move.src.x = move.src.y = move.dst.x = move.dst.y = -1;
+        break;
+
+      default:
+        assert(false);
     }
-    return f;
 }
 
 
 namespace
 {
 
-int negamax_bb_root(const Board& board, int depth, int alpha, int beta, const std::vector<int>& square_order, const std::vector<int>& jump_order, Move& move_out, int& nodes_searched)
+// Lazy SMP. The helper threads run the same search as the main thread, sharing
+// nothing but the transposition table. They don't coordinate at all; what makes
+// them useful is that they fill the table with results the main thread would
+// otherwise have to compute itself. To keep them from all searching the same
+// nodes in lockstep, every other helper starts one ply deeper and each helper
+// uses its own square order. Only the main thread's move and score are used,
+// and only the main thread watches the time and node limits. Once the main
+// thread is done, the helpers are told to stop.
+int lazySmpSearch(const Board& board, const std::vector<int>& square_order, const std::vector<int>& jump_order, Move& move_out, long long& nodes_searched, IterationFuncPtr iteration, NegamaxRootFuncPtr negamax_root)
+{
+    SearchBudget budget = makeSearchBudget(g_search_limits);
+    int last_depth = g_search_limits.depth;
+    int num_helpers = g_num_search_threads - 1;
+    std::atomic<bool> stop(false);
+
+    SearchState ss;
+    ss.stop = &stop;
+    ss.budget = &budget;
+    ss.table_key = g_search_table_key;
+    setSearchEval(ss, g_search_limits.eval_weights);
+
+    // The solver runs on this thread alone, before the helpers start. Its
+    // nodes count towards the main thread's.
+    int score;
+    if(solveEndgame(board, budget, move_out, score, ss)) {
+        nodes_searched += ss.nodes_searched;
+        g_last_search_stats = ss.stats;
+        if(g_iteration_callback) {
+            using namespace std::chrono;
+            double secs = duration_cast<duration<double>>(steady_clock::now() - budget.start).count();
+            g_iteration_callback(board, move_out, g_last_search_depth, score, ss.nodes_searched, secs, std::vector<Move>(1, move_out));
+        }
+        return score;
+    }
+    std::vector<SearchState> helper_states(num_helpers);
+    std::vector<std::vector<int>> helper_square_orders(num_helpers, square_order);
+    std::vector<std::thread> helpers;
+    for(int i = 0; i < num_helpers; ++i) {
+        std::mt19937 rng(i);
+        std::shuffle(helper_square_orders[i].begin(), helper_square_orders[i].end(), rng);
+        helper_states[i].stop = &stop;
+        helper_states[i].table_key = g_search_table_key;
+        setSearchEval(helper_states[i], g_search_limits.eval_weights);
+        helpers.emplace_back([&, i]() {
+            Move helper_move;
+            int helper_depth;
+            int first_depth = 1 + (i + 1) % 2;
+            deepenSearch(board, std::min(first_depth, last_depth), last_depth, helper_square_orders[i], jump_order, helper_move, helper_states[i], iteration, negamax_root, helper_depth);
+        });
+    }
+
+    score = deepenSearch(board, 1, last_depth, square_order, jump_order, move_out, ss, iteration, negamax_root, g_last_search_depth);
+    nodes_searched += ss.nodes_searched;
+    g_last_search_stats = ss.stats;
+
+    stop = true;
+    for(int i = 0; i < num_helpers; ++i) {
+        helpers[i].join();
+        nodes_searched += helper_states[i].nodes_searched;
+        g_last_search_stats.add(helper_states[i].stats);
+    }
+    return score;
+}
+
+// The solver's share of a search's budget (see SOLVER_BUDGET_DIVISOR). Its
+// clock starts over, which makes no difference, since the solver goes first.
+SearchBudget makeSolverBudget(const SearchBudget& budget)
+{
+    SearchBudget solver_budget = budget;
+    solver_budget.nodes = (budget.nodes + SOLVER_BUDGET_DIVISOR - 1) / SOLVER_BUDGET_DIVISOR;
+    solver_budget.max_time = budget.target_time / SOLVER_BUDGET_DIVISOR;
+    solver_budget.clock_running = false;
+    if(solver_budget.timed) {
+        solver_budget.checkClock();
+    }
+    return solver_budget;
+}
+
+// Solves the position if it's near enough to the end (see
+// SearchLimits::solve_empties). A won game scores WIN plus the final margin, a
+// lost one LOSS plus the margin (which is negative), and a drawn one 0.
+// Returns false if the position wasn't solved, either because it's too far
+// from the end or because the solver ran out of its share of budget; then
+// it's up to the ordinary search. Counts the solver's nodes in ss.
+bool solveEndgame(const Board& board, const SearchBudget& budget, Move& move_out, int& score, SearchState& ss)
+{
+    Bitboard bb_player1, bb_player2;
+    convBoardToBitboards(board, bb_player1, bb_player2);
+    int num_empty = countSetBits(invertBitboard(bb_player1 | bb_player2));
+    if(num_empty > g_search_limits.solve_empties) {
+        return false;
+    }
+
+    // The solver gets a stop flag of its own, so that stopping it doesn't stop
+    // the search, and its budget applies straight away, since there's always
+    // the search to fall back on
+    SearchBudget solver_budget = makeSolverBudget(budget);
+    std::atomic<bool> solver_stop(false);
+    std::atomic<bool>* search_stop = ss.stop;
+    SearchBudget* search_budget = ss.budget;
+    bool search_have_move = ss.have_move;
+    ss.stop = &solver_stop;
+    ss.budget = &solver_budget;
+    ss.have_move = true;
+    BitboardMove bb_move;
+    int margin;
+    // @TODO@ -- assumes AI is player 2
+    bool solved = solveEndgameBB(bb_player2, bb_player1, true, bb_move, margin, ss);
+    ss.stop = search_stop;
+    ss.budget = search_budget;
+    ss.have_move = search_have_move;
+    if(!solved) {
+        return false;
+    }
+    convBitboardMoveToMove(board, PLAYER2, bb_move, move_out);
+    score = (margin > 0) ? WIN + margin : (margin < 0) ? LOSS + margin : 0;
+    g_last_search_depth = num_empty;
+    return true;
+}
+
+// Iterative deepening, from first_depth to last_depth or until the search is
+// stopped. Returns the score of the deepest iteration completed, whose move is
+// put in move_out; an iteration that was cut short is thrown away.
+int deepenSearch(const Board& board, int first_depth, int last_depth, const std::vector<int>& square_order, const std::vector<int>& jump_order, Move& move_out, SearchState& ss, IterationFuncPtr iteration, NegamaxRootFuncPtr negamax_root, int& depth_completed)
+{
+    using namespace std::chrono;
+    int score = 0;
+    depth_completed = 0;
+    steady_clock::duration last_iteration_time(0);
+    double growth = MIN_ITERATION_GROWTH;
+    for(int depth = first_depth; depth <= last_depth && !ss.isAborted(); ++depth) {
+        steady_clock::time_point iteration_start = steady_clock::now();
+        if(ss.have_move && ss.budget && ss.budget->timed && ss.budget->checkClock()) {
+            // Don't start an iteration we expect to abort; it would be wasted time
+            if(iteration_start >= ss.budget->soft_deadline
+                || iteration_start + duration_cast<steady_clock::duration>(last_iteration_time * growth) >= ss.budget->hard_deadline)
+            {
+                break;
+            }
+        }
+
+        Move move;
+        long long nodes_before = ss.nodes_searched;
+        long long root_searches_before = ss.stats.root_searches;
+        int iteration_score = iteration(board, depth, score, square_order, jump_order, move, ss, negamax_root);
+        steady_clock::duration iteration_time = steady_clock::now() - iteration_start;
+        IterationStats& iteration_stats = ss.stats.iterations[ss.stats.num_iterations++];
+        iteration_stats.depth = depth;
+        iteration_stats.nodes = ss.nodes_searched - nodes_before;
+        iteration_stats.root_searches = ss.stats.root_searches - root_searches_before;
+        iteration_stats.secs = duration_cast<duration<double>>(iteration_time).count();
+        iteration_stats.completed = !ss.isAborted();
+        if(ss.isAborted()) {
+            break;
+        }
+        score = iteration_score;
+        move_out = move;
+        ss.have_move = true;
+        depth_completed = depth;
+        if(ss.budget && g_iteration_callback) {
+            double secs = duration_cast<duration<double>>(steady_clock::now() - ss.budget->start).count();
+            std::vector<Move> pv;
+            if(ss.pv_length[0] > 0) {
+                getCollectedPrincipalVariation(board, ss, pv);
+            } else {
+                getPrincipalVariation(board, move, MAX_PV_LENGTH, pv);
+            }
+            g_iteration_callback(board, move, depth, score, ss.nodes_searched, secs, pv);
+        }
+
+        if(last_iteration_time.count() > 0) {
+            double ratio = double(iteration_time.count()) / last_iteration_time.count();
+            growth = std::min(MAX_ITERATION_GROWTH, std::max(MIN_ITERATION_GROWTH, ratio));
+        }
+        last_iteration_time = iteration_time;
+    }
+    return score;
+}
+
+// Each iteration searches the full window, so the last one's score isn't needed
+int negamaxIteration(const Board& board, int depth, int, const std::vector<int>& square_order, const std::vector<int>& jump_order, Move& move_out, SearchState& ss, NegamaxRootFuncPtr negamax_root)
+{
+    return negamax_root(board, depth, -INFINITE_SCORE, INFINITE_SCORE, square_order, jump_order, move_out, ss);
+}
+
+int mtdfIteration(const Board& board, int depth, int guess, const std::vector<int>& square_order, const std::vector<int>& jump_order, Move& move_out, SearchState& ss, NegamaxRootFuncPtr negamax_root)
+{
+    return mtdf_impl(board, depth, guess, square_order, jump_order, move_out, ss, negamax_root);
+}
+
+// Aspiration windows: the score is probably close to the last iteration's, and
+// a narrow window prunes more. If the score falls outside, that side of the
+// window is widened and the iteration searched again.
+int pvsIteration(const Board& board, int depth, int guess, const std::vector<int>& square_order, const std::vector<int>& jump_order, Move& move_out, SearchState& ss, NegamaxRootFuncPtr negamax_root)
+{
+    if(depth == 1) {
+        return negamax_root(board, depth, -INFINITE_SCORE, INFINITE_SCORE, square_order, jump_order, move_out, ss);
+    }
+    int delta = ASPIRATION_WINDOW * ss.piece_value;
+    int alpha = std::max(guess - delta, -INFINITE_SCORE);
+    int beta = std::min(guess + delta, int(INFINITE_SCORE));
+    while(true) {
+        int score = negamax_root(board, depth, alpha, beta, square_order, jump_order, move_out, ss);
+        if(ss.isAborted()) {
+            return score;
+        }
+        delta *= 2;
+        if(score <= alpha && alpha > -INFINITE_SCORE) {
+            alpha = std::max(score - delta, -INFINITE_SCORE);
+        } else if(score >= beta && beta < INFINITE_SCORE) {
+            beta = std::min(score + delta, int(INFINITE_SCORE));
+        } else {
+            return score;
+        }
+    }
+}
+
+// The line collected by a PVS policy, as Moves
+void getCollectedPrincipalVariation(const Board& board, const SearchState& ss, std::vector<Move>& pv)
+{
+    pv.clear();
+    Board position(board);
+    // @TODO@ -- assumes AI is player 2
+    Player player = PLAYER2;
+    for(int i = 0; i < ss.pv_length[0] && i < MAX_PV_LENGTH; ++i) {
+        Move move;
+        convBitboardMoveToMove(position, player, ss.pv[0][i], move);
+        pv.push_back(move);
+        makeMove(position, move);
+        player = getOpponent(player);
+    }
+}
+
+template<class Policy>
+int negamax_bb_root(const Board& board, int depth, int alpha, int beta, const std::vector<int>& square_order, const std::vector<int>& jump_order, Move& move_out, SearchState& ss)
 {
     Bitboard bb_player1, bb_player2;
     convBoardToBitboards(board, bb_player1, bb_player2);
-    BitboardMove bb_move_out;
-    int score = negamax_bb_impl(bb_player1, bb_player2, depth, alpha, beta, 1, true, false, square_order, jump_order, bb_move_out, nodes_searched);
+    BitboardMove bb_move_out(BBMOVE_NONE, 0, 0);     // futility pruning can return at the root without setting it
+    ++ss.stats.root_searches;
+    ZobristHash hash = calcHashBB(bb_player1, bb_player2, 1) ^ ss.table_key;
+    int score = negamax_bb_impl<Policy>(bb_player1, bb_player2, hash, depth, alpha, beta, 1, true, false, square_order, jump_order, bb_move_out, ss);
     // @TODO@ -- assumes AI is player 2
     convBitboardMoveToMove(board, PLAYER2, bb_move_out, move_out);
     return score;
 }
 
 // player_sign is 1 for Max (i.e. this AI player), -1 for Min
+// hash is only computed (and only needed) when depth > 0 and the policy uses the table
 // Throughout, "me" refers to the player whose move we're considering; "him" refers to his opponent
 // So "me" alternates between player 1 and player 2 throughout the tree
-int negamax_bb_impl(Bitboard bb_player1, Bitboard bb_player2, int depth, int alpha, int beta, int player_sign, bool is_root, bool in_null_branch, const std::vector<int>& square_order, const std::vector<int>& jump_order, BitboardMove& move_out, int& nodes_searched)
+template<class Policy>
+int negamax_bb_impl(Bitboard bb_player1, Bitboard bb_player2, ZobristHash hash, int depth, int alpha, int beta, int player_sign, bool is_root, bool in_null_branch, const std::vector<int>& square_order, const std::vector<int>& jump_order, BitboardMove& move_out, SearchState& ss)
 {
-    ++nodes_searched;
+    ++ss.nodes_searched;
+    ++ss.stats.nodes[depth];
+    if(Policy::PVS) {
+        ss.pv_length[ss.ply] = 0;
+    }
+    ss.checkBudget();
+    if(ss.isAborted()) {
+        return 0;
+    }
 
-    if(!ENABLE_ALPHA_BETA) {
-        alpha = -INFINITY;
-        beta = INFINITY;
+    if(!Policy::ALPHA_BETA) {
+        alpha = -INFINITE_SCORE;
+        beta = INFINITE_SCORE;
     }
 
-    if(ENABLE_FUTILITY) {
+    if(Policy::FUTILITY) {
         if(depth <= 1) {
-            int score = player_sign * evalPositionBB(bb_player1, bb_player2);
+            int score = player_sign * evalPositionBB(bb_player1, bb_player2, ss);
             if(depth == 0) {
                 return score;
             }
             // We're at the frontier
-            if(score + FUTILITY_THRESHOLD <= alpha) {
+            if(score + Policy::FUTILITY_THRESHOLD * ss.piece_value + ss.feature_swing <= alpha) {
                 // We can't get a score higher than alpha; useless to examine this position further
+                ++ss.stats.futility_prunes;
                 return alpha;
             }
         }
     } else {
         if(depth == 0) {
-            return player_sign * evalPositionBB(bb_player1, bb_player2);
+            return player_sign * evalPositionBB(bb_player1, bb_player2, ss);
         }
     }
 
@@ -114,9 +585,42 @@ int negamax_bb_impl(Bitboard bb_player1, Bitboard bb_player2, int depth, int alp
         std::swap(bb_me, bb_him);
     }
 
-    ZobristHash hash = calcHashBB(bb_player1, bb_player2, player_sign);
-    ZobristValue zv = getZobristValueBB(hash);
-    if(ENABLE_ZOBRIST) {
+    if(!hasAnyMoveBB(bb_me, bb_empty)) {
+        // No moves
+        // We assume the other player fills what they can of the board (see fillableSquares)
+        // @TODO@ -- assumes player_sign == 1 means player 2's turn. Will this hold if we
+        // allow AI to be player 1?
+        if(player_sign == 1) {
+            // Player 2's turn; player 1 fills board
+            bb_player1 |= fillableSquares(bb_player1, bb_empty);
+        } else {
+            // Vice versa
+            bb_player2 |= fillableSquares(bb_player2, bb_empty);
+        }
+        // The game is over, and this is cheaper to work out than a table lookup
+        move_out.move_type = BBMOVE_NONE;
+        return player_sign * scoreFinishedGameBB(bb_player1, bb_player2);
+    }
+
+    // hash is passed on to the children, but the table is probed with
+    // tt_hash. The move in the table is for the position's canonical image, so
+    // it has to be transformed to and from this position's frame.
+    ZobristHash tt_hash = hash;
+    int symmetry = SYMMETRY_IDENTITY;
+    if(Policy::ZOBRIST && Policy::CANONICAL_HASH && countSetBits(bb_pieces) <= CANONICAL_HASH_MAX_PIECES) {
+        tt_hash = calcCanonicalHashBB(bb_player1, bb_player2, player_sign, symmetry) ^ ss.table_key;
+    }
+
+    ZobristValue zv;
+    if(Policy::ZOBRIST) {
+        zv = getZobristValueBB(tt_hash);
+        ++ss.stats.tt_probes[depth];
+        if(zv.depth >= 0) {
+            ++ss.stats.tt_hits[depth];
+        }
+        if(symmetry != SYMMETRY_IDENTITY) {
+            zv.best_move = transformMoveBB(zv.best_move, INVERSE_SYMMETRIES[symmetry]);
+        }
         // Set this in advance in case zobrist makes us fail high!
         move_out = zv.best_move;
         if(move_out.move_type != BBMOVE_NONE && !checkLegalMoveBB(move_out, bb_me, bb_empty)) {
@@ -124,182 +628,162 @@ int negamax_bb_impl(Bitboard bb_player1, Bitboard bb_player2, int depth, int alp
             zv = ZobristValue();
             move_out = zv.best_move;    // clear move_out
         }
-        else if(zv.depth >= depth) {
-            if(!is_root || zv.best_move.move_type != BBMOVE_NONE) {
-                if(zv.lower_bound >= beta) {
-                    return zv.lower_bound;
-                } else if(zv.upper_bound <= alpha && !is_root) {
-                    return zv.upper_bound;
-                }
+        else if(zv.depth >= depth && !is_root && !(Policy::PVS && beta > alpha + 1)) {
+            // The root is always searched, using the stored move only for ordering.
+            // Cutting off or narrowing the window here could leave us without a
+            // move to play, e.g. if the entry's bounds came from a search that
+            // didn't record one. PVS searches PV nodes (the ones with an open
+            // window) too, or the principal variation would stop short there.
+            if(zv.lower_bound >= beta) {
+                ++ss.stats.tt_cutoffs[depth];
+                return zv.lower_bound;
+            } else if(zv.upper_bound <= alpha) {
+                ++ss.stats.tt_cutoffs[depth];
+                return zv.upper_bound;
             }
             alpha = std::max(alpha, int(zv.lower_bound));
             beta = std::min(beta, int(zv.upper_bound));
         }
+        if(zv.depth != depth) {
+            // The bounds belong to a search of a different depth (possibly from an
+            // earlier move); don't let them leak into what we store for this one.
+            zv.lower_bound = -INFINITE_SCORE;
+            zv.upper_bound = INFINITE_SCORE;
+        }
         zv.depth = depth;
     } else {
         move_out.move_type = BBMOVE_NONE;
     }
 
-    int best_score = -INFINITY;
-    bool found_any_moves = false;
+    if(Policy::BATCH_FRONTIER && depth == 1 && !is_root && ss.pieces_only_eval) {
+        int score;
+        BitboardMove best_move;
+        if(evalChildrenBB(bb_me, bb_him, score, best_move)) {
+            ++ss.stats.frontier_batches;
+            if(score != WIN) {
+                score *= ss.piece_value;
+            }
+            // The same as searching the children one by one, except that a
+            // cutoff returns the best child's score rather than the first
+            // that's good enough
+            if(score > alpha) {
+                alpha = score;
+                zv.best_move = best_move;
+                move_out = best_move;
+                if(Policy::PVS) {
+                    ss.pv[ss.ply][0] = best_move;
+                    ss.pv_length[ss.ply] = 1;
+                }
+                if(score >= beta) {
+                    zv.lower_bound = score;
+                    storeResultBB<Policy>(ss, tt_hash, symmetry, zv);
+                    return score;
+                }
+                zv.lower_bound = score;
+            }
+            zv.upper_bound = alpha;
+            storeResultBB<Policy>(ss, tt_hash, symmetry, zv);
+            return alpha;
+        }
+    }
+
+    int best_score = -INFINITE_SCORE;
+    BitboardMove tt_move = move_out;
 
-    if(ENABLE_NULL_MOVE && depth > NULL_MOVE_REDUCTION && !in_null_branch && !is_root) {
+    // Passing is worse than any move only as long as there's a clone to play;
+    // with only jumps left it may not be (zugzwang), so don't try it then
+    if(Policy::NULL_MOVE && depth > NULL_MOVE_REDUCTION && !in_null_branch && !is_root
+        && hasAnyCloneBB(bb_me, bb_empty))
+    {
         BitboardMove null_move(BBMOVE_NULL, 0, 0);
         int score;
         // We use a null window here since we only care if the score >= beta
         int beta_minus_one = beta - 1;      // we have to pass in alpha by reference
-        if(searchMove(null_move, score, zv, bb_player1, bb_player2,
-                      bb_me, bb_him, depth - (NULL_MOVE_REDUCTION - 1),
-                      best_score, beta_minus_one, beta, player_sign, true,
-                      square_order, jump_order, move_out,
-                      nodes_searched))
+        // Passing isn't a move we can play, so it mustn't become the best move
+        int null_best_score = -INFINITE_SCORE;
+        BitboardMove null_move_out = move_out;
+        if(searchMove<Policy>(null_move, score, zv, bb_me, bb_him,
+                      hash, depth - (NULL_MOVE_REDUCTION - 1),
+                      null_best_score, beta_minus_one, beta, player_sign, true,
+                      square_order, jump_order, null_move_out, ss))
         {
             // Beta cutoff
-            setZobristValueBB(hash, zv);
+            if(!ss.isAborted()) {
+                ss.stats.recordCutoff(CUTOFF_NULL_MOVE, 0);
+            }
+            storeResultBB<Policy>(ss, tt_hash, symmetry, zv);
             return score;
         }
     }
 
     // If we found a best move via transposition table, try it now.
-    if(ENABLE_BEST_FIRST && move_out.move_type != BBMOVE_NONE) {
+    int move_number = 0;
+    if(Policy::BEST_FIRST && tt_move.move_type != BBMOVE_NONE) {
         int score;
-        if(searchMove(move_out, score, zv, bb_player1,
-                      bb_player2, bb_me, bb_him, depth, best_score,
+        ++move_number;
+        if(searchMove<Policy>(tt_move, score, zv, bb_me,
+                      bb_him, hash, depth, best_score,
                       alpha, beta, player_sign, in_null_branch,
-                      square_order, jump_order, move_out,
-                      nodes_searched))
+                      square_order, jump_order, move_out, ss))
         {
             // Beta cutoff
-            setZobristValueBB(hash, zv);
+            if(!ss.isAborted()) {
+                ss.stats.recordCutoff(CUTOFF_TT_MOVE, move_number);
+            }
+            storeResultBB<Policy>(ss, tt_hash, symmetry, zv);
             return score;
         }
     }
 
-    // Try to generate moves
-    // If we analyzed a "best move", it will show up again in one of these loops.
-    // We're hoping the transposition table takes care of it.
-    // We'll look at clone moves first because they tend to be the best moves.
-    for(int square_num : square_order) {
-        BitboardMove bbmove(BBMOVE_NONE, 0, 0);
-        Bitboard bit = 1LL << square_num;
-        if(bit & bb_empty) {
-            // This is an empty square; try to clone into it
-            if(bb_me & BITBOARD_SURROUNDS[square_num]) {
-                found_any_moves = true;
-                bbmove.move_type = BBMOVE_CLONE;
-                bbmove.square = square_num;
-                int score;
-                if(searchMove(bbmove, score, zv, bb_player1,
-                              bb_player2, bb_me, bb_him, depth, best_score,
-                              alpha, beta, player_sign, in_null_branch,
-                              square_order, jump_order, move_out,
-                              nodes_searched))
-                {
-                    // Beta cutoff
-                    setZobristValueBB(hash, zv);
-                    return score;
-                }
+    // Now the rest of the moves, skipping the one we've just searched
+    BitboardMove searched_move = Policy::BEST_FIRST ? tt_move : BitboardMove(BBMOVE_NONE, 0, 0);
+    MoveOrderingBB ordering;
+    bool use_ordering = Policy::MOVE_HISTORY && depth >= ORDERING_MIN_DEPTH;
+    if(use_ordering) {
+        ordering.history = ss.history;
+        ordering.killers[0] = ss.killers[ss.ply][0];
+        ordering.killers[1] = ss.killers[ss.ply][1];
+        ordering.countermove = BitboardMove(BBMOVE_NONE, 0, 0);
+        if(ss.ply > 0) {
+            BitboardMove previous = ss.path[ss.ply - 1];
+            if(previous.move_type != BBMOVE_NULL) {
+                ordering.countermove = ss.countermoves[moveIndexBB(previous)];
             }
         }
     }
-
-    // Now look for jumps that capture
-    for(int square_num : square_order) {
-        BitboardMove bbmove(BBMOVE_NONE, 0, 0);
-        Bitboard bit = 1LL << square_num;
-        if(bit & bb_me) {
-            // This is one of my squares; try to generate jumps
-            const BitboardJump* jumps = BITBOARD_JUMPS[square_num];
-            for(int jump_num : jump_order) {
-                if(jumps[jump_num].dest_square & bb_empty && jumps[jump_num].capture_radius & bb_him) {
-                    found_any_moves = true;
-                    bbmove.move_type = BBMOVE_JUMP;
-                    bbmove.square = square_num;
-                    bbmove.jump_type = jump_num;
-                    int score;
-                    if(searchMove(bbmove, score, zv, bb_player1,
-                                  bb_player2, bb_me, bb_him, depth, best_score,
-                                  alpha, beta, player_sign, in_null_branch,
-                                  square_order, jump_order, move_out,
-                                  nodes_searched))
-                    {
-                        // Beta cutoff
-                        setZobristValueBB(hash, zv);
-                        return score;
-                    }
-                }
-            }
-        }
-    }
-
-    // Now look for the least promising moves: jumps that don't capture.
-    // @TODO@ -- code duplication! This is exactly the same loop as above,
-    // except one of the conditions is negated.
-    // @TODO@ -- is it really a good idea to only do this if no moves are found?
-    if(1 /* !found_any_moves */) {
-        for(int square_num : square_order) {
-            BitboardMove bbmove(BBMOVE_NONE, 0, 0);
-            Bitboard bit = 1LL << square_num;
-            if(bit & bb_me) {
-                // This is one of my squares; try to generate jumps
-                const BitboardJump* jumps = BITBOARD_JUMPS[square_num];
-                for(int jump_num : jump_order) {
-                    if(jumps[jump_num].dest_square & bb_empty && !(jumps[jump_num].capture_radius & bb_him)) {
-                        found_any_moves = true;
-                        bbmove.move_type = BBMOVE_JUMP;
-                        bbmove.square = square_num;
-                        bbmove.jump_type = jump_num;
-                        int score;
-                        if(searchMove(bbmove, score, zv, bb_player1,
-                                      bb_player2, bb_me, bb_him, depth, best_score,
-                                      alpha, beta, player_sign, in_null_branch,
-                                      square_order, jump_order, move_out,
-                                      nodes_searched))
-                        {
-                            // Beta cutoff
-                            setZobristValueBB(hash, zv);
-                            return score;
-                        }
-                    }
-                }
+    StagedMoveGenBB move_gen(bb_me, bb_him, square_order, jump_order, searched_move, use_ordering ? &ordering : nullptr);
+    BitboardMove bbmove;
+    while(move_gen.next(bbmove)) {
+        int score;
+        ++move_number;
+        if(searchMove<Policy>(bbmove, score, zv, bb_me,
+                              bb_him, hash, depth, best_score,
+                              alpha, beta, player_sign, in_null_branch,
+                              square_order, jump_order, move_out, ss))
+        {
+            // Beta cutoff
+            if(!ss.isAborted()) {
+                ss.stats.recordCutoff(CutoffStage(CUTOFF_CLONES + move_gen.stage()), move_number);
             }
+            storeResultBB<Policy>(ss, tt_hash, symmetry, zv);
+            return score;
         }
     }
 
-    if(!found_any_moves) {
-        // No moves were found
-        // We assume the other player can fill the board (should be true in a 2-player game)
-        // @TODO@ -- I believe this assumption does NOT hold if we allow impassable squares
-        // @TODO@ -- assumes player_sign == 1 means player 2's turn. Will this hold if we
-        // allow AI to be player 1?
-        if(player_sign == 1) {
-            // Player 2's turn; player 1 fills board
-            bb_player1 |= bb_empty;
-        } else {
-            // Vice versa
-            bb_player2 |= bb_empty;
-        }
-        int score = player_sign * evalPositionBB(bb_player1, bb_player2);
-        zv.depth = INFINITE_PLY;    // The game should be over
-        zv.lower_bound = score;
-        zv.upper_bound = score;
-        setZobristValueBB(hash, zv);
-        return score;
-    }
-
+    // If no move raised alpha, zv.best_move still holds whatever the table had
+    // before. It's as good a first guess as any for the next search.
     zv.upper_bound = alpha;
-    zv.best_move = BitboardMove(BBMOVE_NONE, 0, 0);
-    setZobristValueBB(hash, zv);
+    storeResultBB<Policy>(ss, tt_hash, symmetry, zv);
     return alpha;
 }
 
 // Returns true if there's been a beta cutoff, false if not
+template<class Policy>
 bool searchMove(BitboardMove bbmove, int& score, ZobristValue& zv,
-    Bitboard bb_player1, Bitboard bb_player2, Bitboard bb_me,
-    Bitboard bb_him, int depth, int& best_score, int& alpha, int beta,
+    Bitboard bb_me, Bitboard bb_him, ZobristHash hash, int depth, int& best_score, int& alpha, int beta,
     int player_sign, bool in_null_branch, const std::vector<int>& square_order,
     const std::vector<int>& jump_order, BitboardMove& move_out,
-    int& nodes_searched)
+    SearchState& ss)
 {
     Bitboard bb_me_after = bb_me;
     Bitboard bb_him_after = bb_him;
@@ -311,8 +795,37 @@ bool searchMove(BitboardMove bbmove, int& score, ZobristValue& zv,
     if(player_sign == 1) {
         std::swap(bb_p1_after, bb_p2_after);
     }
+    // Leaves don't look at the transposition table, so don't bother hashing them
+    ZobristHash hash_after = 0;
+    if(Policy::ZOBRIST && depth > 1) {
+        // @TODO@ assumes AI is player 2
+        int me = (player_sign == 1) ? 1 : 0;
+        hash_after = updateHashBB(hash, me, bb_me ^ bb_me_after, bb_him ^ bb_him_after);
+        // The wrong bucket if the child will be canonicalized
+        if(!Policy::CANONICAL_HASH || countSetBits(bb_me_after | bb_him_after) > CANONICAL_HASH_MAX_PIECES) {
+            prefetchZobristBucket(hash_after);
+        }
+    }
     BitboardMove dummy;     // @TODO@ -- make unnecessary
-    score = -negamax_bb_impl(bb_p1_after, bb_p2_after, depth - 1, -beta, -alpha, -player_sign, false, in_null_branch, square_order, jump_order, dummy, nodes_searched);
+    if(Policy::MOVE_HISTORY) {
+        ss.path[ss.ply] = bbmove;
+    }
+    ++ss.ply;
+    if(Policy::PVS && best_score > -INFINITE_SCORE && beta > alpha + 1) {
+        // Not the first move. Prove it's no better than the best so far with a
+        // zero window, and only if that fails find out what it's really worth.
+        score = -negamax_bb_impl<Policy>(bb_p1_after, bb_p2_after, hash_after, depth - 1, -alpha - 1, -alpha, -player_sign, false, in_null_branch, square_order, jump_order, dummy, ss);
+        if(score > alpha && score < beta && !ss.isAborted()) {
+            score = -negamax_bb_impl<Policy>(bb_p1_after, bb_p2_after, hash_after, depth - 1, -beta, -alpha, -player_sign, false, in_null_branch, square_order, jump_order, dummy, ss);
+        }
+    } else {
+        score = -negamax_bb_impl<Policy>(bb_p1_after, bb_p2_after, hash_after, depth - 1, -beta, -alpha, -player_sign, false, in_null_branch, square_order, jump_order, dummy, ss);
+    }
+    --ss.ply;
+    if(ss.isAborted()) {
+        // Unwind without touching anything; storeResultBB won't record it either
+        return true;
+    }
     if(score > best_score) {
         best_score = score;
         move_out = bbmove;
@@ -322,6 +835,9 @@ bool searchMove(BitboardMove bbmove, int& score, ZobristValue& zv,
         if(!move_out.move_type == BBMOVE_NONE) {
             zv.best_move = move_out;
         }
+        if(Policy::MOVE_HISTORY && depth >= ORDERING_MIN_DEPTH && bbmove.move_type != BBMOVE_NULL) {
+            recordCutoffBB(bbmove, depth, ss);
+        }
         return true;
     } else if(score > alpha) {
         alpha = score;
@@ -330,35 +846,122 @@ bool searchMove(BitboardMove bbmove, int& score, ZobristValue& zv,
         if(!move_out.move_type == BBMOVE_NONE) {
             zv.best_move = move_out;
         }
+        if(Policy::PVS) {
+            // The new best line: this move, then the child's
+            int ply = ss.ply;
+            ss.pv[ply][0] = bbmove;
+            for(int i = 0; i < ss.pv_length[ply + 1]; ++i) {
+                ss.pv[ply][i + 1] = ss.pv[ply + 1][i];
+            }
+            ss.pv_length[ply] = ss.pv_length[ply + 1] + 1;
+        }
     }
     return false;
 }
 
-void makeMoveBB(BitboardMove bbmove, Bitboard& me, Bitboard& him)
+// Results computed after the search was aborted are garbage; keep them out of
+// the table, which outlives this search and may be shared with other threads.
+// symmetry takes the position to the one hash belongs to (see calcCanonicalHashBB).
+template<class Policy>
+void storeResultBB(const SearchState& ss, ZobristHash hash, int symmetry, const ZobristValue& zv)
 {
-    Bitboard square_bit = (1LL << bbmove.square);
-    switch(bbmove.move_type)
-    {
-      case BBMOVE_CLONE:
-        me |= square_bit;
-        handleCaptures(BITBOARD_SURROUNDS[bbmove.square], me, him);
-        break;
+    if(Policy::ZOBRIST && !ss.isAborted()) {
+        if(symmetry == SYMMETRY_IDENTITY) {
+            setZobristValueBB(hash, zv);
+        } else {
+            ZobristValue canonical_zv(zv);
+            canonical_zv.best_move = transformMoveBB(zv.best_move, symmetry);
+            setZobristValueBB(hash, canonical_zv);
+        }
+    }
+}
 
-      case BBMOVE_JUMP:
-      {
-        BitboardJump jump = BITBOARD_JUMPS[bbmove.square][bbmove.jump_type];
-        me |= jump.dest_square;
-        me &= invertBitboard(square_bit);      // remove piece from source square
-        handleCaptures(jump.capture_radius, me, him);
-        break;
-      }
+// Updates the move ordering tables in ss for bbmove, which caused a beta
+// cutoff at ss.ply with depth plies to go
+void recordCutoffBB(BitboardMove bbmove, int depth, SearchState& ss)
+{
+    BitboardMove* killers = ss.killers[ss.ply];
+    if(killers[0] != bbmove) {
+        killers[1] = killers[0];
+        killers[0] = bbmove;
+    }
+    if(ss.ply > 0) {
+        BitboardMove previous = ss.path[ss.ply - 1];
+        if(previous.move_type != BBMOVE_NULL) {
+            ss.countermoves[moveIndexBB(previous)] = bbmove;
+        }
+    }
+    int& history = ss.history[moveIndexBB(bbmove)];
+    history += depth * depth;
+    if(history >= HISTORY_LIMIT) {
+        for(int i = 0; i < NUM_MOVE_INDICES; ++i) {
+            ss.history[i] /= 2;
+        }
+    }
+}
 
-      case BBMOVE_NULL:
-        break;
+// Squares in candidates with the highest count (see countNeighbours), and that count
+int maxNeighbourCount(const Bitboard counts[4], Bitboard& candidates)
+{
+    int max_count = 0;
+    for(int bit = 3; bit >= 0; --bit) {
+        Bitboard higher = candidates & counts[bit];
+        if(higher) {
+            candidates = higher;
+            max_count |= 1 << bit;
+        }
+    }
+    return max_count;
+}
 
-      default:
-        assert(false);
+// One ply from the frontier, every child is just evaluated, so the best of
+// them can be found without making and searching each move. After a move to a
+// square, bb_me is ahead by one more piece if it was a clone, and two more for
+// each piece next to the square; so counting bb_him's pieces next to every
+// square at once (see countNeighbours) is enough. A jump is never better than
+// a clone to the same square, so only squares without a clone are looked at
+// for jumps. Only works if evalPositionBB just counts pieces: puts the best
+// score from bb_me's side in score_out, in pieces (or WIN), and a move that
+// gets it in move_out. Returns false if the position is too near the end for
+// the shortcut (a clone could fill the board, which scores differently);
+// bb_me must have a move.
+bool evalChildrenBB(Bitboard bb_me, Bitboard bb_him, int& score_out, BitboardMove& move_out)
+{
+    Bitboard bb_empty = invertBitboard(bb_me | bb_him);
+    Bitboard clone_squares = cloneTargets(bb_me, bb_empty);
+    if(clone_squares && (bb_empty & (bb_empty - 1)) == 0) {
+        return false;
+    }
+    Bitboard counts[4];
+    countNeighbours(bb_him, counts);
+    Bitboard jump_squares = moveTargets(bb_me, bb_empty) & ~clone_squares;
+    int clone_captures = clone_squares ? maxNeighbourCount(counts, clone_squares) : -1;
+    int jump_captures = jump_squares ? maxNeighbourCount(counts, jump_squares) : -1;
+    assert(clone_captures >= 0 || jump_captures >= 0);
+
+    int dest;
+    int captures;
+    if(clone_captures >= jump_captures) {
+        dest = lowestSetSquare(clone_squares);
+        captures = clone_captures;
+        score_out = countSetBits(bb_me) + 1 - countSetBits(bb_him) + 2 * captures;
+        move_out = BitboardMove(BBMOVE_CLONE, dest, 0);
+    } else {
+        dest = lowestSetSquare(jump_squares);
+        captures = jump_captures;
+        score_out = countSetBits(bb_me) - countSetBits(bb_him) + 2 * captures;
+        int source = lowestSetSquare(BITBOARD_JUMP_TARGETS[dest] & bb_me);
+        int jump_num = 0;
+        while(BITBOARD_JUMPS[source][jump_num].dest_square != (Bitboard(1) << dest)) {
+            ++jump_num;
+        }
+        move_out = BitboardMove(BBMOVE_JUMP, source, jump_num);
     }
+    if(captures == countSetBits(bb_him)) {
+        // Nothing left of the opponent
+        score_out = WIN;
+    }
+    return true;
 }
 
 bool checkLegalMoveBB(BitboardMove bbmove, Bitboard bb_me, Bitboard bb_empty)
@@ -374,81 +977,49 @@ bool checkLegalMoveBB(BitboardMove bbmove, Bitboard bb_me, Bitboard bb_empty)
     }
 }
 
-// @TODO@ -- Assumes AI is PLAYER2
-// @TODO@ -- Does not account for draws (default 2-player rules don't allow them anyway)
-int evalPositionBB(Bitboard player1, Bitboard player2)
+void setSearchEval(SearchState& ss, const EvalWeights& weights)
 {
-    // Make sure the high bits if the bitboards are clear
-    assert((player1 & ~((1LL << NUM_SQUARES) - 1)) == 0);
-    assert((player2 & ~((1LL << NUM_SQUARES) - 1)) == 0);
-    // Make sure there is no overlap between bitboards
-    assert((player1 & player2) == 0);
-    int num_pieces_p1 = countSetBits(player1);
-    int num_pieces_p2 = countSetBits(player2);
-    // @TODO@ -- assumes board has NUM_SQUARES empty squares
-    // (won't be true if we allow squares into which it is illegal to move)
-    if(num_pieces_p1 == 0 || num_pieces_p2 == 0 || num_pieces_p1 + num_pieces_p2 == NUM_SQUARES) {
-        if(num_pieces_p2 > num_pieces_p1) {
-            return WIN;
-        } else {
-            return LOSS;
-        }
+    ss.eval_weights = &weights;
+    ss.pieces_only_eval = weights.countsOnlyPieces();
+    ss.piece_value = weights.weights[EVAL_PIECES];
+    ss.feature_swing = 0;
+    for(int feature = EVAL_PIECES + 1; feature < NUM_EVAL_FEATURES; ++feature) {
+        ss.feature_swing += FEATURE_SWING * std::abs(weights.weights[feature]);
     }
-    return num_pieces_p2 - num_pieces_p1;
 }
 
-void convBoardToBitboards(const Board& board, Bitboard& player1, Bitboard& player2)
+// Whoever has more pieces has won; equal counts, which an even number of
+// playable squares or a region nobody can reach allows, are a draw
+// @TODO@ -- Assumes AI is PLAYER2
+int scoreFinishedGameBB(Bitboard player1, Bitboard player2)
 {
-    player1 = player2 = 0;
-    Bitboard bit = 1;
-    for(int y = 0; y < BOARD_SIZE; ++y) {
-        for(int x = 0; x < BOARD_SIZE; ++x) {
-            switch(board(x, y)) {
-              case EMPTY_SQUARE:    break;
-              case PLAYER1:         player1 |= bit; break;
-              case PLAYER2:         player2 |= bit; break;
-              default:              assert(false);
-            }
-            bit <<= 1;
-        }
+    int num_pieces_p1 = countSetBits(player1);
+    int num_pieces_p2 = countSetBits(player2);
+    if(num_pieces_p2 > num_pieces_p1) {
+        return WIN;
+    } else if(num_pieces_p2 < num_pieces_p1) {
+        return LOSS;
     }
+    return 0;
 }
 
-void convBitboardMoveToMove(const Board& board, Player player, BitboardMove bb_move, Move& move)
+// @TODO@ -- Assumes AI is PLAYER2
+int evalPositionBB(Bitboard player1, Bitboard player2, const SearchState& ss)
 {
-    switch(bb_move.move_type) {
-      case BBMOVE_CLONE:
-        convSquareNumToCoord(bb_move.square, move.dst);
-        for(int y = move.dst.y - 1; y <= move.dst.y + 1; ++y) {
-            for(int x = move.dst.x - 1; x <= move.dst.x + 1; ++x) {
-                Coord coord(x, y);
-                if(board.isInRange(coord) && board(x, y) == player) {
-                    move.src = coord;
-                    return;
-                }
-            }
-        }
-        // We only get here if a clone move was generated, but no friendly
-        // piece neighbors the destination square
-        assert(false);
-
-      case BBMOVE_JUMP:
-        convSquareNumToCoord(bb_move.square, move.src);
-        move.dst.x = move.src.x + JUMP_COORDS[bb_move.jump_type].x;
-        move.dst.y = move.src.y + JUMP_COORDS[bb_move.jump_type].y;
-        break;
-
-      case BBMOVE_NONE:
-        // MTD(f) will generate this when negamax fails low.
-        // So we can't assert(false) here.
-        // What we can do, though, is mark this move and check for it
-        // when it isn't expected.
-        move.src.x = move.src.y = move.dst.x = move.dst.y = -1;
-        break;
-
-      default:
-        assert(false);
+    // Make sure the bitboards only have playable squares
+    assert((player1 & ~BITBOARD_PLAYABLE) == 0);
+    assert((player2 & ~BITBOARD_PLAYABLE) == 0);
+    // Make sure there is no overlap between bitboards
+    assert((player1 & player2) == 0);
+    int num_pieces_p1 = countSetBits(player1);
+    int num_pieces_p2 = countSetBits(player2);
+    if(num_pieces_p1 == 0 || num_pieces_p2 == 0 || num_pieces_p1 + num_pieces_p2 == NUM_PLAYABLE_SQUARES) {
+        return scoreFinishedGameBB(player1, player2);
+    }
+    if(ss.pieces_only_eval) {
+        return ss.piece_value * (num_pieces_p2 - num_pieces_p1);
     }
+    return evalFeaturesBB(player1, player2, *ss.eval_weights);
 }
 
 void convSquareNumToCoord(int square_num, Coord& coord)
@@ -0,0 +1,322 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <iostream>
+#include <locale>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Board.hpp"
+#include "moves.hpp"
+#include "ai.hpp"
+#include "bitboards.hpp"
+#include "zobrist.hpp"
+#include "notation.hpp"
+#include "analyze.hpp"
+
+using namespace std;
+
+namespace
+{
+
+// How many positions may be read ahead of the output, per worker. Enough to
+// keep everyone busy when some positions take much longer than others, while
+// keeping memory bounded.
+const int MAX_IN_FLIGHT_PER_WORKER = 64;
+
+const int BINARY_RECORD_SIZE = 17;
+
+struct AnalysisJob
+{
+    long long index;
+    Board board;
+    Player to_move;
+    string error;                   // Set if the position couldn't be read
+};
+
+// Each worker takes jobs from the front of its own queue; others steal from
+// the back
+struct WorkerQueue
+{
+    mutex queue_mutex;
+    deque<AnalysisJob> jobs;
+};
+
+class AnalysisPool
+{
+  public:
+    AnalysisPool(ostream& out, const AnalysisSettings& settings)
+        : m_out(out),
+          m_settings(settings),
+          m_config(&getSearchConfig()),
+          m_limits(getSearchLimits()),
+          m_unclaimed(0),
+          m_steals(0),
+          m_in_flight(0),
+          m_input_done(false),
+          m_next_output(0)
+    {
+        int num_workers = settings.num_workers;
+        if(num_workers <= 0) {
+            num_workers = max(1, int(thread::hardware_concurrency()));
+        }
+        m_max_in_flight = num_workers * MAX_IN_FLIGHT_PER_WORKER;
+        for(int i = 0; i < num_workers; ++i) {
+            m_queues.emplace_back(new WorkerQueue);
+        }
+        for(int i = 0; i < num_workers; ++i) {
+            m_workers.emplace_back(&AnalysisPool::work, this, i);
+        }
+    }
+
+    int getNumWorkers() const
+    {
+        return int(m_queues.size());
+    }
+
+    long long getSteals() const
+    {
+        return m_steals;
+    }
+
+    // Blocks while too many positions are waiting to be written
+    void add(AnalysisJob& job)
+    {
+        {
+            unique_lock<mutex> lock(m_state_mutex);
+            m_space_ready.wait(lock, [this]() { return m_in_flight < m_max_in_flight; });
+            ++m_in_flight;
+        }
+        WorkerQueue& queue = *m_queues[job.index % m_queues.size()];
+        {
+            lock_guard<mutex> lock(queue.queue_mutex);
+            queue.jobs.push_back(move(job));
+        }
+        {
+            lock_guard<mutex> lock(m_state_mutex);
+            ++m_unclaimed;
+        }
+        m_work_ready.notify_one();
+    }
+
+    // Waits for everything added so far to be analyzed and written
+    void finish()
+    {
+        {
+            lock_guard<mutex> lock(m_state_mutex);
+            m_input_done = true;
+        }
+        m_work_ready.notify_all();
+        for(thread& worker : m_workers) {
+            worker.join();
+        }
+    }
+
+  private:
+    bool takeJob(int worker_num, AnalysisJob& job)
+    {
+        int num_queues = int(m_queues.size());
+        for(int i = 0; i < num_queues; ++i) {
+            WorkerQueue& queue = *m_queues[(worker_num + i) % num_queues];
+            lock_guard<mutex> lock(queue.queue_mutex);
+            if(!queue.jobs.empty()) {
+                if(i == 0) {
+                    job = move(queue.jobs.front());
+                    queue.jobs.pop_front();
+                } else {
+                    job = move(queue.jobs.back());
+                    queue.jobs.pop_back();
+                    ++m_steals;
+                }
+                --m_unclaimed;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void work(int worker_num)
+    {
+        setSearchConfig(*m_config);
+        setSearchLimits(m_limits);
+        if(!m_settings.shared_table) {
+            setSearchTableKey(0x9e3779b97f4a7c15ULL * (worker_num + 1));
+        }
+        vector<int> square_order(NUM_SQUARES);
+        vector<int> jump_order(NUM_JUMPS);
+        for(int i = 0; i < NUM_SQUARES; ++i) {
+            square_order[i] = i;
+        }
+        for(int i = 0; i < NUM_JUMPS; ++i) {
+            jump_order[i] = i;
+        }
+
+        while(true) {
+            AnalysisJob job;
+            if(takeJob(worker_num, job)) {
+                write(job.index, analyze(job, square_order, jump_order));
+                continue;
+            }
+            unique_lock<mutex> lock(m_state_mutex);
+            if(m_input_done && m_unclaimed <= 0) {
+                return;
+            }
+            m_work_ready.wait(lock, [this]() { return m_unclaimed > 0 || m_input_done; });
+        }
+    }
+
+    string analyze(const AnalysisJob& job, const vector<int>& square_order, const vector<int>& jump_order)
+    {
+        if(!job.error.empty()) {
+            return "error " + job.error;
+        }
+        // The search always plays player 2
+        Board board(job.board);
+        if(job.to_move == PLAYER1) {
+            swapPlayers(board);
+        }
+        ostringstream line;
+        if(!hasLegalMove(board, PLAYER2)) {
+            // As in the search, the other player gets the rest of the board
+            Bitboard bb_player1, bb_player2;
+            convBoardToBitboards(board, bb_player1, bb_player2);
+            int score = finalMarginBB(bb_player2, bb_player1, invertBitboard(bb_player1 | bb_player2));
+            line << "bestmove 0000 score " << score << " depth 0 nodes 0";
+            return line.str();
+        }
+        newZobristGeneration();
+        Move move;
+        long long nodes_searched = 0;
+        int score = mtdf_bb(board, square_order, jump_order, move, nodes_searched);
+        line << "bestmove " << moveName(move) << " score " << score << " depth " << getLastSearchDepth()
+             << " nodes " << nodes_searched;
+        return line.str();
+    }
+
+    // Results can finish in any order; each is held until those before it are out
+    void write(long long index, const string& line)
+    {
+        int num_written = 0;
+        {
+            lock_guard<mutex> lock(m_output_mutex);
+            m_pending[index] = line;
+            while(!m_pending.empty() && m_pending.begin()->first == m_next_output) {
+                m_out << m_pending.begin()->second << '\n';
+                m_pending.erase(m_pending.begin());
+                ++m_next_output;
+                ++num_written;
+            }
+            if(num_written > 0) {
+                m_out.flush();
+            }
+        }
+        if(num_written > 0) {
+            {
+                lock_guard<mutex> lock(m_state_mutex);
+                m_in_flight -= num_written;
+            }
+            m_space_ready.notify_one();
+        }
+    }
+
+    ostream& m_out;
+    AnalysisSettings m_settings;
+    const SearchConfig* m_config;
+    SearchLimits m_limits;
+    vector<unique_ptr<WorkerQueue>> m_queues;
+    vector<thread> m_workers;
+    atomic<long long> m_unclaimed;          // Jobs in the queues
+    atomic<long long> m_steals;
+
+    // Guards m_in_flight and m_input_done, and goes with the condition variables
+    mutex m_state_mutex;
+    condition_variable m_work_ready;
+    condition_variable m_space_ready;
+    long long m_in_flight;                  // Jobs read but not yet written
+    long long m_max_in_flight;
+    bool m_input_done;
+
+    mutex m_output_mutex;
+    map<long long, string> m_pending;
+    long long m_next_output;
+};
+
+uint64_t readLittleEndian64(const unsigned char* bytes)
+{
+    uint64_t value = 0;
+    for(int i = 7; i >= 0; --i) {
+        value = (value << 8) | bytes[i];
+    }
+    return value;
+}
+
+// Returns false at the end of the input. Anything wrong with the position
+// itself goes in job.error.
+bool readPosition(istream& in, bool binary, AnalysisJob& job)
+{
+    job.error.clear();
+    if(binary) {
+        unsigned char record[BINARY_RECORD_SIZE];
+        if(!in.read(reinterpret_cast<char*>(record), BINARY_RECORD_SIZE)) {
+            if(in.gcount() > 0) {
+                cerr << "Ignoring " << in.gcount() << " bytes at the end of the input" << endl;
+            }
+            return false;
+        }
+        Bitboard player1 = readLittleEndian64(record);
+        Bitboard player2 = readLittleEndian64(record + 8);
+        job.to_move = Player(record[16]);
+        if((player1 & player2) != 0 || ((player1 | player2) & ~BITBOARD_PLAYABLE) != 0
+            || (job.to_move != PLAYER1 && job.to_move != PLAYER2))
+        {
+            job.error = "bad record";
+        } else {
+            convBitboardsToBoard(player1, player2, job.board);
+        }
+        return true;
+    }
+
+    string line;
+    do {
+        if(!getline(in, line)) {
+            return false;
+        }
+    } while(line.find_first_not_of(" \t\r") == string::npos);
+    if(!parseFen(line, job.board, job.to_move)) {
+        job.error = "bad or unsupported FEN";
+    }
+    return true;
+}
+
+}
+
+void analyzePositions(std::istream& in, std::ostream& out, const AnalysisSettings& settings)
+{
+    using namespace std::chrono;
+    // The output is for programs, so no thousands separators
+    out.imbue(locale::classic());
+    steady_clock::time_point t1 = steady_clock::now();
+    AnalysisPool pool(out, settings);
+    long long num_positions = 0;
+    AnalysisJob job;
+    while(readPosition(in, settings.binary, job)) {
+        job.index = num_positions++;
+        pool.add(job);
+    }
+    pool.finish();
+    double secs = duration_cast<duration<double>>(steady_clock::now() - t1).count();
+
+    cerr << "Analyzed " << num_positions << " positions in " << secs << " seconds";
+    if(secs > 0) {
+        cerr << " (" << num_positions / secs << " positions/sec)";
+    }
+    cerr << " with " << pool.getNumWorkers() << " workers; " << pool.getSteals() << " positions stolen" << endl;
+}
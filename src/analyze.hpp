@@ -0,0 +1,33 @@
+#ifndef SPLOT_ANALYZE_HPP
+#define SPLOT_ANALYZE_HPP
+
+#include <istream>
+#include <ostream>
+
+struct AnalysisSettings
+{
+    bool binary = false;            // Input format; see analyzePositions
+    int num_workers = 0;            // Positions searched at once; 0 means one per core
+    bool shared_table = true;       // If false, each worker gets a table of its own (see setSearchTableKey)
+};
+
+// Searches every position in the input with mtdf_bb, using the calling
+// thread's search config and limits, and writes one line per position to out,
+// in input order:
+//   bestmove MOVE score SCORE depth DEPTH nodes NODES
+// The score is from the point of view of the side to move, and MOVE is 0000
+// if it has no moves (the score is then the final one). A position that can't
+// be read gets "error" and a reason instead.
+//
+// Text input is one FEN per line (see parseFen). Binary input is 17-byte
+// records: player 1's bitboard and player 2's, 8 bytes each, little-endian,
+// with square (x, y) at bit BOARD_SIZE*y + x; then 1 for player 1 to move or
+// 2 for player 2.
+//
+// Positions are handed out to a pool of workers, each searching with one
+// thread. Each worker has its own queue, and one that runs out of work steals
+// from the others. Only a limited number of positions are read ahead of the
+// output, so the input can be any length. A summary goes to stderr.
+void analyzePositions(std::istream& in, std::ostream& out, const AnalysisSettings& settings);
+
+#endif
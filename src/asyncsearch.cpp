@@ -0,0 +1,192 @@
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "Board.hpp"
+#include "moves.hpp"
+#include "ai.hpp"
+#include "bitboards.hpp"
+#include "zobrist.hpp"
+#include "asyncsearch.hpp"
+
+using namespace std;
+
+extern thread_local mt19937 g_rng;
+
+namespace
+{
+
+void makeSearchOrders(vector<int>& square_order, vector<int>& jump_order)
+{
+    square_order.resize(NUM_SQUARES);
+    jump_order.resize(NUM_JUMPS);
+    for(int i = 0; i < NUM_SQUARES; ++i) {
+        square_order.at(i) = i;
+    }
+    for(int i = 0; i < NUM_JUMPS; ++i) {
+        jump_order.at(i) = i;
+    }
+    if(ENABLE_RANDOMNESS) {
+        shuffle(square_order.begin(), square_order.end(), g_rng);
+    }
+}
+
+bool isSamePosition(const Board& a, const Board& b)
+{
+    Bitboard a_player1, a_player2, b_player1, b_player2;
+    convBoardToBitboards(a, a_player1, a_player2);
+    convBoardToBitboards(b, b_player1, b_player2);
+    return a_player1 == b_player1 && a_player2 == b_player2;
+}
+
+}
+
+void AsyncSearch::start(const vector<Board>& positions, AiFuncPtr ai, bool ponder)
+{
+    cancel();
+    if(positions.empty()) {
+        return;
+    }
+    m_positions = positions;
+    m_ai = ai;
+    m_results.assign(positions.size(), SearchResult());
+    m_num_searched = 0;
+    m_last = int(positions.size()) - 1;
+    m_stop = false;
+    m_pondering = ponder;
+
+    // Search settings are per thread, so hand ours over
+    SearchLimits limits = getSearchLimits();
+    limits.stop_request = &m_stop;
+    limits.pondering = &m_pondering;
+    m_thread = thread(&AsyncSearch::run, this, limits, &getSearchConfig(), getNumSearchThreads());
+}
+
+void AsyncSearch::cancel()
+{
+    if(m_thread.joinable()) {
+        m_stop = true;
+        m_thread.join();
+    }
+}
+
+bool AsyncSearch::claim(const Board& position, SearchResult& result_out)
+{
+    if(!m_thread.joinable()) {
+        return false;
+    }
+    int index = 0;
+    while(index < int(m_positions.size()) && !isSamePosition(m_positions[index], position)) {
+        ++index;
+    }
+
+    unique_lock<mutex> lock(m_mutex);
+    if(index < m_num_searched) {
+        lock.unlock();
+        cancel();
+        result_out = m_results[index];
+        return true;
+    }
+    if(index != m_num_searched || index == int(m_positions.size())) {
+        // Not started yet, or not there at all
+        lock.unlock();
+        cancel();
+        return false;
+    }
+    m_last = index;
+    m_pondering = false;
+    m_searched.wait(lock, [this, index]() { return m_num_searched > index; });
+    lock.unlock();
+    m_thread.join();
+    result_out = m_results[index];
+    return true;
+}
+
+int AsyncSearch::getNumSearched() const
+{
+    lock_guard<mutex> lock(m_mutex);
+    return m_num_searched;
+}
+
+void AsyncSearch::run(SearchLimits limits, const SearchConfig* config, int num_threads)
+{
+    setSearchLimits(limits);
+    setSearchConfig(*config);
+    setNumSearchThreads(num_threads);
+    vector<int> square_order;
+    vector<int> jump_order;
+    makeSearchOrders(square_order, jump_order);
+
+    for(int i = 0; ; ++i) {
+        {
+            lock_guard<mutex> lock(m_mutex);
+            if(i > m_last || m_stop) {
+                return;
+            }
+        }
+        SearchResult result;
+        result.score = m_ai(m_positions[i], square_order, jump_order, result.move, result.nodes);
+        result.depth = getLastSearchDepth();
+        result.stats = getLastSearchStats();
+        lock_guard<mutex> lock(m_mutex);
+        if(m_stop) {
+            // Cut short, so no good
+            return;
+        }
+        m_results[i] = result;
+        m_num_searched = i + 1;
+        m_searched.notify_all();
+    }
+}
+
+void startPondering(AsyncSearch& search, const Board& board, const Move& move, AiFuncPtr ai)
+{
+    search.cancel();
+    vector<Move> pv;
+    getPrincipalVariation(board, move, 2, pv);
+    Board after_move(board);
+    makeMove(after_move, move);
+
+    MoveList replies;
+    if(pv.size() == 2) {
+        replies.push_back(pv[1]);
+    }
+    findAllPossibleMoves(after_move, PLAYER1, replies);
+    vector<Board> positions;
+    for(const Move& reply : replies) {
+        Board position(after_move);
+        makeMove(position, reply);
+        // Clones of the same square from different pieces come to the same thing
+        bool seen = false;
+        for(const Board& earlier : positions) {
+            seen = seen || isSamePosition(earlier, position);
+        }
+        if(!seen && hasLegalMove(position, PLAYER2)) {
+            positions.push_back(position);
+        }
+    }
+    if(replies.empty() && hasLegalMove(after_move, PLAYER2)) {
+        positions.push_back(after_move);
+    }
+    // Like any other search, it gets a new generation in the table
+    newZobristGeneration();
+    search.start(positions, ai, true);
+}
+
+SearchResult searchWithPonder(AsyncSearch& ponder, const Board& board, AiFuncPtr ai, bool& ponder_hit)
+{
+    SearchResult result;
+    ponder_hit = ponder.claim(board, result);
+    if(ponder_hit) {
+        return result;
+    }
+    // Results from earlier moves are kept; they just age out
+    newZobristGeneration();
+    vector<int> square_order;
+    vector<int> jump_order;
+    makeSearchOrders(square_order, jump_order);
+    result.score = ai(board, square_order, jump_order, result.move, result.nodes);
+    result.depth = getLastSearchDepth();
+    result.stats = getLastSearchStats();
+    return result;
+}
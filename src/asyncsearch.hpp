@@ -0,0 +1,97 @@
+#ifndef SPLOT_ASYNCSEARCH_HPP
+#define SPLOT_ASYNCSEARCH_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "Board.hpp"
+#include "moves.hpp"
+#include "ai.hpp"
+
+// What a search came to, with what getLastSearchStats and getLastSearchDepth
+// would have said on the thread that ran it
+struct SearchResult
+{
+    Move move;
+    int score = 0;
+    long long nodes = 0;
+    int depth = 0;
+    SearchStats stats;
+};
+
+// Searches positions on a thread of its own, one after another, while the
+// caller gets on with something else, such as waiting for the user. The
+// positions all have player 2 to move. Whatever a search puts in the
+// transposition table stays there, even if it's cancelled, so a search that
+// wasn't needed after all still leaves the table warm.
+//
+// Only the calling thread may use the handle.
+class AsyncSearch
+{
+  public:
+    AsyncSearch() = default;
+    AsyncSearch(const AsyncSearch&) = delete;
+    AsyncSearch& operator=(const AsyncSearch&) = delete;
+
+    ~AsyncSearch()
+    {
+        cancel();
+    }
+
+    // Starts searching the positions in turn with ai, using the calling
+    // thread's search config, thread count and limits. If ponder is true, the
+    // searches are pondering (see SearchLimits::pondering): they don't watch
+    // the clock until claim starts it. Any searches already running are
+    // cancelled first.
+    void start(const std::vector<Board>& positions, AiFuncPtr ai, bool ponder);
+
+    // Stops the searches and waits for the thread to finish. Their results are
+    // thrown away. Does nothing if nothing was started.
+    void cancel();
+
+    // The position turned out to be the one that needs searching. If it's
+    // being searched, that search carries on as the real one (with its clock
+    // starting now, if it was pondering) and this waits for it to finish; if
+    // it has been searched already, that result is used. Either way the rest
+    // of the positions are dropped. Returns false, cancelling everything, if
+    // the position wasn't started or isn't one of them.
+    bool claim(const Board& position, SearchResult& result_out);
+
+    // How many of the positions have been searched to the end so far
+    int getNumSearched() const;
+
+  private:
+    void run(SearchLimits limits, const SearchConfig* config, int num_threads);
+
+    std::vector<Board> m_positions;
+    AiFuncPtr m_ai = nullptr;
+    std::thread m_thread;
+    std::atomic<bool> m_stop{false};
+    std::atomic<bool> m_pondering{false};
+
+    // Shared with the search thread
+    mutable std::mutex m_mutex;
+    std::condition_variable m_searched;     // Signalled when a search is done
+    std::vector<SearchResult> m_results;    // The first m_num_searched are valid
+    int m_num_searched = 0;
+    int m_last = 0;                         // Index of the last position to search
+};
+
+// Starts pondering after the engine (player 2) has played move in board, while
+// player 1 thinks of a reply: first on the position after the reply the
+// engine expects (the next move on the principal variation), then the
+// positions after each of the other replies, in the order
+// findAllPossibleMoves gives them. With time limits a search usually runs
+// until it's claimed or cancelled, so only the expected reply gets searched;
+// without them, the rest follow as the earlier ones finish. If player 1 has
+// no reply, the position is pondered as it is, since player 2 moves again.
+void startPondering(AsyncSearch& search, const Board& board, const Move& move, AiFuncPtr ai);
+
+// Searches board (player 2 to move) with ai on the calling thread, unless
+// ponder has been searching it (see AsyncSearch::claim). ponder_hit says
+// which. Whatever ponder was doing is over either way.
+SearchResult searchWithPonder(AsyncSearch& ponder, const Board& board, AiFuncPtr ai, bool& ponder_hit);
+
+#endif
@@ -0,0 +1,970 @@
+#include <cassert>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "Board.hpp"
+#include "moves.hpp"
+#include "ai.hpp"
+#include "bitboards.hpp"
+#include "movegen_bb.hpp"
+#include "zobrist.hpp"
+#include "solver.hpp"
+#include "eval.hpp"
+#include "selfplay.hpp"
+#include "notation.hpp"
+#include "asyncsearch.hpp"
+#include "multiplayer.hpp"
+#include "bench.hpp"
+
+using namespace std;
+
+namespace
+{
+
+// Positions are given row by row from the top: 'x' is player 1 (human), 'o' is
+// player 2 (AI), '.' is empty. The AI is always the one to move.
+const char* const BENCH_POSITIONS[] = {
+    // Opening, after a1b2
+    "x.....o"
+    ".x....."
+    "......."
+    "......."
+    "......."
+    "......."
+    "o.....x",
+
+    // Opening, player 1 has cloned twice
+    "x.....o"
+    "x......"
+    "......."
+    "......."
+    "......."
+    "......x"
+    "o.....x",
+
+    // Opening, first contact in the corner
+    "xx....o"
+    "......."
+    "......."
+    "......."
+    "......."
+    "......x"
+    "o....ox",
+};
+
+const int NUM_BENCH_POSITIONS = sizeof(BENCH_POSITIONS) / sizeof(BENCH_POSITIONS[0]);
+
+// The start position's bitboards (see initBoard)
+const Bitboard START_PLAYER1 = coordToBit(0, 0) | coordToBit(BOARD_SIZE - 1, BOARD_SIZE - 1);
+const Bitboard START_PLAYER2 = coordToBit(BOARD_SIZE - 1, 0) | coordToBit(0, BOARD_SIZE - 1);
+
+const struct { const char* name; AiFuncPtr ai; } BENCH_ENGINES[] = {
+    {"Iterative negamax", negamax_iterative_bb},
+    {"MTD(f)", mtdf_bb},
+    {"PVS", pvs_bb}
+};
+
+// For benchMultiplayer: the first three are BENCH_POSITIONS, for comparison
+const struct { int num_players; Player player; const char* layout; } MULTI_BENCH_POSITIONS[] = {
+    {2, PLAYER2, "x.....o"
+                 ".x....."
+                 "......."
+                 "......."
+                 "......."
+                 "......."
+                 "o.....x"},
+
+    {2, PLAYER2, "x.....o"
+                 "x......"
+                 "......."
+                 "......."
+                 "......."
+                 "......x"
+                 "o.....x"},
+
+    {2, PLAYER2, "xx....o"
+                 "......."
+                 "......."
+                 "......."
+                 "......."
+                 "......x"
+                 "o....ox"},
+
+    // Start
+    {3, PLAYER1, "x.....o"
+                 "......."
+                 "......."
+                 "......."
+                 "......."
+                 "......."
+                 "......3"},
+
+    // Opening, everybody has cloned
+    {3, PLAYER1, "x....oo"
+                 ".x....."
+                 "......."
+                 "......."
+                 "......."
+                 "......3"
+                 "......3"},
+
+    // Opening, first contact in the corner
+    {3, PLAYER1, "xx...oo"
+                 "x....o."
+                 "......."
+                 "......."
+                 "......."
+                 "......3"
+                 ".....33"},
+
+    // Start
+    {4, PLAYER1, "x.....o"
+                 "......."
+                 "......."
+                 "......."
+                 "......."
+                 "......."
+                 "4.....3"},
+
+    // Opening, everybody has cloned
+    {4, PLAYER1, "x....oo"
+                 ".x....."
+                 "......."
+                 "......."
+                 "......."
+                 "4....3."
+                 "4.....3"},
+
+    // Opening, first contact in the corner
+    {4, PLAYER1, "xx...oo"
+                 "x....o."
+                 "......."
+                 "......."
+                 "......."
+                 "4....3."
+                 "44...33"},
+};
+
+// Searches a bench position from an empty transposition table
+double timeSearch(AiFuncPtr ai, const char* layout, long long& nodes_searched, int* score_out = nullptr)
+{
+    using namespace std::chrono;
+
+    std::vector<int> square_order(NUM_SQUARES);
+    std::vector<int> jump_order(NUM_JUMPS);
+    for(int i = 0; i < NUM_SQUARES; ++i) {
+        square_order[i] = i;
+    }
+    for(int i = 0; i < NUM_JUMPS; ++i) {
+        jump_order[i] = i;
+    }
+
+    // The bench positions keep to the corners, so they fit any board without
+    // blocked squares there
+    Board board;
+    setupBoard(board, layout);
+    initZobristTable();
+    Move move;
+    nodes_searched = 0;
+    steady_clock::time_point t1 = steady_clock::now();
+    int score = ai(board, square_order, jump_order, move, nodes_searched);
+    steady_clock::time_point t2 = steady_clock::now();
+    if(score_out) {
+        *score_out = score;
+    }
+    return duration_cast<duration<double>>(t2 - t1).count();
+}
+
+// Leaves of the game tree depth plies down, counted as perft does: a player
+// with no moves ends the game
+long long countLeavesBB(Bitboard bb_me, Bitboard bb_him, int depth, const std::vector<int>& square_order,
+                        const std::vector<int>& jump_order)
+{
+    if(depth == 0) {
+        return 1;
+    }
+    StagedMoveGenBB move_gen(bb_me, bb_him, square_order, jump_order, BitboardMove(BBMOVE_NONE, 0, 0));
+    BitboardMove bbmove;
+    long long leaves = 0;
+    bool have_move = false;
+    while(move_gen.next(bbmove)) {
+        Bitboard me = bb_me;
+        Bitboard him = bb_him;
+        makeMoveBB(bbmove, me, him);
+        leaves += countLeavesBB(him, me, depth - 1, square_order, jump_order);
+        have_move = true;
+    }
+    return have_move ? leaves : 1;
+}
+
+// The same with the packed bitboards; a pass isn't a ply
+long long countLeavesMultiBB(const MultiPositionBB& position, int depth, const std::vector<int>& square_order,
+                             const std::vector<int>& jump_order)
+{
+    if(depth == 0) {
+        return 1;
+    }
+    int mover = findMultiMoverBB(position, invertBitboard(occupiedMultiBB(position)));
+    if(mover < 0) {
+        return 1;
+    }
+    MultiPositionBB turn(position);
+    setMultiTurnBB(turn, mover);
+    Bitboard bb_me = turn.pieces[mover];
+    StagedMoveGenBB move_gen(bb_me, occupiedMultiBB(turn) & ~bb_me, square_order, jump_order, BitboardMove(BBMOVE_NONE, 0, 0));
+    BitboardMove bbmove;
+    long long leaves = 0;
+    while(move_gen.next(bbmove)) {
+        MultiPositionBB child(turn);
+        makeMoveMultiBB(bbmove, child);
+        leaves += countLeavesMultiBB(child, depth - 1, square_order, jump_order);
+    }
+    return leaves;
+}
+
+// Searches a position of MULTI_BENCH_POSITIONS from an empty transposition table
+double timeMultiSearch(int num_players, Player player, const char* layout, MultiStrategy strategy, long long& nodes_searched)
+{
+    using namespace std::chrono;
+    Board board;
+    setupBoard(board, layout);
+    initZobristTable();
+    Move move;
+    nodes_searched = 0;
+    steady_clock::time_point t1 = steady_clock::now();
+    searchMultiBB(board, num_players, player, strategy, move, nodes_searched);
+    steady_clock::time_point t2 = steady_clock::now();
+    return duration_cast<duration<double>>(t2 - t1).count();
+}
+
+}
+
+void benchSmpScaling()
+{
+    const int THREAD_COUNTS[] = {1, 2, 4, 8};
+
+    int old_num_threads = getNumSearchThreads();
+    cout << "Lazy SMP scaling, " << MAX_PLY << " ply, " << thread::hardware_concurrency() << " hardware threads" << endl;
+    for(const auto& engine : BENCH_ENGINES) {
+        cout << endl << engine.name << endl;
+        cout << "threads      nodes    nodes/sec   time-to-depth   speedup" << endl;
+        double base_secs = 0;
+        for(int num_threads : THREAD_COUNTS) {
+            setNumSearchThreads(num_threads);
+            long long total_nodes = 0;
+            double total_secs = 0;
+            for(const char* layout : BENCH_POSITIONS) {
+                long long nodes_searched;
+                total_secs += timeSearch(engine.ai, layout, nodes_searched);
+                total_nodes += nodes_searched;
+            }
+            if(num_threads == 1) {
+                base_secs = total_secs;
+            }
+            cout << setw(7) << num_threads
+                 << setw(11) << total_nodes
+                 << setw(13) << (long long)(total_nodes / total_secs)
+                 << setw(15) << fixed << setprecision(3) << total_secs / NUM_BENCH_POSITIONS << "s"
+                 << setw(10) << setprecision(2) << base_secs / total_secs << "x"
+                 << defaultfloat << endl;
+        }
+    }
+    setNumSearchThreads(old_num_threads);
+}
+
+bool setupBoard(Board& board, const char* layout)
+{
+    const int LAYOUT_SIZE = 7;
+    // Where a piece on line i of the layout goes on the board, or -1 if it's
+    // in the middle and the board isn't 7x7
+    auto boardLine = [](int i) {
+        if(BOARD_SIZE == LAYOUT_SIZE || i < 2) {
+            return i;
+        }
+        return (i >= LAYOUT_SIZE - 2) ? i + BOARD_SIZE - LAYOUT_SIZE : -1;
+    };
+    for(int y = 0; y < BOARD_SIZE; ++y) {
+        for(int x = 0; x < BOARD_SIZE; ++x) {
+            board(x, y) = EMPTY_SQUARE;
+        }
+    }
+    bool fits = true;
+    for(int y = 0; y < LAYOUT_SIZE; ++y) {
+        for(int x = 0; x < LAYOUT_SIZE; ++x) {
+            char ch = layout[y*LAYOUT_SIZE + x];
+            assert(ch == 'x' || ch == 'o' || ch == '3' || ch == '4' || ch == '.');
+            if(ch == '.') {
+                continue;
+            }
+            Coord coord(boardLine(x), boardLine(y));
+            if(Board::isPlayable(coord)) {
+                board(coord) = (ch == 'x') ? PLAYER1 : (ch == 'o') ? PLAYER2 : (ch == '3') ? PLAYER3 : PLAYER4;
+            } else {
+                fits = false;
+            }
+        }
+    }
+    return fits;
+}
+
+void benchTranspositionTable()
+{
+    int old_num_threads = getNumSearchThreads();
+    setNumSearchThreads(1);
+    cout << "Transposition table, " << MAX_PLY << " ply, 1 thread" << endl;
+    for(const auto& engine : BENCH_ENGINES) {
+        cout << endl << engine.name << endl;
+        cout << "position      nodes    TT probes   hit rate      secs" << endl;
+        long long total_nodes = 0;
+        SearchStats total_stats;
+        double total_secs = 0;
+        for(int i = 0; i < NUM_BENCH_POSITIONS; ++i) {
+            long long nodes_searched;
+            double secs = timeSearch(engine.ai, BENCH_POSITIONS[i], nodes_searched);
+            const SearchStats& stats = getLastSearchStats();
+            cout << setw(8) << i + 1
+                 << setw(11) << nodes_searched
+                 << setw(13) << SearchStats::sumByDepth(stats.tt_probes)
+                 << setw(10) << fixed << setprecision(1) << 100.0 * SearchStats::sumByDepth(stats.tt_hits) / SearchStats::sumByDepth(stats.tt_probes) << "%"
+                 << setw(10) << setprecision(3) << secs
+                 << defaultfloat << endl;
+            total_nodes += nodes_searched;
+            total_stats.add(stats);
+            total_secs += secs;
+        }
+        cout << "   total"
+             << setw(11) << total_nodes
+             << setw(13) << SearchStats::sumByDepth(total_stats.tt_probes)
+             << setw(10) << fixed << setprecision(1) << 100.0 * SearchStats::sumByDepth(total_stats.tt_hits) / SearchStats::sumByDepth(total_stats.tt_probes) << "%"
+             << setw(10) << setprecision(3) << total_secs
+             << defaultfloat << endl;
+    }
+    setNumSearchThreads(old_num_threads);
+}
+
+void benchPageSizes()
+{
+    using namespace std::chrono;
+
+    const int NUM_PROBES = 20000000;
+
+    size_t num_entries = getZobristTableEntries();
+    PageSize old_page_size = getZobristTablePageSize();
+    cout << "Page sizes, " << num_entries * sizeof(ZobristEntry) / 0x100000 << " MB table" << endl << endl;
+    cout << "pages                      probes/sec   MTD(f) nodes/sec" << endl;
+    for(bool try_huge_pages : {false, true}) {
+        if(!resizeZobristTable(num_entries, try_huge_pages)) {
+            cout << "Couldn't allocate table" << endl;
+            return;
+        }
+
+        // Fill the whole table so every page is really there, then probe it at random
+        std::mt19937_64 rng(1);
+        for(size_t i = 0; i < num_entries; ++i) {
+            setZobristValueBB(rng(), ZobristValue(0, 0, 1));
+        }
+        steady_clock::time_point t1 = steady_clock::now();
+        for(int i = 0; i < NUM_PROBES; ++i) {
+            getZobristValueBB(rng());
+        }
+        steady_clock::time_point t2 = steady_clock::now();
+        double probe_secs = duration_cast<duration<double>>(t2 - t1).count();
+
+        long long total_nodes = 0;
+        double total_secs = 0;
+        for(const char* layout : BENCH_POSITIONS) {
+            long long nodes_searched;
+            total_secs += timeSearch(mtdf_bb, layout, nodes_searched);
+            total_nodes += nodes_searched;
+        }
+
+        cout << left << setw(25) << getPageSizeName(getZobristTablePageSize()) << right
+             << setw(12) << (long long)(NUM_PROBES / probe_secs)
+             << setw(19) << (long long)(total_nodes / total_secs) << endl;
+    }
+    resizeZobristTable(num_entries, old_page_size != PAGES_NORMAL);
+}
+
+void benchHashing()
+{
+    using namespace std::chrono;
+
+    // Few enough samples to stay in cache, as the position does during a search
+    const int NUM_SAMPLES = 10000;
+    const int NUM_PASSES = 2000;
+
+    // A move from a random game: the position after it, and what the move changed
+    struct HashSample
+    {
+        Bitboard player1, player2;
+        int player_sign;
+        ZobristHash hash_before;
+        int me;
+        Bitboard me_changed, captured;
+    };
+
+    std::vector<HashSample> samples;
+    samples.reserve(NUM_SAMPLES);
+    std::mt19937 rng(1);
+    Bitboard bb_player[2] = {0, 0};
+    int me = 0;
+    while(int(samples.size()) < NUM_SAMPLES) {
+        // Pick a random move, counting clones from different pieces separately
+        Bitboard bb_empty = invertBitboard(bb_player[0] | bb_player[1]);
+        MoveList moves;
+        for(int src = 0; src < NUM_SQUARES; ++src) {
+            if(bb_player[me] & (Bitboard(1) << src)) {
+                for(int dst = 0; dst < NUM_SQUARES; ++dst) {
+                    int dx = src % BOARD_SIZE - dst % BOARD_SIZE;
+                    int dy = src / BOARD_SIZE - dst / BOARD_SIZE;
+                    if((bb_empty & (Bitboard(1) << dst)) && dx >= -2 && dx <= 2 && dy >= -2 && dy <= 2) {
+                        Move move = {Coord(src % BOARD_SIZE, src / BOARD_SIZE), Coord(dst % BOARD_SIZE, dst / BOARD_SIZE)};
+                        moves.push_back(move);
+                    }
+                }
+            }
+        }
+        if(moves.empty() || bb_player[1 - me] == 0) {
+            // Game over; start a new one
+            bb_player[0] = START_PLAYER1;
+            bb_player[1] = START_PLAYER2;
+            me = 0;
+            continue;
+        }
+        const Move& move = moves[rng() % moves.size()];
+        int src = move.src.y*BOARD_SIZE + move.src.x;
+        int dst = move.dst.y*BOARD_SIZE + move.dst.x;
+        int dx = move.dst.x - move.src.x;
+        int dy = move.dst.y - move.src.y;
+
+        HashSample sample;
+        int player_sign = (me == 1) ? 1 : -1;
+        sample.hash_before = calcHashBB(bb_player[0], bb_player[1], player_sign);
+        sample.me = me;
+        Bitboard me_before = bb_player[me];
+        sample.captured = bb_player[1 - me] & BITBOARD_SURROUNDS[dst];
+        bb_player[me] |= (Bitboard(1) << dst) | sample.captured;
+        bb_player[1 - me] &= ~sample.captured;
+        if(dx < -1 || dx > 1 || dy < -1 || dy > 1) {
+            bb_player[me] &= ~(Bitboard(1) << src);
+        }
+        sample.me_changed = me_before ^ bb_player[me];
+        sample.player1 = bb_player[0];
+        sample.player2 = bb_player[1];
+        sample.player_sign = -player_sign;
+        samples.push_back(sample);
+        me = 1 - me;
+    }
+
+    ZobristHash full_sum = 0;
+    steady_clock::time_point t1 = steady_clock::now();
+    for(int pass = 0; pass < NUM_PASSES; ++pass) {
+        for(const HashSample& sample : samples) {
+            full_sum ^= calcHashBB(sample.player1, sample.player2, sample.player_sign);
+        }
+    }
+    steady_clock::time_point t2 = steady_clock::now();
+    ZobristHash incremental_sum = 0;
+    for(int pass = 0; pass < NUM_PASSES; ++pass) {
+        for(const HashSample& sample : samples) {
+            incremental_sum ^= updateHashBB(sample.hash_before, sample.me, sample.me_changed, sample.captured);
+        }
+    }
+    steady_clock::time_point t3 = steady_clock::now();
+
+    double num_hashes = double(NUM_SAMPLES) * NUM_PASSES;
+    cout << "Hashing, " << ZOBRIST_FRAGMENT_BITS << "-bit fragments, " << NUM_SAMPLES << " moves from random games" << endl;
+    cout << "calcHashBB:    " << fixed << setprecision(2) << 1e9 * duration_cast<duration<double>>(t2 - t1).count() / num_hashes << " ns/node" << endl;
+    cout << "updateHashBB:  " << 1e9 * duration_cast<duration<double>>(t3 - t2).count() / num_hashes << " ns/node" << defaultfloat << endl;
+    cout << (full_sum == incremental_sum ? "Hashes agree" : "HASHES DISAGREE") << endl;
+}
+
+void benchSearchConfigs()
+{
+    const int CONFIG_BENCH_DEPTH = 5;
+
+    int old_num_threads = getNumSearchThreads();
+    SearchLimits old_limits = getSearchLimits();
+    const SearchConfig& old_config = getSearchConfig();
+    setNumSearchThreads(1);
+    SearchLimits limits;
+    limits.depth = CONFIG_BENCH_DEPTH;
+    setSearchLimits(limits);
+    cout << "Search configs, " << CONFIG_BENCH_DEPTH << " ply, 1 thread" << endl;
+    for(const auto& engine : BENCH_ENGINES) {
+        cout << endl << engine.name << endl;
+        cout << "config             nodes      secs   scores" << endl;
+        for(int i = 0; i < NUM_SEARCH_CONFIGS; ++i) {
+            setSearchConfig(SEARCH_CONFIGS[i]);
+            long long total_nodes = 0;
+            double total_secs = 0;
+            cout << left << setw(12) << SEARCH_CONFIGS[i].name << right;
+            string scores;
+            for(const char* layout : BENCH_POSITIONS) {
+                long long nodes_searched;
+                int score;
+                total_secs += timeSearch(engine.ai, layout, nodes_searched, &score);
+                total_nodes += nodes_searched;
+                scores += " " + to_string(score);
+            }
+            cout << setw(12) << total_nodes
+                 << setw(10) << fixed << setprecision(3) << total_secs << defaultfloat
+                 << "  " << scores << endl;
+        }
+    }
+    setSearchConfig(old_config);
+    setSearchLimits(old_limits);
+    setNumSearchThreads(old_num_threads);
+}
+
+void benchEndgameSolver()
+{
+    using namespace std::chrono;
+
+    const int POSITIONS_PER_COUNT = 20;
+    const int FIRST_EMPTIES = 1;
+    const double TIME_LIMIT_SECS = 1.0;
+
+    cout << "Endgame solver, " << POSITIONS_PER_COUNT << " positions from random games per number of empty squares" << endl;
+    cout << "empties   win/loss avg   margin avg   margin max   nodes/sec" << endl;
+    std::mt19937 rng(1);
+    int largest_solved = 0;
+    for(int num_empty = FIRST_EMPTIES; num_empty <= MAX_SOLVER_EMPTIES; ++num_empty) {
+        // Play random games until one reaches num_empty empty squares with the
+        // player to move still in the game
+        std::vector<Bitboard> positions;
+        while(int(positions.size()) < 2 * POSITIONS_PER_COUNT) {
+            Bitboard bb_player[2] = {START_PLAYER1, START_PLAYER2};
+            int me = 0;
+            while(true) {
+                Bitboard bb_empty = invertBitboard(bb_player[0] | bb_player[1]);
+                Bitboard targets = moveTargets(bb_player[me], bb_empty);
+                if(targets == 0) {
+                    break;
+                }
+                if(countSetBits(bb_empty) == num_empty) {
+                    positions.push_back(bb_player[me]);
+                    positions.push_back(bb_player[1 - me]);
+                    break;
+                }
+                // A random target square, cloned into if possible
+                int skip = rng() % countSetBits(targets);
+                for(int i = 0; i < skip; ++i) {
+                    targets &= targets - 1;
+                }
+                int dest = lowestSetSquare(targets);
+                Bitboard captured = BITBOARD_SURROUNDS[dest] & bb_player[1 - me];
+                if(!(BITBOARD_SURROUNDS[dest] & bb_player[me])) {
+                    bb_player[me] &= ~(Bitboard(1) << lowestSetSquare(BITBOARD_JUMP_TARGETS[dest] & bb_player[me]));
+                }
+                bb_player[me] |= (Bitboard(1) << dest) | captured;
+                bb_player[1 - me] ^= captured;
+                me = 1 - me;
+            }
+        }
+
+        double wdl_secs = 0;
+        double margin_secs = 0;
+        double max_secs = 0;
+        long long total_nodes = 0;
+        for(int i = 0; i < POSITIONS_PER_COUNT; ++i) {
+            for(bool exact_margin : {false, true}) {
+                SearchState ss;
+                BitboardMove move;
+                int margin;
+                steady_clock::time_point t1 = steady_clock::now();
+                solveEndgameBB(positions[2*i], positions[2*i + 1], exact_margin, move, margin, ss);
+                double secs = duration_cast<duration<double>>(steady_clock::now() - t1).count();
+                if(exact_margin) {
+                    margin_secs += secs;
+                    max_secs = max(max_secs, secs);
+                    total_nodes += ss.nodes_searched;
+                } else {
+                    wdl_secs += secs;
+                }
+            }
+        }
+        cout << setw(7) << num_empty
+             << setw(14) << fixed << setprecision(4) << wdl_secs / POSITIONS_PER_COUNT << "s"
+             << setw(12) << margin_secs / POSITIONS_PER_COUNT << "s"
+             << setw(12) << max_secs << "s"
+             << setw(12) << (long long)(total_nodes / max(margin_secs, 1e-9))
+             << defaultfloat << endl;
+        if(max_secs > TIME_LIMIT_SECS) {
+            break;
+        }
+        largest_solved = num_empty;
+    }
+    cout << "Every position with up to " << largest_solved << " empty squares solved in under " << TIME_LIMIT_SECS << " s" << endl;
+}
+
+void benchEvaluation(const MatchSettings& settings)
+{
+    using namespace std::chrono;
+
+    // Few enough samples to stay in cache, as the position does during a search
+    const int NUM_SAMPLES = 10000;
+    const int NUM_PASSES = 1000;
+    const int MATCH_DEPTH = 4;
+
+    SearchLimits old_limits = getSearchLimits();
+    int old_num_threads = getNumSearchThreads();
+    EvalWeights features = old_limits.eval_weights;
+    if(features.countsOnlyPieces()) {
+        features = FEATURE_EVAL_WEIGHTS;
+    }
+    cout << "Evaluation: pieces only versus";
+    for(int feature = 0; feature < NUM_EVAL_FEATURES; ++feature) {
+        cout << " " << EVAL_FEATURE_NAMES[feature] << " " << features.weights[feature];
+    }
+    cout << endl << endl;
+
+    // Positions from random games, with every square a player can move to
+    // equally likely
+    std::vector<Bitboard> samples;
+    samples.reserve(2 * NUM_SAMPLES);
+    std::mt19937 rng(1);
+    Bitboard bb_player[2] = {0, 0};
+    int me = 0;
+    while(int(samples.size()) < 2 * NUM_SAMPLES) {
+        Bitboard bb_empty = invertBitboard(bb_player[0] | bb_player[1]);
+        Bitboard targets = moveTargets(bb_player[me], bb_empty);
+        if(targets == 0 || bb_player[1 - me] == 0) {
+            bb_player[0] = START_PLAYER1;
+            bb_player[1] = START_PLAYER2;
+            me = 0;
+            continue;
+        }
+        int skip = rng() % countSetBits(targets);
+        for(int i = 0; i < skip; ++i) {
+            targets &= targets - 1;
+        }
+        int dest = lowestSetSquare(targets);
+        Bitboard captured = BITBOARD_SURROUNDS[dest] & bb_player[1 - me];
+        if(!(BITBOARD_SURROUNDS[dest] & bb_player[me])) {
+            bb_player[me] &= ~(Bitboard(1) << lowestSetSquare(BITBOARD_JUMP_TARGETS[dest] & bb_player[me]));
+        }
+        bb_player[me] |= (Bitboard(1) << dest) | captured;
+        bb_player[1 - me] ^= captured;
+        me = 1 - me;
+        samples.push_back(bb_player[0]);
+        samples.push_back(bb_player[1]);
+    }
+
+    long long material_sum = 0;
+    steady_clock::time_point t1 = steady_clock::now();
+    for(int pass = 0; pass < NUM_PASSES; ++pass) {
+        for(int i = 0; i < NUM_SAMPLES; ++i) {
+            material_sum += countSetBits(samples[2*i + 1]) - countSetBits(samples[2*i]);
+        }
+    }
+    steady_clock::time_point t2 = steady_clock::now();
+    long long feature_sum = 0;
+    for(int pass = 0; pass < NUM_PASSES; ++pass) {
+        for(int i = 0; i < NUM_SAMPLES; ++i) {
+            feature_sum += evalFeaturesBB(samples[2*i], samples[2*i + 1], features);
+        }
+    }
+    steady_clock::time_point t3 = steady_clock::now();
+    double num_evals = double(NUM_SAMPLES) * NUM_PASSES;
+    cout << "Pieces only:   " << fixed << setprecision(2) << 1e9 * duration_cast<duration<double>>(t2 - t1).count() / num_evals << " ns/eval" << endl;
+    cout << "Features:      " << 1e9 * duration_cast<duration<double>>(t3 - t2).count() / num_evals << " ns/eval" << defaultfloat << endl;
+    // Also keeps the loops from being optimized away
+    cout << "Average score: " << fixed << setprecision(2) << (double)material_sum / num_evals << " pieces, "
+         << (double)feature_sum / num_evals << " with features" << defaultfloat << endl;
+
+    // The whole search: the features cost more than the evaluations
+    // themselves, since the frontier can't be evaluated in one pass (see
+    // evalChildrenBB) unless only pieces count
+    setNumSearchThreads(1);
+    cout << endl << "MTD(f), " << old_limits.depth << " ply, 1 thread" << endl;
+    cout << "eval            nodes    nodes/sec      secs" << endl;
+    for(int with_features = 0; with_features < 2; ++with_features) {
+        SearchLimits limits = old_limits;
+        limits.eval_weights = with_features ? features : MATERIAL_EVAL_WEIGHTS;
+        setSearchLimits(limits);
+        long long total_nodes = 0;
+        double total_secs = 0;
+        for(const char* layout : BENCH_POSITIONS) {
+            long long nodes_searched;
+            total_secs += timeSearch(mtdf_bb, layout, nodes_searched);
+            total_nodes += nodes_searched;
+        }
+        cout << left << setw(10) << (with_features ? "features" : "pieces") << right
+             << setw(11) << total_nodes
+             << setw(13) << (long long)(total_nodes / total_secs)
+             << setw(10) << fixed << setprecision(3) << total_secs << defaultfloat << endl;
+    }
+    setSearchLimits(old_limits);
+    setNumSearchThreads(old_num_threads);
+
+    // Strength at the same depth. At the same time, play a match with -eval
+    // and -movetime instead.
+    cout << endl;
+    MatchPlayer players[2];
+    for(int with_features = 0; with_features < 2; ++with_features) {
+        MatchPlayer& player = players[1 - with_features];
+        player.name = with_features ? "features" : "pieces";
+        player.ai = mtdf_bb;
+        player.config = &getSearchConfig();
+        player.limits = old_limits;
+        player.limits.depth = MATCH_DEPTH;
+        player.limits.eval_weights = with_features ? features : MATERIAL_EVAL_WEIGHTS;
+    }
+    runMatch(players[0], players[1], settings);
+}
+
+void benchPondering()
+{
+    using namespace std::chrono;
+    const int NUM_ENGINE_MOVES = 20;
+    const int DEFAULT_MOVE_TIME_MS = 100;
+    const int OPPONENT_DEPTH = 4;
+    const int THINK_TIME_MS = 500;
+    const ZobristHash OPPONENT_TABLE_KEY = 0x6A09E667F3BCC908LL;
+
+    SearchLimits old_limits = getSearchLimits();
+    SearchLimits limits = old_limits;
+    if(limits.move_time_ms == 0 && limits.clock_ms == 0) {
+        limits.move_time_ms = DEFAULT_MOVE_TIME_MS;
+    }
+    limits.depth = MAX_SEARCH_DEPTH;
+    SearchLimits opponent_limits = old_limits;
+    opponent_limits.depth = OPPONENT_DEPTH;
+    opponent_limits.move_time_ms = opponent_limits.clock_ms = 0;
+    opponent_limits.nodes = 0;
+
+    cout << "Pondering: MTD(f) with " << limits.move_time_ms << " ms a move, against MTD(f) at "
+         << OPPONENT_DEPTH << " ply taking " << THINK_TIME_MS << " ms a move" << endl;
+    std::vector<int> square_order(NUM_SQUARES);
+    std::vector<int> jump_order(NUM_JUMPS);
+    for(int i = 0; i < NUM_SQUARES; ++i) {
+        square_order[i] = i;
+    }
+    for(int i = 0; i < NUM_JUMPS; ++i) {
+        jump_order[i] = i;
+    }
+
+    // Depth the engine completed on each of its moves, without pondering and with
+    int depths[2][NUM_ENGINE_MOVES] = {};
+    bool hits[NUM_ENGINE_MOVES] = {};
+    int num_moves[2] = {0, 0};
+    for(int ponder = 0; ponder < 2; ++ponder) {
+        AsyncSearch ponder_search;
+        Board board;
+        Player to_move;
+        parseFen(getStartFen(), board, to_move);
+        initZobristTable();
+        while(num_moves[ponder] < NUM_ENGINE_MOVES) {
+            bool player1_can_move = hasLegalMove(board, PLAYER1);
+            if(player1_can_move) {
+                // The opponent's search takes a few milliseconds, and the
+                // rest of its time it spends thinking, as people do
+                steady_clock::time_point think_start = steady_clock::now();
+                Board swapped(board);
+                swapPlayers(swapped);
+                setSearchLimits(opponent_limits);
+                setSearchTableKey(OPPONENT_TABLE_KEY);
+                Move move;
+                long long nodes_searched = 0;
+                mtdf_bb(swapped, square_order, jump_order, move, nodes_searched);
+                setSearchTableKey(0);
+                this_thread::sleep_until(think_start + milliseconds(THINK_TIME_MS));
+                makeMove(board, move);
+            }
+            if(!hasLegalMove(board, PLAYER2)) {
+                if(!player1_can_move) {
+                    break;
+                }
+                continue;
+            }
+            setSearchLimits(limits);
+            bool ponder_hit;
+            SearchResult result = searchWithPonder(ponder_search, board, mtdf_bb, ponder_hit);
+            depths[ponder][num_moves[ponder]] = result.depth;
+            if(ponder) {
+                hits[num_moves[ponder]] = ponder_hit;
+                startPondering(ponder_search, board, result.move, mtdf_bb);
+            }
+            ++num_moves[ponder];
+            makeMove(board, result.move);
+        }
+    }
+    setSearchLimits(old_limits);
+
+    cout << "move   depth without   depth with pondering" << endl;
+    double depth_sums[2] = {0, 0};
+    int num_hits = 0;
+    for(int i = 0; i < max(num_moves[0], num_moves[1]); ++i) {
+        cout << setw(4) << i + 1;
+        for(int ponder = 0; ponder < 2; ++ponder) {
+            if(i < num_moves[ponder]) {
+                cout << setw(ponder ? 13 : 16) << depths[ponder][i];
+                depth_sums[ponder] += depths[ponder][i];
+            } else {
+                cout << setw(ponder ? 13 : 16) << "-";
+            }
+        }
+        if(i < num_moves[1] && hits[i]) {
+            cout << " (ponder hit)";
+            ++num_hits;
+        }
+        cout << endl;
+    }
+    cout << "mean" << fixed << setprecision(2)
+         << setw(16) << depth_sums[0] / max(1, num_moves[0])
+         << setw(13) << depth_sums[1] / max(1, num_moves[1]) << defaultfloat << endl;
+    cout << "Ponder hits: " << num_hits << " of " << num_moves[1] << endl;
+}
+
+void benchGeometry()
+{
+    using namespace std::chrono;
+
+    const int LEAF_COUNT_DEPTH = 5;
+
+    int num_symmetries = 0;
+    for(int symmetry = 0; symmetry < NUM_SYMMETRIES; ++symmetry) {
+        num_symmetries += SYMMETRY_VALID[symmetry] ? 1 : 0;
+    }
+    cout << "Board " << BOARD_SIZE << "x" << BOARD_SIZE << ", "
+         << (HAS_BLOCKED_SQUARES ? string("blocked ") + BLOCKED_SQUARE_NAMES : string("no blocked squares")) << ": "
+         << NUM_PLAYABLE_SQUARES << " playable squares, " << num_symmetries << " symmetries" << endl;
+
+    std::vector<int> square_order(NUM_SQUARES);
+    std::vector<int> jump_order(NUM_JUMPS);
+    for(int i = 0; i < NUM_SQUARES; ++i) {
+        square_order[i] = i;
+    }
+    for(int i = 0; i < NUM_JUMPS; ++i) {
+        jump_order[i] = i;
+    }
+    long long total_leaves = 0;
+    steady_clock::time_point t1 = steady_clock::now();
+    for(const char* layout : BENCH_POSITIONS) {
+        Board board;
+        setupBoard(board, layout);
+        Bitboard bb_player1, bb_player2;
+        convBoardToBitboards(board, bb_player1, bb_player2);
+        total_leaves += countLeavesBB(bb_player2, bb_player1, LEAF_COUNT_DEPTH, square_order, jump_order);
+    }
+    double leaf_secs = duration_cast<duration<double>>(steady_clock::now() - t1).count();
+    cout << "Move generation, " << LEAF_COUNT_DEPTH << " ply: " << total_leaves << " leaves, "
+         << (long long)(total_leaves / leaf_secs) << " leaves/sec" << endl << endl;
+
+    int old_num_threads = getNumSearchThreads();
+    setNumSearchThreads(1);
+    cout << "Search, " << MAX_PLY << " ply, 1 thread" << endl;
+    cout << "engine                    nodes    nodes/sec      secs" << endl;
+    for(const auto& engine : BENCH_ENGINES) {
+        long long total_nodes = 0;
+        double total_secs = 0;
+        for(const char* layout : BENCH_POSITIONS) {
+            long long nodes_searched;
+            total_secs += timeSearch(engine.ai, layout, nodes_searched);
+            total_nodes += nodes_searched;
+        }
+        cout << left << setw(18) << engine.name << right
+             << setw(13) << total_nodes
+             << setw(13) << (long long)(total_nodes / total_secs)
+             << setw(10) << fixed << setprecision(3) << total_secs
+             << defaultfloat << endl;
+    }
+    setNumSearchThreads(old_num_threads);
+}
+
+void benchMultiplayer()
+{
+    using namespace std::chrono;
+
+    const int LEAF_COUNT_DEPTH = 5;
+    const int MULTI_BENCH_DEPTH = 6;
+
+    std::vector<int> square_order(NUM_SQUARES);
+    std::vector<int> jump_order(NUM_JUMPS);
+    for(int i = 0; i < NUM_SQUARES; ++i) {
+        square_order[i] = i;
+    }
+    for(int i = 0; i < NUM_JUMPS; ++i) {
+        jump_order[i] = i;
+    }
+
+    // Two players get the two-bitboard generator as well as the packed one
+    cout << "Move generation, " << LEAF_COUNT_DEPTH << " ply" << endl;
+    cout << "players  generator          leaves   leaves/sec" << endl;
+    for(int num_players = 2; num_players <= MAX_PLAYERS; ++num_players) {
+        for(int packed = (num_players == 2) ? 0 : 1; packed <= 1; ++packed) {
+            long long total_leaves = 0;
+            steady_clock::time_point t1 = steady_clock::now();
+            for(const auto& position : MULTI_BENCH_POSITIONS) {
+                if(position.num_players != num_players) {
+                    continue;
+                }
+                Board board;
+                setupBoard(board, position.layout);
+                MultiPositionBB multi;
+                convBoardToMultiBB(board, num_players, position.player, multi);
+                if(packed) {
+                    total_leaves += countLeavesMultiBB(multi, LEAF_COUNT_DEPTH, square_order, jump_order);
+                } else {
+                    Bitboard bb_me = multi.pieces[multi.to_move];
+                    total_leaves += countLeavesBB(bb_me, occupiedMultiBB(multi) & ~bb_me, LEAF_COUNT_DEPTH, square_order,
+                                                  jump_order);
+                }
+            }
+            double secs = duration_cast<duration<double>>(steady_clock::now() - t1).count();
+            cout << setw(7) << num_players << "  " << left << setw(12) << (packed ? "packed" : "two-player") << right
+                 << setw(13) << total_leaves << setw(13) << (long long)(total_leaves / secs) << endl;
+        }
+    }
+
+    int old_num_threads = getNumSearchThreads();
+    SearchLimits old_limits = getSearchLimits();
+    setNumSearchThreads(1);
+    SearchLimits limits;
+    limits.depth = MULTI_BENCH_DEPTH;
+    limits.solve_empties = 0;
+    setSearchLimits(limits);
+    cout << endl << "Search, " << MULTI_BENCH_DEPTH << " ply, 1 thread" << endl;
+    cout << "players  strategy           nodes    nodes/sec      secs" << endl;
+    for(int num_players = 2; num_players <= MAX_PLAYERS; ++num_players) {
+        // The two-player engine, for comparison
+        if(num_players == 2) {
+            long long total_nodes = 0;
+            double total_secs = 0;
+            for(const auto& position : MULTI_BENCH_POSITIONS) {
+                if(position.num_players == 2) {
+                    long long nodes_searched;
+                    total_secs += timeSearch(negamax_iterative_bb, position.layout, nodes_searched);
+                    total_nodes += nodes_searched;
+                }
+            }
+            cout << setw(7) << num_players << "  " << left << setw(12) << "negamax" << right
+                 << setw(13) << total_nodes
+                 << setw(13) << (long long)(total_nodes / total_secs)
+                 << setw(10) << fixed << setprecision(3) << total_secs << defaultfloat << endl;
+        }
+        for(int strategy = 0; strategy < NUM_MULTI_STRATEGIES; ++strategy) {
+            long long total_nodes = 0;
+            double total_secs = 0;
+            for(const auto& position : MULTI_BENCH_POSITIONS) {
+                if(position.num_players == num_players) {
+                    long long nodes_searched;
+                    total_secs += timeMultiSearch(num_players, position.player, position.layout, MultiStrategy(strategy),
+                                                  nodes_searched);
+                    total_nodes += nodes_searched;
+                }
+            }
+            cout << setw(7) << num_players << "  " << left << setw(12) << MULTI_STRATEGY_NAMES[strategy] << right
+                 << setw(13) << total_nodes
+                 << setw(13) << (long long)(total_nodes / total_secs)
+                 << setw(10) << fixed << setprecision(3) << total_secs << defaultfloat << endl;
+        }
+    }
+    setSearchLimits(old_limits);
+    setNumSearchThreads(old_num_threads);
+}
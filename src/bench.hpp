@@ -0,0 +1,64 @@
+#ifndef SPLOT_BENCH_HPP
+#define SPLOT_BENCH_HPP
+
+#include "Board.hpp"
+#include "selfplay.hpp"
+
+// Sets up a position given row by row from the top: 'x' is player 1, 'o' is
+// player 2, '3' and '4' are players 3 and 4, '.' is empty. Layouts are drawn on a 7x7 board; on a board of
+// another size, pieces within two squares of an edge keep their distance to
+// it, so a layout that keeps to the corners means the same on any board.
+// Returns false, leaving out the pieces that don't fit, if a piece is in the
+// middle of a board that isn't 7x7 or on a blocked square.
+bool setupBoard(Board& board, const char* layout);
+
+// Lazy SMP scaling report: nodes/sec and time to reach MAX_PLY at 1, 2, 4 and 8
+// threads, over a fixed set of positions.
+void benchSmpScaling();
+
+// Transposition table effectiveness: nodes to reach MAX_PLY and probe hit rate
+// for each bench position.
+void benchTranspositionTable();
+
+// Probe throughput and search speed with the transposition table on 4 KB pages
+// versus 2 MB pages, at the current table size.
+void benchPageSizes();
+
+// Cost of hashing a position from scratch with calcHashBB versus updating the
+// parent's hash with updateHashBB, over moves from random games.
+void benchHashing();
+
+// Every registered search config side by side: nodes and time to a fixed depth
+// over the bench positions, and the scores, which should all agree.
+void benchSearchConfigs();
+
+// How long the endgame solver takes, for win/loss only and for the exact
+// margin, by the number of empty squares, on positions from random games. Goes
+// on until some position takes more than a second.
+void benchEndgameSolver();
+
+// The evaluation with features (the -eval weights, or FEATURE_EVAL_WEIGHTS if
+// those only count pieces) against the one that only counts pieces: the cost
+// of an evaluation, nodes/sec and time to depth for MTD(f), and a match at
+// the same depth, played with settings.
+void benchEvaluation(const MatchSettings& settings);
+
+// Depth completed on each move of a game against a quick opponent that then
+// pretends to think for a while, without pondering and with. The engine gets
+// -movetime or the clock, if given, or else 100 ms a move.
+void benchPondering();
+
+// What this build's board geometry (see SPLOT_BOARD_SIZE and
+// SPLOT_BLOCKED_SQUARES) costs: leaves/sec generating moves a few plies deep,
+// and nodes/sec for each engine to MAX_PLY, over the bench positions. Build
+// the program for each geometry to compare them.
+void benchGeometry();
+
+// The engines for three and four players (see multiplayer.hpp) next to the
+// two-player ones: leaves/sec generating moves a few plies deep with the packed
+// bitboards and with the two-player generator, and nodes/sec for paranoid and
+// max^n searches and the two-player iterative negamax to a fixed depth, over
+// openings for each number of players.
+void benchMultiplayer();
+
+#endif
@@ -7,3 +7,18 @@ int countSetBits(Bitboard bitboard)
     bitboard = (bitboard & 0x3333333333333333LL) + ((bitboard >> 2) & 0x3333333333333333LL);
     return (((bitboard + (bitboard >> 4)) & 0xF0F0F0F0F0F0F0FLL) * 0x101010101010101LL) >> 56;
 }
+
+void convBoardToBitboards(const Board& board, Bitboard& player1, Bitboard& player2)
+{
+    player1 = board.getPieces(PLAYER1);
+    player2 = board.getPieces(PLAYER2);
+    assert(board.getOccupied() == (player1 | player2));
+}
+
+void convBitboardsToBoard(Bitboard player1, Bitboard player2, Board& board)
+{
+    assert(!(player1 & player2));
+    board = Board();
+    board.setPieces(PLAYER1, player1);
+    board.setPieces(PLAYER2, player2);
+}
@@ -2,6 +2,10 @@
 #define SPLOT_BITBOARDS_HPP
 
 #include <cstdint>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#include "Board.hpp"
 #include "moves.hpp"
 
 typedef std::uint64_t Bitboard;
@@ -13,16 +17,492 @@ struct BitboardJump
 };
 
 const int NUM_JUMPS = 16;
-extern const Bitboard BITBOARD_SURROUNDS[NUM_SQUARES];
-extern const BitboardJump BITBOARD_JUMPS[NUM_SQUARES][NUM_JUMPS];
-extern const Coord JUMP_COORDS[NUM_JUMPS];
+
+// A plain array that can be filled in by constexpr functions (std::array can't
+// be written to in a constant expression before C++17)
+template<typename T, int N>
+struct LookupTable
+{
+    T entries[N];
+
+    constexpr T& operator[](int i)
+    {
+        return entries[i];
+    }
+
+    constexpr const T& operator[](int i) const
+    {
+        return entries[i];
+    }
+};
+
+// The square's bit, or 0 if it's off the board or blocked. The tables below
+// are built from this, so they leave out blocked squares without any checks.
+constexpr Bitboard coordToBit(int x, int y)
+{
+    return Board::isPlayable(Coord(x, y)) ? Bitboard(1) << (y*BOARD_SIZE + x) : 0;
+}
+
+// The same, but blocked squares have a bit too. For masks of the board's shape.
+constexpr Bitboard coordToBoardBit(int x, int y)
+{
+    return Board::isInRange(Coord(x, y)) ? Bitboard(1) << (y*BOARD_SIZE + x) : 0;
+}
+
+// The squares surrounding (x, y), i.e. those that can clone into it and that
+// get captured when a piece lands on it
+constexpr Bitboard calcSurrounds(int x, int y)
+{
+    Bitboard bitboard = 0;
+    if(Board::isPlayable(Coord(x, y))) {
+        for(int y2 = y - 1; y2 <= y + 1; ++y2) {
+            for(int x2 = x - 1; x2 <= x + 1; ++x2) {
+                if(x2 != x || y2 != y) {
+                    bitboard |= coordToBit(x2, y2);
+                }
+            }
+        }
+    }
+    return bitboard;
+}
+
+constexpr LookupTable<Bitboard, NUM_SQUARES> makeSurrounds()
+{
+    LookupTable<Bitboard, NUM_SQUARES> surrounds = {};
+    for(int square_num = 0; square_num < NUM_SQUARES; ++square_num) {
+        surrounds[square_num] = calcSurrounds(square_num % BOARD_SIZE, square_num / BOARD_SIZE);
+    }
+    return surrounds;
+}
+
+// Each type of jump has a number from 0 to 15.
+// This is the order of the jumps (A = 10, etc.):
+//
+//   01234
+//   F...5
+//   E.*.6
+//   D...7
+//   CBA98
+//
+// i.e. a square drawn clockwise from the top left. JUMP_COORDS maps each
+// number to its offset, so 0 maps to (-2, -2), 1 maps to (-1, -2), etc.
+constexpr LookupTable<Coord, NUM_JUMPS> makeJumpCoords()
+{
+    LookupTable<Coord, NUM_JUMPS> jump_coords = {};
+    int jump_num = 0;
+    for(int x = -2; x <= 2; ++x) {
+        jump_coords[jump_num++] = Coord(x, -2);
+    }
+    for(int y = -1; y <= 2; ++y) {
+        jump_coords[jump_num++] = Coord(2, y);
+    }
+    for(int x = 1; x >= -2; --x) {
+        jump_coords[jump_num++] = Coord(x, 2);
+    }
+    for(int y = 1; y >= -1; --y) {
+        jump_coords[jump_num++] = Coord(-2, y);
+    }
+    return jump_coords;
+}
+
+constexpr LookupTable<Coord, NUM_JUMPS> JUMP_COORDS = makeJumpCoords();
+
+// Jumps that would leave the board have an empty destination and capture radius
+constexpr LookupTable<LookupTable<BitboardJump, NUM_JUMPS>, NUM_SQUARES> makeJumps()
+{
+    LookupTable<LookupTable<BitboardJump, NUM_JUMPS>, NUM_SQUARES> jumps = {};
+    for(int square_num = 0; square_num < NUM_SQUARES; ++square_num) {
+        for(int jump_num = 0; jump_num < NUM_JUMPS; ++jump_num) {
+            int dst_x = square_num % BOARD_SIZE + JUMP_COORDS[jump_num].x;
+            int dst_y = square_num / BOARD_SIZE + JUMP_COORDS[jump_num].y;
+            jumps[square_num][jump_num].dest_square = coordToBit(dst_x, dst_y);
+            jumps[square_num][jump_num].capture_radius = calcSurrounds(dst_x, dst_y);
+        }
+    }
+    return jumps;
+}
+
+// Every square a piece on each square can jump to
+constexpr LookupTable<Bitboard, NUM_SQUARES> makeJumpTargets()
+{
+    LookupTable<Bitboard, NUM_SQUARES> jump_targets = {};
+    for(int square_num = 0; square_num < NUM_SQUARES; ++square_num) {
+        for(int jump_num = 0; jump_num < NUM_JUMPS; ++jump_num) {
+            int dst_x = square_num % BOARD_SIZE + JUMP_COORDS[jump_num].x;
+            int dst_y = square_num / BOARD_SIZE + JUMP_COORDS[jump_num].y;
+            jump_targets[square_num] |= coordToBit(dst_x, dst_y);
+        }
+    }
+    return jump_targets;
+}
+
+constexpr Bitboard makeColumnMask(int x)
+{
+    Bitboard bitboard = 0;
+    for(int y = 0; y < BOARD_SIZE; ++y) {
+        bitboard |= coordToBoardBit(x, y);
+    }
+    return bitboard;
+}
+
+// Every square on the board if playable is false, or every square that isn't
+// blocked if it's true
+constexpr Bitboard makeBoardMask(bool playable)
+{
+    Bitboard bitboard = 0;
+    for(int y = 0; y < BOARD_SIZE; ++y) {
+        for(int x = 0; x < BOARD_SIZE; ++x) {
+            bitboard |= playable ? coordToBit(x, y) : coordToBoardBit(x, y);
+        }
+    }
+    return bitboard;
+}
+
+constexpr LookupTable<Bitboard, NUM_SQUARES> BITBOARD_SURROUNDS = makeSurrounds();
+constexpr LookupTable<LookupTable<BitboardJump, NUM_JUMPS>, NUM_SQUARES> BITBOARD_JUMPS = makeJumps();
+constexpr LookupTable<Bitboard, NUM_SQUARES> BITBOARD_JUMP_TARGETS = makeJumpTargets();
+constexpr Bitboard BITBOARD_LEFT_COLUMN = makeColumnMask(0);
+constexpr Bitboard BITBOARD_RIGHT_COLUMN = makeColumnMask(BOARD_SIZE - 1);
+constexpr Bitboard BITBOARD_ON_BOARD = makeBoardMask(false);
+constexpr Bitboard BITBOARD_PLAYABLE = makeBoardMask(true);
 
 int countSetBits(Bitboard bitboard);
+void convBoardToBitboards(const Board& board, Bitboard& player1, Bitboard& player2);
+void convBitboardsToBoard(Bitboard player1, Bitboard player2, Board& board);
 
-// NEVER use ~bitboard! Use this instead to ensure that bits outside the board's bounds are not set to 1.
+// Square number of the lowest set bit. bitboard must not be empty.
+inline int lowestSetSquare(Bitboard bitboard)
+{
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward64(&index, bitboard);
+    return int(index);
+#else
+    return __builtin_ctzll(bitboard);
+#endif
+}
+
+// NEVER use ~bitboard! Use this instead to ensure that bits outside the board's
+// bounds (and blocked squares) are not set to 1.
 inline Bitboard invertBitboard(Bitboard bitboard)
 {
-    return ~bitboard & 0x1ffffffffffffLL;
+    return ~bitboard & BITBOARD_PLAYABLE;
+}
+
+// The squares in bitboard plus every square next to one of them. Shifting by 1
+// moves a piece sideways, which mustn't wrap around to the other edge (or off
+// the end of the board, where shifting down would bring it back); shifting by
+// BOARD_SIZE moves it up or down. Blocked squares are included, so that
+// dilating twice reaches every square a piece can jump to, over them or not.
+inline Bitboard dilateBitboard(Bitboard bitboard)
+{
+    Bitboard row = bitboard | ((bitboard << 1) & (BITBOARD_ON_BOARD & ~BITBOARD_LEFT_COLUMN)) | ((bitboard >> 1) & ~BITBOARD_RIGHT_COLUMN);
+    return (row | (row << BOARD_SIZE) | (row >> BOARD_SIZE)) & BITBOARD_ON_BOARD;
+}
+
+// How many of the squares in bitboard are next to each square, for all the
+// squares at once. The counts are bit-sliced: bit i of a square's count is its
+// bit in counts[i]. The eight neighbour bitboards are added up with full and
+// half adders built from bitwise operations, so every square gets its own
+// adder in the same instructions.
+inline void countNeighbours(Bitboard bitboard, Bitboard counts[4])
+{
+    Bitboard west = (bitboard << 1) & (BITBOARD_ON_BOARD & ~BITBOARD_LEFT_COLUMN);
+    Bitboard east = (bitboard >> 1) & ~BITBOARD_RIGHT_COLUMN;
+    Bitboard neighbours[8] = {
+        west, east,
+        (bitboard << BOARD_SIZE) & BITBOARD_ON_BOARD, bitboard >> BOARD_SIZE,
+        (west << BOARD_SIZE) & BITBOARD_ON_BOARD, west >> BOARD_SIZE,
+        (east << BOARD_SIZE) & BITBOARD_ON_BOARD, east >> BOARD_SIZE
+    };
+    auto fullAdd = [](Bitboard a, Bitboard b, Bitboard c, Bitboard& carry) {
+        carry = (a & b) | (c & (a ^ b));
+        return a ^ b ^ c;
+    };
+    // Ones: three full adders and a half adder leave four carries worth two
+    Bitboard c1, c2, c3, c4;
+    Bitboard s1 = fullAdd(neighbours[0], neighbours[1], neighbours[2], c1);
+    Bitboard s2 = fullAdd(neighbours[3], neighbours[4], neighbours[5], c2);
+    Bitboard s3 = neighbours[6] ^ neighbours[7];
+    c3 = neighbours[6] & neighbours[7];
+    counts[0] = fullAdd(s1, s2, s3, c4);
+    // Twos, then fours and eights
+    Bitboard d1;
+    Bitboard t1 = fullAdd(c1, c2, c3, d1);
+    counts[1] = t1 ^ c4;
+    Bitboard d2 = t1 & c4;
+    counts[2] = d1 ^ d2;
+    counts[3] = d1 & d2;
+}
+
+// Every square a player can clone into
+inline Bitboard cloneTargets(Bitboard bb_me, Bitboard bb_empty)
+{
+    return dilateBitboard(bb_me) & bb_empty;
+}
+
+// Every square a player can move into by cloning or jumping
+inline Bitboard moveTargets(Bitboard bb_me, Bitboard bb_empty)
+{
+    return dilateBitboard(dilateBitboard(bb_me)) & bb_empty;
+}
+
+inline bool hasAnyCloneBB(Bitboard bb_me, Bitboard bb_empty)
+{
+    return cloneTargets(bb_me, bb_empty) != 0;
+}
+
+inline bool hasAnyMoveBB(Bitboard bb_me, Bitboard bb_empty)
+{
+    return moveTargets(bb_me, bb_empty) != 0;
+}
+
+// When a player can't move, the game is taken to be over: the other player
+// (bb_him) goes on to fill every empty square they can get to. On an open
+// board that's all of them, since a region of empty squares that only the
+// stuck player's pieces border would give them a move. Blocked squares can
+// wall a region off from both players, so then it's the squares bb_him can
+// reach one move after another.
+inline Bitboard fillableSquares(Bitboard bb_him, Bitboard bb_empty)
+{
+    if(!HAS_BLOCKED_SQUARES) {
+        return bb_empty;
+    }
+    Bitboard filled = 0;
+    Bitboard reached;
+    while((reached = moveTargets(bb_him | filled, bb_empty & ~filled)) != 0) {
+        filled |= reached;
+    }
+    return filled;
+}
+
+// The final margin from bb_me's side when bb_me can't move (see fillableSquares)
+inline int finalMarginBB(Bitboard bb_me, Bitboard bb_him, Bitboard bb_empty)
+{
+    return countSetBits(bb_me) - countSetBits(bb_him | fillableSquares(bb_him, bb_empty));
+}
+
+// The board's 8 symmetries. Symmetry number s mirrors the board left to right
+// if bit 0 is set, then top to bottom if bit 1 is set, then flips it over the
+// a1 corner's diagonal (swapping x and y) if bit 2 is set. Only those that
+// take the blocked squares onto each other are symmetries of the game (see
+// SYMMETRY_VALID).
+const int NUM_SYMMETRIES = 8;
+const int SYMMETRY_IDENTITY = 0;
+const int SYMMETRY_MIRROR_X = 1;
+const int SYMMETRY_MIRROR_Y = 2;
+const int SYMMETRY_TRANSPOSE = 4;
+
+// A square's coordinates, or a jump's offset if is_offset is set, under the symmetry
+constexpr Coord transformCoord(Coord coord, int symmetry, bool is_offset)
+{
+    if(symmetry & SYMMETRY_MIRROR_X) {
+        coord.x = is_offset ? -coord.x : BOARD_SIZE - 1 - coord.x;
+    }
+    if(symmetry & SYMMETRY_MIRROR_Y) {
+        coord.y = is_offset ? -coord.y : BOARD_SIZE - 1 - coord.y;
+    }
+    if(symmetry & SYMMETRY_TRANSPOSE) {
+        int x = coord.x;
+        coord.x = coord.y;
+        coord.y = x;
+    }
+    return coord;
+}
+
+// SYMMETRY_SQUARES[s][square_num] is where the symmetry takes the square
+constexpr LookupTable<LookupTable<unsigned char, NUM_SQUARES>, NUM_SYMMETRIES> makeSymmetrySquares()
+{
+    LookupTable<LookupTable<unsigned char, NUM_SQUARES>, NUM_SYMMETRIES> squares = {};
+    for(int symmetry = 0; symmetry < NUM_SYMMETRIES; ++symmetry) {
+        for(int square_num = 0; square_num < NUM_SQUARES; ++square_num) {
+            Coord coord = transformCoord(Coord(square_num % BOARD_SIZE, square_num / BOARD_SIZE), symmetry, false);
+            squares[symmetry][square_num] = (unsigned char)(coord.y*BOARD_SIZE + coord.x);
+        }
+    }
+    return squares;
+}
+
+// SYMMETRY_JUMPS[s][jump_num] is the jump number (see JUMP_COORDS) of the
+// jump's image under the symmetry
+constexpr LookupTable<LookupTable<unsigned char, NUM_JUMPS>, NUM_SYMMETRIES> makeSymmetryJumps()
+{
+    LookupTable<LookupTable<unsigned char, NUM_JUMPS>, NUM_SYMMETRIES> jumps = {};
+    for(int symmetry = 0; symmetry < NUM_SYMMETRIES; ++symmetry) {
+        for(int jump_num = 0; jump_num < NUM_JUMPS; ++jump_num) {
+            Coord offset = transformCoord(JUMP_COORDS[jump_num], symmetry, true);
+            for(int image = 0; image < NUM_JUMPS; ++image) {
+                if(JUMP_COORDS[image] == offset) {
+                    jumps[symmetry][jump_num] = (unsigned char)image;
+                }
+            }
+        }
+    }
+    return jumps;
+}
+
+// INVERSE_SYMMETRIES[s] undoes symmetry s
+constexpr LookupTable<int, NUM_SYMMETRIES> makeInverseSymmetries()
+{
+    LookupTable<int, NUM_SYMMETRIES> inverses = {};
+    for(int symmetry = 0; symmetry < NUM_SYMMETRIES; ++symmetry) {
+        for(int inverse = 0; inverse < NUM_SYMMETRIES; ++inverse) {
+            // (1, 2) is off every axis of symmetry, so it's enough to check it alone
+            if(transformCoord(transformCoord(Coord(1, 2), symmetry, false), inverse, false) == Coord(1, 2)) {
+                inverses[symmetry] = inverse;
+            }
+        }
+    }
+    return inverses;
+}
+
+// SYMMETRY_VALID[s] is true if symmetry s takes every blocked square to a blocked square
+constexpr LookupTable<bool, NUM_SYMMETRIES> makeValidSymmetries()
+{
+    LookupTable<bool, NUM_SYMMETRIES> valid = {};
+    for(int symmetry = 0; symmetry < NUM_SYMMETRIES; ++symmetry) {
+        valid[symmetry] = true;
+        for(int square_num = 0; square_num < NUM_SQUARES; ++square_num) {
+            Coord coord(square_num % BOARD_SIZE, square_num / BOARD_SIZE);
+            if(!Board::isPlayable(coord) && Board::isPlayable(transformCoord(coord, symmetry, false))) {
+                valid[symmetry] = false;
+            }
+        }
+    }
+    return valid;
+}
+
+constexpr Bitboard makeRowMask(int y)
+{
+    Bitboard bitboard = 0;
+    for(int x = 0; x < BOARD_SIZE; ++x) {
+        bitboard |= coordToBoardBit(x, y);
+    }
+    return bitboard;
+}
+
+// The squares (d + i, i), below the a1 corner's diagonal at distance d; each
+// is (BOARD_SIZE - 1)*d bits below its image when x and y are swapped
+constexpr Bitboard makeTransposeMask(int d)
+{
+    Bitboard bitboard = 0;
+    for(int i = 0; i + d < BOARD_SIZE; ++i) {
+        bitboard |= coordToBoardBit(d + i, i);
+    }
+    return bitboard;
+}
+
+// Masks for the swaps that mirror and transpose bitboards: each column left of
+// the middle, each row below it, and each diagonal below the a1 corner's
+constexpr LookupTable<Bitboard, BOARD_SIZE> makeLineMasks(int kind)
+{
+    LookupTable<Bitboard, BOARD_SIZE> masks = {};
+    for(int i = 0; i < BOARD_SIZE; ++i) {
+        masks[i] = (kind == 0) ? makeColumnMask(i) : (kind == 1) ? makeRowMask(i) : makeTransposeMask(i);
+    }
+    return masks;
+}
+
+constexpr LookupTable<LookupTable<unsigned char, NUM_SQUARES>, NUM_SYMMETRIES> SYMMETRY_SQUARES = makeSymmetrySquares();
+constexpr LookupTable<LookupTable<unsigned char, NUM_JUMPS>, NUM_SYMMETRIES> SYMMETRY_JUMPS = makeSymmetryJumps();
+constexpr LookupTable<int, NUM_SYMMETRIES> INVERSE_SYMMETRIES = makeInverseSymmetries();
+constexpr LookupTable<bool, NUM_SYMMETRIES> SYMMETRY_VALID = makeValidSymmetries();
+constexpr LookupTable<Bitboard, BOARD_SIZE> BITBOARD_COLUMNS = makeLineMasks(0);
+constexpr LookupTable<Bitboard, BOARD_SIZE> BITBOARD_ROWS = makeLineMasks(1);
+constexpr LookupTable<Bitboard, BOARD_SIZE> BITBOARD_DIAGONALS = makeLineMasks(2);
+
+// Swaps the bits in mask with the ones delta bits above them
+inline Bitboard swapBits(Bitboard bitboard, Bitboard mask, int delta)
+{
+    Bitboard diff = ((bitboard >> delta) ^ bitboard) & mask;
+    return bitboard ^ diff ^ (diff << delta);
+}
+
+// Column x swaps with column BOARD_SIZE - 1 - x, BOARD_SIZE - 1 - 2*x bits
+// above it. The loops have a fixed count, so the compiler unrolls them into a
+// straight line of swaps.
+inline Bitboard mirrorBitboardX(Bitboard bitboard)
+{
+    for(int x = 0; x < BOARD_SIZE / 2; ++x) {
+        bitboard = swapBits(bitboard, BITBOARD_COLUMNS[x], BOARD_SIZE - 1 - 2*x);
+    }
+    return bitboard;
+}
+
+inline Bitboard mirrorBitboardY(Bitboard bitboard)
+{
+    for(int y = 0; y < BOARD_SIZE / 2; ++y) {
+        bitboard = swapBits(bitboard, BITBOARD_ROWS[y], (BOARD_SIZE - 1 - 2*y)*BOARD_SIZE);
+    }
+    return bitboard;
+}
+
+inline Bitboard transposeBitboard(Bitboard bitboard)
+{
+    for(int d = 1; d < BOARD_SIZE; ++d) {
+        bitboard = swapBits(bitboard, BITBOARD_DIAGONALS[d], (BOARD_SIZE - 1)*d);
+    }
+    return bitboard;
+}
+
+inline Bitboard transformBitboard(Bitboard bitboard, int symmetry)
+{
+    if(symmetry & SYMMETRY_MIRROR_X) {
+        bitboard = mirrorBitboardX(bitboard);
+    }
+    if(symmetry & SYMMETRY_MIRROR_Y) {
+        bitboard = mirrorBitboardY(bitboard);
+    }
+    if(symmetry & SYMMETRY_TRANSPOSE) {
+        bitboard = transposeBitboard(bitboard);
+    }
+    return bitboard;
+}
+
+// The image of a move under the symmetry. Null moves and non-moves stay as they are.
+inline BitboardMove transformMoveBB(BitboardMove bbmove, int symmetry)
+{
+    if(bbmove.move_type == BBMOVE_CLONE || bbmove.move_type == BBMOVE_JUMP) {
+        bbmove.square = SYMMETRY_SQUARES[symmetry][bbmove.square];
+        if(bbmove.move_type == BBMOVE_JUMP) {
+            bbmove.jump_type = SYMMETRY_JUMPS[symmetry][bbmove.jump_type];
+        }
+    }
+    return bbmove;
+}
+
+// Of the position's images under the valid symmetries (usually all 8), picks
+// the one whose bitboards compare lowest. Returns its symmetry number and puts
+// its bitboards in canonical1 and canonical2. Every image of a position gets
+// the same canonical form.
+inline int canonicalizeBitboards(Bitboard player1, Bitboard player2, Bitboard& canonical1, Bitboard& canonical2)
+{
+    Bitboard images1[NUM_SYMMETRIES];
+    Bitboard images2[NUM_SYMMETRIES];
+    images1[0] = player1;
+    images2[0] = player2;
+    images1[SYMMETRY_MIRROR_X] = mirrorBitboardX(player1);
+    images2[SYMMETRY_MIRROR_X] = mirrorBitboardX(player2);
+    images1[SYMMETRY_MIRROR_Y] = mirrorBitboardY(player1);
+    images2[SYMMETRY_MIRROR_Y] = mirrorBitboardY(player2);
+    images1[SYMMETRY_MIRROR_X | SYMMETRY_MIRROR_Y] = mirrorBitboardY(images1[SYMMETRY_MIRROR_X]);
+    images2[SYMMETRY_MIRROR_X | SYMMETRY_MIRROR_Y] = mirrorBitboardY(images2[SYMMETRY_MIRROR_X]);
+    int best = 0;
+    for(int symmetry = 0; symmetry < NUM_SYMMETRIES; ++symmetry) {
+        if(symmetry & SYMMETRY_TRANSPOSE) {
+            images1[symmetry] = transposeBitboard(images1[symmetry & ~SYMMETRY_TRANSPOSE]);
+            images2[symmetry] = transposeBitboard(images2[symmetry & ~SYMMETRY_TRANSPOSE]);
+        }
+        if(HAS_BLOCKED_SQUARES && !SYMMETRY_VALID[symmetry]) {
+            continue;
+        }
+        if(images1[symmetry] < images1[best] || (images1[symmetry] == images1[best] && images2[symmetry] < images2[best])) {
+            best = symmetry;
+        }
+    }
+    canonical1 = images1[best];
+    canonical2 = images2[best];
+    return best;
 }
 
 #endif
@@ -0,0 +1,225 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include "Board.hpp"
+#include "moves.hpp"
+#include "ai.hpp"
+#include "bitboards.hpp"
+#include "zobrist.hpp"
+#include "largepages.hpp"
+#include "book.hpp"
+
+using namespace std;
+
+namespace
+{
+
+// The open book, mapped straight from the file
+const void* g_book_view = nullptr;
+size_t g_book_bytes = 0;
+const BookEntry* g_book_entries = nullptr;
+uint32_t g_book_num_entries = 0;
+
+// The book's key for a board with player 2 to move
+ZobristHash calcBookHash(const Board& board)
+{
+    Bitboard bb_player1, bb_player2;
+    convBoardToBitboards(board, bb_player1, bb_player2);
+    return calcHashBB(bb_player1, bb_player2, 1);
+}
+
+// Every position up to plies moves from the start positions, with player 2
+// to move, without duplicates. Positions where the player to move is stuck
+// are left out, since there's nothing to choose.
+void collectBookPositions(int plies, vector<Board>& positions)
+{
+    // initBoard's start position; the other start is its mirror image
+    Board start;
+    initBoard(start);
+    Board mirrored_start(start);
+    swapPlayers(mirrored_start);
+
+    // Each level is stored as if player 2 were to move, so the players swap
+    // roles at every ply
+    vector<Board> level;
+    for(Board board : {start, mirrored_start}) {
+        swapPlayers(board);
+        level.push_back(board);
+    }
+    unordered_set<ZobristHash> seen;
+    for(int ply = 0; ply <= plies && !level.empty(); ++ply) {
+        vector<Board> next_level;
+        for(const Board& board : level) {
+            if(!seen.insert(calcBookHash(board)).second) {
+                continue;
+            }
+            MoveList moves;
+            findAllPossibleMoves(board, PLAYER2, moves);
+            if(moves.empty()) {
+                continue;
+            }
+            positions.push_back(board);
+            if(ply < plies) {
+                for(const Move& move : moves) {
+                    Board child(board);
+                    makeMove(child, move);
+                    swapPlayers(child);
+                    next_level.push_back(child);
+                }
+            }
+        }
+        level.swap(next_level);
+    }
+}
+
+}
+
+bool buildBook(const char* filename, int plies, int num_workers)
+{
+    using namespace std::chrono;
+    vector<Board> positions;
+    collectBookPositions(plies, positions);
+    if(num_workers <= 0) {
+        num_workers = max(1, int(thread::hardware_concurrency()));
+    }
+    cout << "Searching " << positions.size() << " positions up to " << plies << " plies from the start, "
+         << num_workers << " at a time" << endl;
+
+    steady_clock::time_point t1 = steady_clock::now();
+    vector<BookEntry> entries(positions.size());
+    const SearchConfig* config = &getSearchConfig();
+    SearchLimits limits = getSearchLimits();
+    atomic<size_t> next_position(0);
+    atomic<size_t> num_done(0);
+    auto worker = [&]() {
+        // Search settings are per thread
+        setSearchConfig(*config);
+        setSearchLimits(limits);
+        vector<int> square_order(NUM_SQUARES);
+        vector<int> jump_order(NUM_JUMPS);
+        for(int i = 0; i < NUM_SQUARES; ++i) {
+            square_order[i] = i;
+        }
+        for(int i = 0; i < NUM_JUMPS; ++i) {
+            jump_order[i] = i;
+        }
+        for(size_t i = next_position++; i < positions.size(); i = next_position++) {
+            newZobristGeneration();
+            Move move;
+            long long nodes_searched = 0;
+            int score = mtdf_bb(positions[i], square_order, jump_order, move, nodes_searched);
+            BookEntry& entry = entries[i];
+            memset(&entry, 0, sizeof(entry));
+            entry.hash = calcBookHash(positions[i]);
+            entry.score = int16_t(score);
+            entry.src_x = uint8_t(move.src.x);
+            entry.src_y = uint8_t(move.src.y);
+            entry.dst_x = uint8_t(move.dst.x);
+            entry.dst_y = uint8_t(move.dst.y);
+            entry.depth = uint8_t(getLastSearchDepth());
+            size_t done = ++num_done;
+            if(done % 100 == 0) {
+                cout << "  " << done << " / " << positions.size() << endl;
+            }
+        }
+    };
+    vector<thread> threads;
+    for(int i = 1; i < num_workers; ++i) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for(thread& t : threads) {
+        t.join();
+    }
+    double secs = duration_cast<duration<double>>(steady_clock::now() - t1).count();
+
+    sort(entries.begin(), entries.end(), [](const BookEntry& a, const BookEntry& b) {
+        return a.hash < b.hash;
+    });
+    BookHeader header;
+    memcpy(header.magic, BOOK_MAGIC, sizeof(header.magic));
+    header.version = BOOK_VERSION;
+    header.num_entries = uint32_t(entries.size());
+    FILE* file = fopen(filename, "wb");
+    if(!file) {
+        cout << "Couldn't write " << filename << endl;
+        return false;
+    }
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1
+        && fwrite(entries.data(), sizeof(BookEntry), entries.size(), file) == entries.size();
+    ok = (fclose(file) == 0) && ok;
+    if(!ok) {
+        cout << "Couldn't write " << filename << endl;
+        return false;
+    }
+    cout << "Wrote " << entries.size() << " positions to " << filename << " in " << secs << " seconds" << endl;
+    return true;
+}
+
+bool openBook(const char* filename)
+{
+    closeBook();
+    size_t bytes = 0;
+    const void* view = mapFile(filename, bytes);
+    if(!view) {
+        return false;
+    }
+    const BookHeader* header = static_cast<const BookHeader*>(view);
+    if(bytes < sizeof(BookHeader) || memcmp(header->magic, BOOK_MAGIC, sizeof(BOOK_MAGIC)) != 0
+        || header->version != BOOK_VERSION
+        || bytes != sizeof(BookHeader) + size_t(header->num_entries) * sizeof(BookEntry))
+    {
+        unmapFile(view, bytes);
+        return false;
+    }
+    g_book_view = view;
+    g_book_bytes = bytes;
+    g_book_entries = reinterpret_cast<const BookEntry*>(header + 1);
+    g_book_num_entries = header->num_entries;
+    return true;
+}
+
+void closeBook()
+{
+    unmapFile(g_book_view, g_book_bytes);
+    g_book_view = nullptr;
+    g_book_bytes = 0;
+    g_book_entries = nullptr;
+    g_book_num_entries = 0;
+}
+
+uint32_t getBookEntries()
+{
+    return g_book_num_entries;
+}
+
+bool probeBook(const Board& board, Move& move, int& score, int& depth)
+{
+    if(g_book_num_entries == 0) {
+        return false;
+    }
+    ZobristHash hash = calcBookHash(board);
+    const BookEntry* end = g_book_entries + g_book_num_entries;
+    const BookEntry* entry = lower_bound(g_book_entries, end, hash, [](const BookEntry& e, ZobristHash h) {
+        return e.hash < h;
+    });
+    if(entry == end || entry->hash != hash) {
+        return false;
+    }
+    move.src = Coord(entry->src_x, entry->src_y);
+    move.dst = Coord(entry->dst_x, entry->dst_y);
+    // Guards against a hash collision, or a book from some other program
+    if(!checkLegalMove(board, PLAYER2, move)) {
+        return false;
+    }
+    score = entry->score;
+    depth = entry->depth;
+    return true;
+}
@@ -0,0 +1,50 @@
+#ifndef SPLOT_BOOK_HPP
+#define SPLOT_BOOK_HPP
+
+#include <cstdint>
+#include "Board.hpp"
+#include "moves.hpp"
+
+// Opening book file: a BookHeader, then num_entries BookEntries sorted by
+// hash, in the machine's byte order. The file is memory-mapped as is, so
+// loading it costs nothing, and a probe is a binary search touching a few pages.
+// Like the searches, the book always has player 2 to move; a position with
+// player 1 to move is looked up with the pieces swapped (see swapPlayers).
+const char BOOK_MAGIC[8] = {'S', 'P', 'L', 'T', 'B', 'O', 'O', 'K'};
+const std::uint32_t BOOK_VERSION = 1;
+
+struct BookHeader
+{
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t num_entries;
+};
+
+struct BookEntry
+{
+    std::uint64_t hash;             // calcHashBB(player1, player2, 1)
+    std::int16_t score;             // As returned by the search
+    std::uint8_t src_x, src_y;      // The move
+    std::uint8_t dst_x, dst_y;
+    std::uint8_t depth;             // Of the search that chose the move
+    std::uint8_t reserved;
+};
+
+static_assert(sizeof(BookHeader) == 16 && sizeof(BookEntry) == 16, "book layout is part of the file format");
+
+// Searches every position up to plies moves from the start (both initBoard's
+// and its mirror image, the standard start) to the current search limits with
+// mtdf_bb, num_workers positions at a time (0 means one per core), and writes
+// the moves to filename. Returns false if the file can't be written.
+bool buildBook(const char* filename, int plies, int num_workers);
+
+// Maps the book in, replacing any book already open. Returns false (leaving no
+// book) if the file is missing or isn't a valid book.
+bool openBook(const char* filename);
+void closeBook();
+std::uint32_t getBookEntries();
+
+// Player 2 is to move. Returns false if the position isn't in the book.
+bool probeBook(const Board& board, Move& move, int& score, int& depth);
+
+#endif
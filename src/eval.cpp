@@ -0,0 +1,118 @@
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include "bitboards.hpp"
+#include "eval.hpp"
+
+using namespace std;
+
+const char* const EVAL_FEATURE_NAMES[NUM_EVAL_FEATURES] = {
+    "pieces",
+    "mobility",
+    "frontier",
+    "capture_squares"
+};
+
+namespace
+{
+
+// Highest each feature can count for one player
+const int MAX_FEATURE_COUNTS[NUM_EVAL_FEATURES] = {
+    NUM_SQUARES,
+    NUM_SQUARES,
+    NUM_SQUARES,
+    8 * NUM_SQUARES
+};
+
+// Sum of the counts in candidates (see countNeighbours)
+int sumNeighbourCounts(const Bitboard counts[4], Bitboard candidates)
+{
+    return countSetBits(counts[0] & candidates)
+        + 2 * countSetBits(counts[1] & candidates)
+        + 4 * countSetBits(counts[2] & candidates)
+        + 8 * countSetBits(counts[3] & candidates);
+}
+
+// me's side of the score: each feature counted for me, times its weight.
+// my_reach is every square next to one of my pieces, near_empty every square
+// next to an empty one, and his_targets where the opponent can move.
+int evalSide(Bitboard bb_me, Bitboard bb_empty, Bitboard my_reach, Bitboard near_empty, Bitboard his_targets,
+             const EvalWeights& weights)
+{
+    int score = weights.weights[EVAL_PIECES] * countSetBits(bb_me);
+    if(weights.weights[EVAL_MOBILITY] != 0) {
+        score += weights.weights[EVAL_MOBILITY] * countSetBits(my_reach & bb_empty);
+    }
+    if(weights.weights[EVAL_FRONTIER] != 0) {
+        score += weights.weights[EVAL_FRONTIER] * countSetBits(bb_me & near_empty);
+    }
+    if(weights.weights[EVAL_CAPTURE_SQUARES] != 0) {
+        Bitboard counts[4];
+        countNeighbours(bb_me, counts);
+        score += weights.weights[EVAL_CAPTURE_SQUARES] * sumNeighbourCounts(counts, his_targets);
+    }
+    return score;
+}
+
+}
+
+bool loadEvalWeights(const char* filename, EvalWeights& weights)
+{
+    ifstream infile(filename);
+    if(infile.fail()) {
+        return false;
+    }
+    EvalWeights loaded = {};
+    string line;
+    while(getline(infile, line)) {
+        line = line.substr(0, line.find('#'));
+        istringstream fields(line);
+        string name;
+        if(!(fields >> name)) {
+            continue;
+        }
+        int feature = 0;
+        while(feature < NUM_EVAL_FEATURES && name != EVAL_FEATURE_NAMES[feature]) {
+            ++feature;
+        }
+        int weight;
+        string extra;
+        if(feature == NUM_EVAL_FEATURES || !(fields >> weight) || (fields >> extra)) {
+            return false;
+        }
+        loaded.weights[feature] = weight;
+    }
+
+    // Margins given in pieces (see SearchState::piece_value) need a piece to be worth something
+    if(loaded.weights[EVAL_PIECES] <= 0) {
+        return false;
+    }
+    long long max_score = 0;
+    for(int feature = 0; feature < NUM_EVAL_FEATURES; ++feature) {
+        max_score += (long long)abs(loaded.weights[feature]) * MAX_FEATURE_COUNTS[feature];
+    }
+    if(max_score > MAX_EVAL_SCORE) {
+        return false;
+    }
+    weights = loaded;
+    return true;
+}
+
+int evalFeaturesBB(Bitboard player1, Bitboard player2, const EvalWeights& weights)
+{
+    Bitboard bb_empty = invertBitboard(player1 | player2);
+    Bitboard p1_reach = dilateBitboard(player1);
+    Bitboard p2_reach = dilateBitboard(player2);
+    Bitboard near_empty = weights.weights[EVAL_FRONTIER] != 0 ? dilateBitboard(bb_empty) : 0;
+    // Where each player can move: next to one of their pieces, or one further
+    Bitboard p1_targets = 0;
+    Bitboard p2_targets = 0;
+    if(weights.weights[EVAL_CAPTURE_SQUARES] != 0) {
+        p1_targets = dilateBitboard(p1_reach) & bb_empty;
+        p2_targets = dilateBitboard(p2_reach) & bb_empty;
+    }
+    return evalSide(player2, bb_empty, p2_reach, near_empty, p1_targets, weights)
+        - evalSide(player1, bb_empty, p1_reach, near_empty, p2_targets, weights);
+}
@@ -0,0 +1,62 @@
+#ifndef SPLOT_EVAL_HPP
+#define SPLOT_EVAL_HPP
+
+#include "bitboards.hpp"
+
+// Things about a position the evaluation can weigh. Each is counted for both
+// players, and scores its weight times player 2's count minus player 1's.
+enum EvalFeature
+{
+    EVAL_PIECES,                // The player's pieces
+    EVAL_MOBILITY,              // Empty squares the player can clone into
+    EVAL_FRONTIER,              // The player's pieces next to an empty square
+    EVAL_CAPTURE_SQUARES,       // Over the empty squares the opponent can move to, the player's pieces next to each
+    NUM_EVAL_FEATURES
+};
+
+// As they appear in weights files
+extern const char* const EVAL_FEATURE_NAMES[NUM_EVAL_FEATURES];
+
+struct EvalWeights
+{
+    int weights[NUM_EVAL_FEATURES];
+
+    bool countsOnlyPieces() const
+    {
+        for(int feature = EVAL_PIECES + 1; feature < NUM_EVAL_FEATURES; ++feature) {
+            if(weights[feature] != 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+// Pieces and nothing else; the score is simply how many pieces ahead player 2 is
+const EvalWeights MATERIAL_EVAL_WEIGHTS = {{1, 0, 0, 0}};
+
+// A piece is worth 8 here. Being able to move counts for a little, and so do
+// pieces the opponent can't get at. Used by bench eval when no weights file
+// is given.
+const EvalWeights FEATURE_EVAL_WEIGHTS = {{8, 1, -1, -1}};
+
+// No position may score more than this (or less than minus this) before WIN
+// and LOSS, which mean the game is over. Weights that could go further are
+// rejected.
+const int MAX_EVAL_SCORE = 5000;
+
+// Reads weights from a text file with a feature name and its weight on each
+// line, e.g. "mobility 2". Features that aren't mentioned weigh nothing; blank
+// lines and anything after a # are ignored. Returns false, leaving weights
+// alone, if the file can't be read, doesn't make sense, or gives a piece no
+// value.
+bool loadEvalWeights(const char* filename, EvalWeights& weights);
+
+// Player 2's score, with weights, for a position where the game isn't over.
+// All the features are counted with set-wise bitboard operations, for the
+// whole board at once. That's cheaper than keeping the counts up to date move
+// by move, which takes the same whole-board bitboards for the new position and
+// then twice the popcounts.
+int evalFeaturesBB(Bitboard player1, Bitboard player2, const EvalWeights& weights);
+
+#endif
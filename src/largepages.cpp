@@ -0,0 +1,180 @@
+#include <cstdint>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "largepages.hpp"
+
+namespace
+{
+
+const std::size_t HUGE_PAGE_SIZE = 2 * 0x100000;
+
+std::size_t roundUpToHugePage(std::size_t bytes)
+{
+    return (bytes + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+}
+
+}
+
+#ifdef _WIN32
+
+// Large pages need the "Lock pages in memory" privilege. If the account doesn't
+// have it, the allocation just fails and we fall back to normal pages.
+void* allocateLargeBlock(std::size_t bytes, bool try_huge_pages, PageSize& page_size)
+{
+    if(try_huge_pages && GetLargePageMinimum() > 0) {
+        HANDLE token;
+        if(OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &token)) {
+            TOKEN_PRIVILEGES privileges;
+            privileges.PrivilegeCount = 1;
+            privileges.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+            if(LookupPrivilegeValue(NULL, SE_LOCK_MEMORY_NAME, &privileges.Privileges[0].Luid)) {
+                AdjustTokenPrivileges(token, FALSE, &privileges, 0, NULL, NULL);
+            }
+            CloseHandle(token);
+        }
+        std::size_t large_page_size = GetLargePageMinimum();
+        std::size_t rounded = (bytes + large_page_size - 1) & ~(large_page_size - 1);
+        void* block = VirtualAlloc(NULL, rounded, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+        if(block) {
+            page_size = PAGES_HUGE;
+            return block;
+        }
+    }
+    // Committed memory isn't actually backed until it's touched
+    page_size = PAGES_NORMAL;
+    return VirtualAlloc(NULL, bytes, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+}
+
+void freeLargeBlock(void* block, std::size_t bytes, PageSize page_size)
+{
+    if(block) {
+        VirtualFree(block, 0, MEM_RELEASE);
+    }
+}
+
+const void* mapFile(const char* filename, std::size_t& bytes)
+{
+    HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if(file == INVALID_HANDLE_VALUE) {
+        return nullptr;
+    }
+    LARGE_INTEGER file_size;
+    const void* view = nullptr;
+    if(GetFileSizeEx(file, &file_size) && file_size.QuadPart > 0) {
+        // The view keeps the mapping alive, so both handles can go
+        HANDLE mapping = CreateFileMapping(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if(mapping) {
+            view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+            CloseHandle(mapping);
+        }
+        bytes = std::size_t(file_size.QuadPart);
+    }
+    CloseHandle(file);
+    return view;
+}
+
+void unmapFile(const void* view, std::size_t bytes)
+{
+    if(view) {
+        UnmapViewOfFile(view);
+    }
+}
+
+#else
+
+void* allocateLargeBlock(std::size_t bytes, bool try_huge_pages, PageSize& page_size)
+{
+#ifdef MAP_HUGETLB
+    if(try_huge_pages) {
+        // Only works if the administrator has reserved huge pages (vm.nr_hugepages)
+        void* block = mmap(NULL, roundUpToHugePage(bytes), PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if(block != MAP_FAILED) {
+            page_size = PAGES_HUGE;
+            return block;
+        }
+    }
+#endif
+
+#ifdef MADV_HUGEPAGE
+    if(try_huge_pages) {
+        // Transparent huge pages can only back 2 MB-aligned ranges, which mmap
+        // doesn't promise, so map a little extra and trim it to an aligned block.
+        std::size_t rounded = roundUpToHugePage(bytes);
+        void* mapping = mmap(NULL, rounded + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if(mapping != MAP_FAILED) {
+            std::uintptr_t start = reinterpret_cast<std::uintptr_t>(mapping);
+            std::uintptr_t aligned = (start + HUGE_PAGE_SIZE - 1) & ~std::uintptr_t(HUGE_PAGE_SIZE - 1);
+            std::uintptr_t end = start + rounded + HUGE_PAGE_SIZE;
+            if(aligned > start) {
+                munmap(mapping, aligned - start);
+            }
+            if(end > aligned + rounded) {
+                munmap(reinterpret_cast<void*>(aligned + rounded), end - (aligned + rounded));
+            }
+            void* block = reinterpret_cast<void*>(aligned);
+            if(madvise(block, rounded, MADV_HUGEPAGE) == 0) {
+                page_size = PAGES_TRANSPARENT_HUGE;
+                return block;
+            }
+            munmap(block, rounded);
+        }
+    }
+#endif
+
+    page_size = PAGES_NORMAL;
+    void* block = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    return block != MAP_FAILED ? block : nullptr;
+}
+
+void freeLargeBlock(void* block, std::size_t bytes, PageSize page_size)
+{
+    if(block) {
+        munmap(block, page_size == PAGES_NORMAL ? bytes : roundUpToHugePage(bytes));
+    }
+}
+
+const void* mapFile(const char* filename, std::size_t& bytes)
+{
+    int fd = open(filename, O_RDONLY);
+    if(fd < 0) {
+        return nullptr;
+    }
+    struct stat file_info;
+    void* view = MAP_FAILED;
+    if(fstat(fd, &file_info) == 0 && file_info.st_size > 0) {
+        // The mapping outlives the descriptor
+        bytes = std::size_t(file_info.st_size);
+        view = mmap(NULL, bytes, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    return view != MAP_FAILED ? view : nullptr;
+}
+
+void unmapFile(const void* view, std::size_t bytes)
+{
+    if(view) {
+        munmap(const_cast<void*>(view), bytes);
+    }
+}
+
+#endif
+
+const char* getPageSizeName(PageSize page_size)
+{
+    switch(page_size) {
+      case PAGES_NORMAL:                return "4 KB pages";
+      case PAGES_TRANSPARENT_HUGE:      return "transparent 2 MB pages";
+      case PAGES_HUGE:                  return "2 MB pages";
+      default:                          return "?";
+    }
+}
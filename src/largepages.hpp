@@ -0,0 +1,32 @@
+#ifndef SPLOT_LARGEPAGES_HPP
+#define SPLOT_LARGEPAGES_HPP
+
+#include <cstddef>
+
+// What kind of pages a large block ended up backed by
+enum PageSize
+{
+    PAGES_NORMAL,               // 4 KB
+    PAGES_TRANSPARENT_HUGE,     // 2 MB where the OS could manage it (Linux THP)
+    PAGES_HUGE                  // Explicit 2 MB pages (hugetlbfs, Windows large pages)
+};
+
+// Allocates a zero-filled block for a big table. Normally the memory is only
+// committed as it's touched, so allocating a gigabyte is instant and costs
+// nothing until the table fills up. (Explicit huge pages on Windows are the
+// exception; the OS commits them up front.)
+// If try_huge_pages is set, we ask for explicit huge pages first, then for
+// transparent huge pages, and settle for normal pages if neither is available.
+// Returns null if even that fails.
+void* allocateLargeBlock(std::size_t bytes, bool try_huge_pages, PageSize& page_size);
+void freeLargeBlock(void* block, std::size_t bytes, PageSize page_size);
+
+const char* getPageSizeName(PageSize page_size);
+
+// Maps a whole file into memory, read-only. Nothing is read until it's
+// touched, and the OS can share the pages between processes. Returns null if
+// the file can't be opened or is empty.
+const void* mapFile(const char* filename, std::size_t& bytes);
+void unmapFile(const void* view, std::size_t bytes);
+
+#endif
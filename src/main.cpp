@@ -2,6 +2,7 @@
 #include <cassert>
 #include <cctype>
 #include <chrono>
+#include <cstdlib>
 #include <fstream>
 #include <iostream>
 #include <random>
@@ -10,39 +11,89 @@
 #include <sstream>
 #include <vector>
 
-// Need Win32 to print pretty colors
+// Need Win32 to print pretty colors; elsewhere we use ANSI escape codes
+#ifdef _WIN32
 #define WIN32_LEAN_AND_MEAN
 #include <windows.h>
+#endif
 
 #include "Board.hpp"
 #include "moves.hpp"
 #include "ai.hpp"
 #include "zobrist.hpp"
+#include "solver.hpp"
+#include "bench.hpp"
+#include "perft.hpp"
+#include "uai.hpp"
+#include "selfplay.hpp"
+#include "analyze.hpp"
+#include "book.hpp"
+#include "stats.hpp"
+#include "asyncsearch.hpp"
+#include "multiplayer.hpp"
 
 using namespace std;
 
-mt19937 g_rng;
+thread_local mt19937 g_rng;     // per thread, since games can run side by side (see selfplay.hpp)
+bool g_print_search_stats = false;  // After every CPU move (see printSearchStats)
+ofstream g_search_stats_json;       // If open, gets a line for every CPU move (see writeSearchStatsJson)
+bool g_ponder = false;              // Search on the human's time (see startPondering)
 
-void initBoard(Board& board);
 void drawBoard(const Board& board);
 bool askForWhichAI(int &which_ai);
 bool askForHumansMove(Board& board, Move& move);
-void decideCpusMove(const Board& board, Move& move, int which_ai);
+void decideCpusMove(const Board& board, Move& move, int which_ai, const SearchConfig& config, AsyncSearch& ponder);
 void saveGame(const Board& board, const std::string& filename);
 void loadGame(Board& board, const std::string& filename);
+void playMultiplayerGame(int num_players, MultiStrategy strategy);
 
 enum WhichAI {
     AI_RANDOM_MOVE,
     AI_NEGAMAX,
     AI_NEGAMAX_ITERATIVE,
     AI_MTDF,
+    AI_PVS,
     NUM_AIS
 };
 
-int main()
+// As in match specs
+const char* const AI_NAMES[NUM_AIS] = {"random", "negamax", "iterative", "mtdf", "pvs"};
+
+// In games of three or four players, in turn order
+const char* const PLAYER_NAMES[MAX_PLAYERS] = {"Blue", "Red", "Green", "Purple"};
+
+// Max^n prunes so little that MAX_PLY would take minutes a move
+const int MULTIPLAYER_DEFAULT_DEPTH = 5;
+
+const char* const USAGE = " [-threads N] [-hash MB | -hash-entries N] [-hugepages on|off]"
+                          " [-depth N] [-nodes N] [-movetime MS | -clock MS [-inc MS]] [-config NAME] [-solve EMPTIES] [-eval FILE]"
+                          " [-players N] [-strategy paranoid|maxn] [-stats] [-stats-json FILE] [-ponder] [-load-tt FILE] [-save-tt FILE [-save-tt-depth N]]"
+                          " [-jobs N] [-games N] [-sprt ELO0 ELO1] [-binary] [-private-tt] [-book FILE]"
+                          " [bench smp|tt|pages|hash|configs|solver|eval|ponder|geometry|multi | perft DEPTH | uai"
+                          " | match AI[:CONFIG][@DEPTH][=EVAL] AI[:CONFIG][@DEPTH][=EVAL] | analyze FILE|- | book FILE PLIES]";
+
+// Saves the transposition table when main returns, however it does
+struct TableSnapshot
 {
-    cout << "Built on " << __DATE__ << endl << endl;
+    string filename;
+    int min_depth = DEFAULT_ZOBRIST_SAVE_DEPTH;
 
+    ~TableSnapshot()
+    {
+        if(filename.empty()) {
+            return;
+        }
+        size_t num_saved;
+        if(saveZobristTable(filename.c_str(), min_depth, num_saved)) {
+            cerr << "Saved " << num_saved << " table entries to " << filename << endl;
+        } else {
+            cerr << "Couldn't save the transposition table to " << filename << endl;
+        }
+    }
+};
+
+int main(int argc, char* argv[])
+{
     // Seed RNG
     std::random_device rd;
     g_rng.seed(rd());
@@ -51,16 +102,252 @@ int main()
     locale loc("");
     cout.imbue(loc);
 
+    size_t zobrist_entries = getZobristEntriesForMegabytes(DEFAULT_ZOBRIST_TABLE_MB);
+    bool try_huge_pages = true;
+    SearchLimits limits;
+    bool depth_given = false;
+    const SearchConfig* config = &getSearchConfig();
+    string bench;
+    int perft_depth = 0;
+    bool uai = false;
+    string match_specs[2];
+    MatchSettings match_settings;
+    string analyze_filename;
+    string book_filename;
+    string build_book_filename;
+    int build_book_plies = 0;
+    AnalysisSettings analysis_settings;
+    string load_table_filename;
+    TableSnapshot table_snapshot;
+    string save_table_filename;
+    int num_players = 2;
+    MultiStrategy multi_strategy = MULTI_PARANOID;
+    for(int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if(arg == "-threads" && i + 1 < argc) {
+            setNumSearchThreads(max(1, atoi(argv[++i])));
+        } else if(arg == "-hash" && i + 1 < argc) {
+            zobrist_entries = getZobristEntriesForMegabytes(max(1, atoi(argv[++i])));
+        } else if(arg == "-hash-entries" && i + 1 < argc) {
+            zobrist_entries = strtoull(argv[++i], nullptr, 0);
+            if(zobrist_entries < ZOBRIST_BUCKET_SIZE || (zobrist_entries & (zobrist_entries - 1)) != 0) {
+                cout << "Number of hash entries must be a power of two, at least " << ZOBRIST_BUCKET_SIZE << endl;
+                return 1;
+            }
+        } else if(arg == "-hugepages" && i + 1 < argc) {
+            try_huge_pages = string(argv[++i]) != "off";
+        } else if(arg == "-depth" && i + 1 < argc) {
+            limits.depth = min(max(1, atoi(argv[++i])), MAX_SEARCH_DEPTH);
+            depth_given = true;
+        } else if(arg == "-nodes" && i + 1 < argc) {
+            limits.nodes = max(0LL, atoll(argv[++i]));
+        } else if(arg == "-movetime" && i + 1 < argc) {
+            limits.move_time_ms = max(0, atoi(argv[++i]));
+        } else if(arg == "-clock" && i + 1 < argc) {
+            limits.clock_ms = max(0, atoi(argv[++i]));
+        } else if(arg == "-inc" && i + 1 < argc) {
+            limits.increment_ms = max(0, atoi(argv[++i]));
+        } else if(arg == "-solve" && i + 1 < argc) {
+            limits.solve_empties = min(max(0, atoi(argv[++i])), MAX_SOLVER_EMPTIES);
+        } else if(arg == "-eval" && i + 1 < argc) {
+            if(!loadEvalWeights(argv[++i], limits.eval_weights)) {
+                cout << "Couldn't load evaluation weights from " << argv[i] << endl;
+                return 1;
+            }
+        } else if(arg == "-load-tt" && i + 1 < argc) {
+            load_table_filename = argv[++i];
+        } else if(arg == "-save-tt" && i + 1 < argc) {
+            save_table_filename = argv[++i];
+        } else if(arg == "-save-tt-depth" && i + 1 < argc) {
+            table_snapshot.min_depth = max(0, atoi(argv[++i]));
+        } else if(arg == "-players" && i + 1 < argc) {
+            num_players = min(max(2, atoi(argv[++i])), MAX_PLAYERS);
+        } else if(arg == "-strategy" && i + 1 < argc) {
+            if(!findMultiStrategy(argv[++i], multi_strategy)) {
+                cout << "Unknown strategy: " << argv[i] << endl;
+                return 1;
+            }
+        } else if(arg == "-ponder") {
+            g_ponder = true;
+        } else if(arg == "-stats") {
+            g_print_search_stats = true;
+        } else if(arg == "-stats-json" && i + 1 < argc) {
+            g_search_stats_json.open(argv[++i], ios::app);
+            if(g_search_stats_json.fail()) {
+                cout << "Couldn't open " << argv[i] << endl;
+                return 1;
+            }
+        } else if(arg == "-config" && i + 1 < argc) {
+            config = findSearchConfig(argv[++i]);
+            if(!config) {
+                cout << "Unknown config: " << argv[i] << endl << "Configs are:" << endl;
+                for(int j = 0; j < NUM_SEARCH_CONFIGS; ++j) {
+                    cout << "  " << SEARCH_CONFIGS[j].name << " -- " << SEARCH_CONFIGS[j].description << endl;
+                }
+                return 1;
+            }
+        } else if(arg == "bench" && i + 1 < argc) {
+            bench = argv[++i];
+        } else if(arg == "perft" && i + 1 < argc) {
+            perft_depth = max(1, atoi(argv[++i]));
+        } else if(arg == "uai") {
+            uai = true;
+        } else if(arg == "match" && i + 2 < argc) {
+            match_specs[0] = argv[++i];
+            match_specs[1] = argv[++i];
+        } else if(arg == "analyze" && i + 1 < argc) {
+            analyze_filename = argv[++i];
+        } else if(arg == "-book" && i + 1 < argc) {
+            book_filename = argv[++i];
+        } else if(arg == "book" && i + 2 < argc) {
+            build_book_filename = argv[++i];
+            build_book_plies = max(0, atoi(argv[++i]));
+        } else if(arg == "-binary") {
+            analysis_settings.binary = true;
+        } else if(arg == "-private-tt") {
+            analysis_settings.shared_table = false;
+        } else if(arg == "-jobs" && i + 1 < argc) {
+            match_settings.concurrency = analysis_settings.num_workers = max(1, atoi(argv[++i]));
+        } else if(arg == "-games" && i + 1 < argc) {
+            match_settings.max_games = max(2, atoi(argv[++i]));
+        } else if(arg == "-sprt" && i + 2 < argc) {
+            match_settings.elo0 = atof(argv[++i]);
+            match_settings.elo1 = atof(argv[++i]);
+        } else {
+            cout << "Usage: " << argv[0] << USAGE << endl;
+            return 1;
+        }
+    }
+
+    if(!depth_given && (limits.nodes > 0 || limits.move_time_ms > 0 || limits.clock_ms > 0)) {
+        // Let the limits decide how deep to go
+        limits.depth = MAX_SEARCH_DEPTH;
+    } else if(!depth_given && num_players > 2) {
+        limits.depth = MULTIPLAYER_DEFAULT_DEPTH;
+    }
+    setSearchLimits(limits);
+    setSearchConfig(*config);
+
+    if(!resizeZobristTable(zobrist_entries, try_huge_pages)) {
+        cout << "Couldn't allocate the transposition table. Try a smaller -hash." << endl;
+        return 1;
+    }
+
+    // Messages go to stderr, since uai and analyze keep stdout for themselves
+    if(!load_table_filename.empty()) {
+        using namespace std::chrono;
+        steady_clock::time_point t1 = steady_clock::now();
+        size_t num_loaded;
+        if(!loadZobristTable(load_table_filename.c_str(), num_loaded)) {
+            cerr << "Couldn't load a transposition table snapshot from " << load_table_filename << endl;
+            return 1;
+        }
+        double secs = duration_cast<duration<double>>(steady_clock::now() - t1).count();
+        cerr << "Loaded " << num_loaded << " table entries from " << load_table_filename
+             << " in " << secs << " seconds" << endl;
+    }
+    table_snapshot.filename = save_table_filename;
+
+    if(!book_filename.empty() && !openBook(book_filename.c_str())) {
+        cerr << "Couldn't open the opening book " << book_filename << endl;
+        return 1;
+    }
+
+    if(uai) {
+        // Nothing but the protocol may go to stdout
+        runUai(try_huge_pages);
+        return 0;
+    }
+
+    if(!analyze_filename.empty()) {
+        // Results go to stdout, so nothing else may
+        if(analyze_filename == "-") {
+            analyzePositions(cin, cout, analysis_settings);
+        } else {
+            ifstream infile(analyze_filename, analysis_settings.binary ? ios::binary : ios::in);
+            if(infile.fail()) {
+                cerr << "Couldn't open " << analyze_filename << endl;
+                return 1;
+            }
+            analyzePositions(infile, cout, analysis_settings);
+        }
+        return 0;
+    }
+
+    cout << "Built on " << __DATE__ << endl << endl;
+    cout << "Transposition table: " << getZobristTableEntries() * sizeof(ZobristEntry) / 0x100000
+         << " MB, " << getPageSizeName(getZobristTablePageSize()) << endl << endl;
+
+    if(!match_specs[0].empty()) {
+        MatchPlayer players[2];
+        for(int j = 0; j < 2; ++j) {
+            if(!parseMatchPlayer(match_specs[j], limits, players[j])) {
+                cout << "Bad player: " << match_specs[j] << endl;
+                return 1;
+            }
+        }
+        runMatch(players[0], players[1], match_settings);
+        return 0;
+    }
+
+    if(!build_book_filename.empty()) {
+        return buildBook(build_book_filename.c_str(), build_book_plies, analysis_settings.num_workers) ? 0 : 1;
+    }
+
+    if(perft_depth > 0) {
+        return perftSuite(perft_depth) ? 0 : 1;
+    }
+
+    if(bench == "smp") {
+        benchSmpScaling();
+        return 0;
+    } else if(bench == "tt") {
+        benchTranspositionTable();
+        return 0;
+    } else if(bench == "pages") {
+        benchPageSizes();
+        return 0;
+    } else if(bench == "hash") {
+        benchHashing();
+        return 0;
+    } else if(bench == "configs") {
+        benchSearchConfigs();
+        return 0;
+    } else if(bench == "solver") {
+        benchEndgameSolver();
+        return 0;
+    } else if(bench == "eval") {
+        benchEvaluation(match_settings);
+        return 0;
+    } else if(bench == "ponder") {
+        benchPondering();
+        return 0;
+    } else if(bench == "geometry") {
+        benchGeometry();
+        return 0;
+    } else if(bench == "multi") {
+        benchMultiplayer();
+        return 0;
+    } else if(!bench.empty()) {
+        cout << "Unknown benchmark: " << bench << endl;
+        return 1;
+    }
+
+    if(num_players > 2) {
+        playMultiplayerGame(num_players, multi_strategy);
+        return 0;
+    }
+
     int which_ai;
     if(!askForWhichAI(which_ai)) {
         return 0;
     }
 
+    AsyncSearch ponder;
     Board board;
     initBoard(board);
     drawBoard(board);
     while(true) {
-        // @TODO@ -- accommodate 3 or 4 players
         if(board.countPieces(PLAYER1) == 0) {
             cout << "Red wins!" << endl;
             return 0;
@@ -71,7 +358,6 @@ int main()
             return 0;
         }
 
-        // @TODO@ -- accommodate 3 or 4 players
         if(!hasLegalMove(board, PLAYER1) && !hasLegalMove(board, PLAYER2)) {
             int p1_num_pieces = board.countPieces(PLAYER1);
             int p2_num_pieces = board.countPieces(PLAYER2);
@@ -100,7 +386,7 @@ int main()
         // CPU's turn
         if(hasLegalMove(board, PLAYER2)) {
             Move move;
-            decideCpusMove(board, move, which_ai);
+            decideCpusMove(board, move, which_ai, *config, ponder);
             /*** DEBUG ***/
             //decideCpusMove(board, move, AI_NEGAMAX_WITHOUT_BB);
             //decideCpusMove(board, move, AI_NEGAMAX_WITH_BB);
@@ -113,28 +399,24 @@ int main()
     return 0;
 }
 
-void initBoard(Board& board)
-{
-    for(int y = 0; y < BOARD_SIZE; ++y) {
-        for(int x = 0; x < BOARD_SIZE; ++x) {
-            board(x, y) = EMPTY_SQUARE;
-        }
-    }
-    board(0, 0) = PLAYER1;
-    board(6, 0) = PLAYER2;
-    board(0, 6) = PLAYER2;
-    board(6, 6) = PLAYER1;
-}
-
 void drawBoard(const Board& board)
 {
+#ifdef _WIN32
     HANDLE hConsole = GetStdHandle(STD_OUTPUT_HANDLE);
+#endif
 
-    cout << "  A B C D E F G" << endl;
-    cout << " ---------------" << endl;
+    string rule = " " + string(2*BOARD_SIZE + 1, '-');
+    cout << " ";
+    for(int x = 0; x < BOARD_SIZE; ++x) {
+        cout << " " << char('A' + x);
+    }
+    cout << endl << rule << endl;
     for(int y = 0; y < BOARD_SIZE; ++y) {
         cout << (y + 1) << "|";
         for(int x = 0; x < BOARD_SIZE; ++x) {
+            // Blocked squares are always empty
+            const char* symbol = Board::isPlayable(Coord(x, y)) ? "*" : "#";
+#ifdef _WIN32
             WORD color = 0;
             switch(board(x, y)) {
               case EMPTY_SQUARE:    break;
@@ -146,11 +428,23 @@ void drawBoard(const Board& board)
             }
             cout << flush;
             SetConsoleTextAttribute(hConsole, color);
-            cout << "*" << flush;
+            cout << symbol << flush;
             SetConsoleTextAttribute(hConsole, FOREGROUND_RED | FOREGROUND_GREEN | FOREGROUND_BLUE);
+#else
+            const char* color;
+            switch(board(x, y)) {
+              case EMPTY_SQUARE:    color = "\x1b[30m"; break;
+              case PLAYER1:         color = "\x1b[1;34m"; break;
+              case PLAYER2:         color = "\x1b[1;31m"; break;
+              case PLAYER3:         color = "\x1b[1;32m"; break;
+              case PLAYER4:         color = "\x1b[1;35m"; break;
+              default: /* can't happen */ color = "\x1b[41m"; break;
+            }
+            cout << color << symbol << "\x1b[0m";
+#endif
             cout << "|";
         }
-        cout << endl << " ---------------" << endl;
+        cout << endl << rule << endl;
     }
     cout << endl;
 }
@@ -166,10 +460,11 @@ bool askForWhichAI(int& which_ai)
         cout << "2) Negamax" << endl;
         cout << "3) Negamax with iterative deepening" << endl;
         cout << "4) MTD(f)" << endl;
+        cout << "5) Principal variation search" << endl;
         cout << endl;
         cout << "Enter a number> ";
         cin >> which_ai_str;
-        transform(which_ai_str.begin(), which_ai_str.end(), which_ai_str.begin(), tolower);
+        transform(which_ai_str.begin(), which_ai_str.end(), which_ai_str.begin(), ::tolower);
         if(which_ai_str == "exit" || which_ai_str == "quit") {
             return false;
         }
@@ -196,7 +491,7 @@ bool askForHumansMove(Board& board, Move &move)
     while(true) {
         cout << "Your move> ";
         cin >> move_str;
-        transform(move_str.begin(), move_str.end(), move_str.begin(), tolower);
+        transform(move_str.begin(), move_str.end(), move_str.begin(), ::tolower);
         if(move_str == "exit" || move_str == "quit") {
             return false;
         }
@@ -209,7 +504,8 @@ bool askForHumansMove(Board& board, Move &move)
             drawBoard(board);
             continue;
         }
-        if(!regex_match(move_str, regex("[a-g][1-7][a-g][1-7]"))) {
+        string square_pattern = string("[a-") + char('a' + BOARD_SIZE - 1) + "][1-" + char('0' + BOARD_SIZE) + "]";
+        if(!regex_match(move_str, regex(square_pattern + square_pattern))) {
             cout << "Move format is (e.g.) a1b2" << endl;
             continue;
         }
@@ -224,43 +520,101 @@ bool askForHumansMove(Board& board, Move &move)
     }
 }
 
-void decideCpusMove(const Board& board, Move& move, int which_ai)
+void decideCpusMove(const Board& board, Move& move, int which_ai, const SearchConfig& config, AsyncSearch& ponder)
 {
     using namespace std::chrono;
-    if(CLEAR_ZOBRIST_EVERY_TIME) {
-        initZobristTable();
+    int book_score, book_depth;
+    if(which_ai != AI_RANDOM_MOVE && probeBook(board, move, book_score, book_depth)) {
+        ponder.cancel();
+        cout << "Book move; estimated score " << book_score << " from a depth " << book_depth << " search" << endl;
+        return;
     }
 
-    std::vector<int> square_order(NUM_SQUARES);
-    std::vector<int> jump_order(NUM_JUMPS);
-    for(int i = 0; i < NUM_SQUARES; ++i) {
-        square_order.at(i) = i;
-    }
-    for(int i = 0; i < NUM_JUMPS; ++i) {
-        jump_order.at(i) = i;
-    }
-    if(ENABLE_RANDOMNESS) {
-        std::shuffle(square_order.begin(), square_order.end(), g_rng);
-    }
-
-    int nodes_searched = 0;
     AiFuncPtr ai;
     switch(which_ai) {
       case AI_RANDOM_MOVE:                  ai = random_move; break;
       case AI_NEGAMAX:                      ai = negamax_bb; break;
       case AI_NEGAMAX_ITERATIVE:            ai = negamax_iterative_bb; break;
       case AI_MTDF:                         ai = mtdf_bb; break;
+      case AI_PVS:                          ai = pvs_bb; break;
       default:                              assert(false);
     }
+    setSearchConfig(config);
     steady_clock::time_point t1 = steady_clock::now();
-    int score = ai(board, square_order, jump_order, move, nodes_searched);
+    bool ponder_hit;
+    SearchResult result = searchWithPonder(ponder, board, ai, ponder_hit);
     steady_clock::time_point t2 = steady_clock::now();
+    move = result.move;
     duration<double> secs = duration_cast<duration<double>>(t2 - t1);
-    cout << "Searched " << nodes_searched << " nodes in " << secs.count() << " seconds";
+    if(ponder_hit) {
+        cout << "Ponder hit" << endl;
+    }
+    cout << "Searched " << result.nodes << " nodes in " << secs.count() << " seconds";
     if(secs.count() > 0) {
-        cout << " (" << int(nodes_searched / secs.count()) << " nodes/sec)";
+        cout << " (" << (long long)(result.nodes / secs.count()) << " nodes/sec)";
+    }
+    if(which_ai != AI_RANDOM_MOVE) {
+        cout << endl << "Completed depth " << result.depth;
+    }
+    cout << endl << "CPU's estimated score for this move: " << result.score << endl;
+    if(which_ai != AI_RANDOM_MOVE) {
+        if(g_print_search_stats) {
+            printSearchStats(cout, result.stats);
+        }
+        if(g_search_stats_json.is_open()) {
+            writeSearchStatsJson(g_search_stats_json, result.stats, AI_NAMES[which_ai], result.depth, result.score, secs.count(),
+                                 ponder_hit);
+        }
+        if(g_ponder) {
+            startPondering(ponder, board, move, ai);
+        }
+    }
+
+    SearchLimits limits = getSearchLimits();
+    if(limits.move_time_ms == 0 && limits.clock_ms > 0) {
+        int elapsed_ms = int(duration_cast<milliseconds>(t2 - t1).count());
+        limits.clock_ms = max(1, limits.clock_ms - elapsed_ms) + limits.increment_ms;
+        setSearchLimits(limits);
+        cout << "CPU's clock: " << limits.clock_ms / 1000.0 << " seconds" << endl;
+    }
+}
+
+// The human plays player 1 and the CPU everybody else
+void playMultiplayerGame(int num_players, MultiStrategy strategy)
+{
+    using namespace std::chrono;
+    cout << num_players << " players; you are " << PLAYER_NAMES[0] << ", and the CPU plays "
+         << MULTI_STRATEGY_NAMES[strategy] << endl;
+    Board board;
+    initMultiBoard(board, num_players);
+    drawBoard(board);
+    Player player = nextMultiPlayer(board, num_players, Player(PLAYER1 + num_players - 1));
+    while(player != PLAYER_NONE) {
+        Move move;
+        if(player == PLAYER1) {
+            if(!askForHumansMove(board, move)) {
+                return;
+            }
+        } else {
+            cout << PLAYER_NAMES[player - PLAYER1] << " is thinking..." << endl;
+            long long nodes_searched = 0;
+            steady_clock::time_point t1 = steady_clock::now();
+            int score = searchMultiBB(board, num_players, player, strategy, move, nodes_searched);
+            duration<double> secs = duration_cast<duration<double>>(steady_clock::now() - t1);
+            cout << "Searched " << nodes_searched << " nodes in " << secs.count() << " seconds" << endl;
+            cout << "CPU's estimated score for this move: " << score << endl;
+        }
+        makeMove(board, move);
+        drawBoard(board);
+        player = nextMultiPlayer(board, num_players, player);
+    }
+
+    Player winner = finishMultiGame(board, num_players);
+    drawBoard(board);
+    for(int i = 0; i < num_players; ++i) {
+        cout << PLAYER_NAMES[i] << ": " << board.countPieces(Player(PLAYER1 + i)) << " pieces" << endl;
     }
-    cout << endl << "CPU's estimated score for this move: " << score << endl;
+    cout << (winner == PLAYER_NONE ? "Nobody" : PLAYER_NAMES[winner - PLAYER1]) << " wins!" << endl;
 }
 
 // @TODO@ -- error checking; exception safety?
@@ -272,26 +626,35 @@ void saveGame(const Board& board, const std::string& filename)
     }
     for(int y = 0; y < BOARD_SIZE; ++y) {
         for(int x = 0; x < BOARD_SIZE; ++x) {
-            outfile << unsigned char(board(x, y));
+            outfile << (unsigned char)board(x, y);
         }
     }
     std::cout << "Game saved." << std::endl;
     outfile.close();
 }
 
-// @TODO@ -- error checking; exception safety?
+// Leaves board alone unless the whole file loads: a square holding anything
+// but a piece of player 1's or 2's, or a piece on a blocked square, is an error
+// @TODO@ -- exception safety?
 void loadGame(Board& board, const std::string& filename)
 {
-    std::ifstream infile(filename);
+    std::ifstream infile(filename, std::ios::binary);
     if(infile.fail()) {
         std::cout << "Failed to load file." << std::endl;
+        return;
     }
+    Board loaded;
     for(int y = 0; y < BOARD_SIZE; ++y) {
         for(int x = 0; x < BOARD_SIZE; ++x) {
-            unsigned char player;
-            infile >> player;
-            board(x, y) = Player(player);
+            char player;
+            if(!infile.get(player) || (unsigned char)player > PLAYER2
+               || (player != EMPTY_SQUARE && !Board::isPlayable(Coord(x, y))))
+            {
+                std::cout << "Failed to load file." << std::endl;
+                return;
+            }
+            loaded(x, y) = Player(player);
         }
     }
-    infile.close();
+    board = loaded;
 }
@@ -0,0 +1,312 @@
+#ifndef SPLOT_MOVEGEN_BB_HPP
+#define SPLOT_MOVEGEN_BB_HPP
+
+#include <cassert>
+#include <vector>
+#include "moves.hpp"
+#include "bitboards.hpp"
+
+const int NUM_KILLERS = 2;
+
+// Tables with an entry per move, like SearchState::history, have one for each
+// square's clone and one for each of its jumps
+const int NUM_MOVE_INDICES = NUM_SQUARES * (NUM_JUMPS + 1);
+
+inline int moveIndexBB(BitboardMove bbmove)
+{
+    assert(bbmove.move_type == BBMOVE_CLONE || bbmove.move_type == BBMOVE_JUMP);
+    return bbmove.square * (NUM_JUMPS + 1) + (bbmove.move_type == BBMOVE_JUMP ? bbmove.jump_type : NUM_JUMPS);
+}
+
+// Scores for ordering moves within a stage. The history score is added on top
+// (see SearchState::history); HISTORY_LIMIT keeps it below the bonuses for
+// killers and countermoves.
+const int KILLER_ORDER_BONUS = 1 << 20;
+const int COUNTERMOVE_ORDER_BONUS = 1 << 19;
+const int CAPTURE_ORDER_BONUS = 1 << 12;        // For each piece captured
+
+// What StagedMoveGenBB orders the moves within a stage by
+struct MoveOrderingBB
+{
+    const int* history;                 // Indexed by moveIndexBB
+    BitboardMove killers[NUM_KILLERS];
+    BitboardMove countermove;           // The usual refutation of the move that led here
+};
+
+// Generates the moves of a position in stages, most promising first: clones,
+// then jumps that capture, then jumps that don't. Where each stage's moves go
+// is worked out for the whole board at once by dilating the bitboards, so
+// squares and pieces with nothing to offer are skipped without looking at
+// their jumps, and nothing is scanned twice. Within a stage, moves come in
+// square_order (and each piece's jumps in jump_order), unless there's a
+// MoveOrderingBB: then they go best score first, and moves with equal scores
+// keep that order. The Lazy SMP helpers rely on this to search in different
+// orders.
+class StagedMoveGenBB
+{
+  public:
+    // skip is a move that has already been searched, e.g. the one from the
+    // transposition table. It won't be generated again. ordering must outlive
+    // the generator.
+    StagedMoveGenBB(Bitboard bb_me, Bitboard bb_him, const std::vector<int>& square_order,
+                    const std::vector<int>& jump_order, BitboardMove skip,
+                    const MoveOrderingBB* ordering = nullptr)
+        : m_square_order(square_order),
+          m_jump_order(jump_order),
+          m_skip(skip),
+          m_me(bb_me),
+          m_him(bb_him),
+          m_stage(STAGE_CLONES),
+          m_stage_targets(0),
+          m_square_index(0),
+          m_jump_index(0),
+          m_source(0),
+          m_sources(0),
+          m_ordering(ordering),
+          m_buffered_stage(STAGE_CLONES),
+          m_num_moves(0),
+          m_move_index(0),
+          m_have_pending(false)
+    {
+        m_empty = invertBitboard(bb_me | bb_him);
+        m_capture_targets = dilateBitboard(bb_him) & m_empty;
+        m_targets = cloneTargets(bb_me, m_empty);
+    }
+
+    // Puts the next move in move_out and returns true, or returns false if
+    // there are no more moves
+    bool next(BitboardMove& move_out)
+    {
+        if(!m_ordering) {
+            return generate(move_out);
+        }
+        if(m_move_index == m_num_moves && !bufferStage()) {
+            return false;
+        }
+        // Picks the best move left. Most nodes either cut off after a move or
+        // two or have to search everything, so sorting the whole stage up
+        // front isn't worth it. The keys are all different (see addMove), so
+        // swapping doesn't upset the order of ties.
+        int best = m_move_index;
+        for(int i = m_move_index + 1; i < m_num_moves; ++i) {
+            if(m_keys[i] > m_keys[best]) {
+                best = i;
+            }
+        }
+        move_out = m_moves[best];
+        m_moves[best] = m_moves[m_move_index];
+        m_keys[best] = m_keys[m_move_index];
+        ++m_move_index;
+        return true;
+    }
+
+    enum Stage
+    {
+        STAGE_CLONES,
+        STAGE_CAPTURING_JUMPS,
+        STAGE_QUIET_JUMPS,
+        STAGE_DONE
+    };
+
+    // The stage of the move next returned last
+    Stage stage() const
+    {
+        return m_ordering ? m_buffered_stage : m_stage;
+    }
+
+  private:
+
+    // A player has at most 24 pieces that can jump, or else there are at most
+    // 24 empty squares to jump to
+    static const int MAX_STAGE_MOVES = NUM_JUMPS * (NUM_SQUARES / 2);
+
+    // Like next, but in square_order
+    bool generate(BitboardMove& move_out)
+    {
+        while(true) {
+            switch(m_stage) {
+              case STAGE_CLONES:
+                // m_targets is the clone targets not generated yet
+                while(m_targets) {
+                    int square_num = m_square_order[m_square_index++];
+                    Bitboard bit = Bitboard(1) << square_num;
+                    if(m_targets & bit) {
+                        m_targets &= ~bit;
+                        move_out = BitboardMove(BBMOVE_CLONE, square_num, 0);
+                        if(move_out != m_skip) {
+                            return true;
+                        }
+                    }
+                }
+                startJumpStage(STAGE_CAPTURING_JUMPS, m_capture_targets);
+                break;
+
+              case STAGE_CAPTURING_JUMPS:
+              case STAGE_QUIET_JUMPS:
+                // m_targets is where the current source can still jump to
+                while(m_targets) {
+                    int jump_num = m_jump_order[m_jump_index++];
+                    Bitboard dest_square = BITBOARD_JUMPS[m_source][jump_num].dest_square;
+                    if(m_targets & dest_square) {
+                        m_targets &= ~dest_square;
+                        move_out = BitboardMove(BBMOVE_JUMP, m_source, jump_num);
+                        if(move_out != m_skip) {
+                            return true;
+                        }
+                    }
+                }
+                if(!nextJumpSource()) {
+                    if(m_stage == STAGE_CAPTURING_JUMPS) {
+                        startJumpStage(STAGE_QUIET_JUMPS, m_empty & ~m_capture_targets);
+                    } else {
+                        m_stage = STAGE_DONE;
+                    }
+                }
+                break;
+
+              case STAGE_DONE:
+                return false;
+            }
+        }
+    }
+
+    // Collects the moves of the next stage that has any, with their keys.
+    // Returns false if there are none left.
+    bool bufferStage()
+    {
+        m_num_moves = 0;
+        m_move_index = 0;
+        BitboardMove bbmove;
+        if(m_have_pending) {
+            m_have_pending = false;
+            addMove(m_pending);
+        } else if(generate(bbmove)) {
+            addMove(bbmove);
+        } else {
+            return false;
+        }
+        // m_stage is the stage of the move generate last returned. The first
+        // move of the stage after this one has to wait for the next call.
+        Stage stage = m_stage;
+        m_buffered_stage = stage;
+        while(generate(bbmove)) {
+            if(m_stage != stage) {
+                m_pending = bbmove;
+                m_have_pending = true;
+                break;
+            }
+            addMove(bbmove);
+        }
+        return true;
+    }
+
+    void addMove(BitboardMove bbmove)
+    {
+        assert(m_num_moves < MAX_STAGE_MOVES);
+        Bitboard capture_radius = (bbmove.move_type == BBMOVE_CLONE)
+            ? BITBOARD_SURROUNDS[bbmove.square]
+            : BITBOARD_JUMPS[bbmove.square][bbmove.jump_type].capture_radius;
+        int score = m_ordering->history[moveIndexBB(bbmove)] + CAPTURE_ORDER_BONUS * countSetBits(capture_radius & m_him);
+        if(bbmove == m_ordering->killers[0] || bbmove == m_ordering->killers[1]) {
+            score += KILLER_ORDER_BONUS;
+        } else if(bbmove == m_ordering->countermove) {
+            score += COUNTERMOVE_ORDER_BONUS;
+        }
+        // Moves generated earlier win ties
+        m_moves[m_num_moves] = bbmove;
+        m_keys[m_num_moves] = score * MAX_STAGE_MOVES + (MAX_STAGE_MOVES - 1 - m_num_moves);
+        ++m_num_moves;
+    }
+
+    void startJumpStage(Stage stage, Bitboard stage_targets)
+    {
+        m_stage = stage;
+        m_stage_targets = stage_targets;
+        m_square_index = 0;
+        m_targets = 0;
+        // Only pieces within jumping distance of a target can have a move here
+        m_sources = stage_targets ? m_me & dilateBitboard(dilateBitboard(stage_targets)) : 0;
+    }
+
+    // Moves on to the next piece (in square order) with a jump in this stage.
+    // Returns false if there are none left.
+    bool nextJumpSource()
+    {
+        while(m_sources) {
+            int square_num = m_square_order[m_square_index++];
+            Bitboard bit = Bitboard(1) << square_num;
+            if(m_sources & bit) {
+                m_sources &= ~bit;
+                m_targets = BITBOARD_JUMP_TARGETS[square_num] & m_stage_targets;
+                if(m_targets) {
+                    m_source = square_num;
+                    m_jump_index = 0;
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    const std::vector<int>& m_square_order;
+    const std::vector<int>& m_jump_order;
+    BitboardMove m_skip;
+    Bitboard m_me;
+    Bitboard m_him;
+    Bitboard m_empty;
+    Bitboard m_capture_targets;     // Empty squares next to an opponent's piece
+    Stage m_stage;
+    Bitboard m_stage_targets;       // Squares the jumps in this stage land on
+    int m_square_index;
+    int m_jump_index;
+    int m_source;                   // Piece whose jumps are being generated
+    Bitboard m_sources;             // Pieces that may have jumps in this stage, not yet looked at
+    Bitboard m_targets;
+
+    // Only used with an ordering: the current stage's moves, with those from
+    // m_move_index on not returned yet
+    const MoveOrderingBB* m_ordering;
+    Stage m_buffered_stage;
+    BitboardMove m_moves[MAX_STAGE_MOVES];
+    int m_keys[MAX_STAGE_MOVES];        // The moves' scores, made unique
+    int m_num_moves;
+    int m_move_index;
+    BitboardMove m_pending;             // The first move of the next stage, if m_have_pending
+    bool m_have_pending;
+};
+
+inline void handleCaptures(Bitboard capture_radius, Bitboard& me, Bitboard& him)
+{
+    Bitboard captures = him & capture_radius;
+    me |= captures;
+    him &= ~captures;
+}
+
+inline void makeMoveBB(BitboardMove bbmove, Bitboard& me, Bitboard& him)
+{
+    Bitboard square_bit = (1LL << bbmove.square);
+    switch(bbmove.move_type)
+    {
+      case BBMOVE_CLONE:
+        me |= square_bit;
+        handleCaptures(BITBOARD_SURROUNDS[bbmove.square], me, him);
+        break;
+
+      case BBMOVE_JUMP:
+      {
+        BitboardJump jump = BITBOARD_JUMPS[bbmove.square][bbmove.jump_type];
+        me |= jump.dest_square;
+        me &= invertBitboard(square_bit);      // remove piece from source square
+        handleCaptures(jump.capture_radius, me, him);
+        break;
+      }
+
+      case BBMOVE_NULL:
+        break;
+
+      default:
+        assert(false);
+    }
+}
+
+#endif
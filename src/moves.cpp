@@ -1,35 +1,30 @@
 #include <cstdlib>
-#include <vector>
 
 #include "Board.hpp"
 #include "moves.hpp"
+#include "bitboards.hpp"
 
 using namespace std;
 
 bool hasLegalMove(const Board& board, Player player)
 {
-    vector<Move> moves;
-    findAllPossibleMoves(board, player, moves);
-    return moves.size() > 0;
+    return hasAnyMoveBB(board.getPieces(player), invertBitboard(board.getOccupied()));
 }
 
-void findAllPossibleMoves(const Board& board, Player player, vector<Move>& moves)
+void findAllPossibleMoves(const Board& board, Player player, MoveList& moves)
 {
-    for(int y = 0; y < 7; ++y) {
-        for(int x = 0; x < 7; ++x) {
-            if(board(x, y) == player) {
-                appendMoves(board, x, y, moves);
-            }
-        }
+    for(Bitboard bits = board.getPieces(player); bits; bits &= bits - 1) {
+        int square_num = lowestSetSquare(bits);
+        appendMoves(board, square_num % BOARD_SIZE, square_num / BOARD_SIZE, moves);
     }
 }
 
-bool appendMoves(const Board& board, int src_x, int src_y, vector<Move>& moves)
+bool appendMoves(const Board& board, int src_x, int src_y, MoveList& moves)
 {
     assert(board.isInRange(Coord(src_x, src_y)));
     for(int dst_y = src_y - 2; dst_y <= src_y + 2; ++dst_y) {
         for(int dst_x = src_x - 2; dst_x <= src_x + 2; ++dst_x) {
-            if(board.isInRange(Coord(dst_x, dst_y)) && board(dst_x, dst_y) == EMPTY_SQUARE) {
+            if(board.isPlayable(Coord(dst_x, dst_y)) && board(dst_x, dst_y) == EMPTY_SQUARE) {
                 Move move = {Coord(src_x, src_y), Coord(dst_x, dst_y)};
                 moves.push_back(move);
             }
@@ -41,7 +36,7 @@ bool appendMoves(const Board& board, int src_x, int src_y, vector<Move>& moves)
 bool checkLegalMove(const Board& board, Player player, const Move& move)
 {
     if(board.isOutOfRange(move.src) ||
-       board.isOutOfRange(move.dst) ||
+       !board.isPlayable(move.dst) ||
        board(move.src.x, move.src.y) != player ||
        board(move.dst.x, move.dst.y) != EMPTY_SQUARE) {
         return false;
@@ -78,3 +73,24 @@ void makeMove(Board& board, const Move& move)
         board(move.src.x, move.src.y) = EMPTY_SQUARE;
     }
 }
+
+void initBoard(Board& board)
+{
+    board = Board();
+    board(0, 0) = PLAYER1;
+    board(BOARD_SIZE - 1, 0) = PLAYER2;
+    board(0, BOARD_SIZE - 1) = PLAYER2;
+    board(BOARD_SIZE - 1, BOARD_SIZE - 1) = PLAYER1;
+}
+
+Player getOpponent(Player player)
+{
+    return (player == PLAYER1) ? PLAYER2 : PLAYER1;
+}
+
+void swapPlayers(Board& board)
+{
+    Bitboard player1 = board.getPieces(PLAYER1);
+    board.setPieces(PLAYER1, board.getPieces(PLAYER2));
+    board.setPieces(PLAYER2, player1);
+}
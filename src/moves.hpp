@@ -1,7 +1,8 @@
 #ifndef SPLOT_MOVES_HPP
 #define SPLOT_MOVES_HPP
 
-#include <vector>
+#include <cassert>
+#include <type_traits>
 #include "Board.hpp"
 
 struct Move
@@ -9,6 +10,87 @@ struct Move
     Coord src, dst;
 };
 
+// Moves go from an occupied square to an empty one no more than two squares
+// away, so there can't be more of them than there are such pairs of squares
+constexpr int countMovePairs()
+{
+    // Pairs of columns no more than two apart, in either order, and each
+    // column with itself; rows are the same
+    int column_pairs = BOARD_SIZE + 2*(BOARD_SIZE - 1) + 2*(BOARD_SIZE - 2);
+    return (column_pairs*column_pairs - NUM_SQUARES) / 2;
+}
+
+const int MAX_MOVES = countMovePairs();
+
+// As many moves as a player can have, without going to the heap. The moves
+// are left uninitialized until they're added, since clearing them all would
+// take longer than finding the few dozen most positions have.
+class MoveList
+{
+  public:
+    MoveList()
+        : m_size(0)
+    {
+    }
+
+    void push_back(const Move& move)
+    {
+        assert(m_size < MAX_MOVES);
+        begin()[m_size++] = move;
+    }
+
+    void clear()
+    {
+        m_size = 0;
+    }
+
+    int size() const
+    {
+        return m_size;
+    }
+
+    bool empty() const
+    {
+        return m_size == 0;
+    }
+
+    Move& operator[](int i)
+    {
+        assert(i >= 0 && i < m_size);
+        return begin()[i];
+    }
+
+    const Move& operator[](int i) const
+    {
+        assert(i >= 0 && i < m_size);
+        return begin()[i];
+    }
+
+    Move* begin()
+    {
+        return reinterpret_cast<Move*>(m_moves);
+    }
+
+    Move* end()
+    {
+        return begin() + m_size;
+    }
+
+    const Move* begin() const
+    {
+        return reinterpret_cast<const Move*>(m_moves);
+    }
+
+    const Move* end() const
+    {
+        return begin() + m_size;
+    }
+
+  private:
+    typename std::aligned_storage<sizeof(Move), alignof(Move)>::type m_moves[MAX_MOVES];
+    int m_size;
+};
+
 enum BitboardMoveType : unsigned
 {
     BBMOVE_NONE,    // Not a null move! This is more like "not a move" or "invalid"; it's like a null pointer for moves
@@ -30,6 +112,18 @@ struct BitboardMove
     {
     }
 
+    // jump_type only matters for jumps
+    bool operator==(const BitboardMove& rhs) const
+    {
+        return move_type == rhs.move_type && square == rhs.square
+            && (move_type != BBMOVE_JUMP || jump_type == rhs.jump_type);
+    }
+
+    bool operator!=(const BitboardMove& rhs) const
+    {
+        return !(*this == rhs);
+    }
+
     BitboardMoveType move_type : 2;
     unsigned square : 6;                // Destination if clone move, source if jump move
     unsigned char jump_type;            // 16 possible values
@@ -37,9 +131,24 @@ struct BitboardMove
 #pragma pack()
 
 bool hasLegalMove(const Board& board, Player player);
-void findAllPossibleMoves(const Board& board, Player player, std::vector<Move>& moves);
-bool appendMoves(const Board& board, int src_x, int src_y, std::vector<Move>& moves);
+
+// Both add to the end of moves, clones from different pieces included
+void findAllPossibleMoves(const Board& board, Player player, MoveList& moves);
+bool appendMoves(const Board& board, int src_x, int src_y, MoveList& moves);
 bool checkLegalMove(const Board& board, Player player, const Move& move);
 void makeMove(Board& board, const Move& move);
 
+// The start position: player 1 in the bottom left and top right corners,
+// player 2 in the other two. The standard start is this with the players
+// swapped (see getStartFen).
+void initBoard(Board& board);
+
+// Two players only
+Player getOpponent(Player player);
+
+// Gives player 1's pieces to player 2 and vice versa. The AIs always play
+// player 2, so to have one play player 1, swap the pieces first; its move is
+// good for the real board as is.
+void swapPlayers(Board& board);
+
 #endif
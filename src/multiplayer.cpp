@@ -0,0 +1,408 @@
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "Board.hpp"
+#include "moves.hpp"
+#include "ai.hpp"
+#include "bitboards.hpp"
+#include "movegen_bb.hpp"
+#include "zobrist.hpp"
+#include "multiplayer.hpp"
+
+const char* const MULTI_STRATEGY_NAMES[NUM_MULTI_STRATEGIES] = {"paranoid", "maxn"};
+
+namespace
+{
+
+// Each strategy's results go in the table under a key of its own, so they
+// never mix with each other's or the two-player searches'. Paranoid scores
+// are from the root player's side, so each root player gets a key too.
+const ZobristHash PARANOID_TABLE_KEY = 0x2F6A1C93D85E4B07LL;
+const ZobristHash MAXN_TABLE_KEY = 0x34B41E7D2A960C5FLL;
+
+// Max^n scores are the players' shares of the pieces on the board, in
+// thousandths and rounded down, so they add up to no more than this. Counts
+// of pieces would add up to no more than the number of squares, but that's
+// too loose a bound for shallow pruning to ever come into it.
+const int MAXN_SCORE_SUM = 1000;
+
+std::vector<int> makeIdentityOrder(int size)
+{
+    std::vector<int> order(size);
+    for(int i = 0; i < size; ++i) {
+        order[i] = i;
+    }
+    return order;
+}
+
+const std::vector<int> SQUARE_ORDER = makeIdentityOrder(NUM_SQUARES);
+const std::vector<int> JUMP_ORDER = makeIdentityOrder(NUM_JUMPS);
+
+int searchParanoidBB(MultiPositionBB position, int root, int depth, int alpha, int beta, bool is_root, BitboardMove& move_out, SearchState& ss);
+void searchMaxnBB(MultiPositionBB position, int depth, int parent_best, int scores_out[MAX_PLAYERS], BitboardMove& move_out, SearchState& ss);
+BitboardMove probeMoveMultiBB(const ZobristValue& zv, Bitboard bb_me, Bitboard bb_empty);
+int scoreFinishedParanoidBB(const MultiPositionBB& position, int root);
+int evalParanoidBB(const MultiPositionBB& position, int root);
+void evalMaxnBB(const MultiPositionBB& position, int scores_out[MAX_PLAYERS]);
+
+}
+
+bool findMultiStrategy(const std::string& name, MultiStrategy& strategy_out)
+{
+    for(int strategy = 0; strategy < NUM_MULTI_STRATEGIES; ++strategy) {
+        if(name == MULTI_STRATEGY_NAMES[strategy]) {
+            strategy_out = MultiStrategy(strategy);
+            return true;
+        }
+    }
+    return false;
+}
+
+void initMultiBoard(Board& board, int num_players)
+{
+    assert(num_players >= 2 && num_players <= MAX_PLAYERS);
+    initBoard(board);
+    if(num_players == 2) {
+        return;
+    }
+    const Coord CORNERS[MAX_PLAYERS] = {
+        Coord(0, 0), Coord(BOARD_SIZE - 1, 0), Coord(BOARD_SIZE - 1, BOARD_SIZE - 1), Coord(0, BOARD_SIZE - 1)
+    };
+    for(int i = 0; i < MAX_PLAYERS; ++i) {
+        board(CORNERS[i]) = (i < num_players) ? Player(PLAYER1 + i) : EMPTY_SQUARE;
+    }
+}
+
+void convBoardToMultiBB(const Board& board, int num_players, Player to_move, MultiPositionBB& position)
+{
+    assert(num_players >= 2 && num_players <= MAX_PLAYERS);
+    assert(to_move >= PLAYER1 && to_move < PLAYER1 + num_players);
+    for(int player = 0; player < MAX_PLAYERS; ++player) {
+        position.pieces[player] = board.getPieces(Player(PLAYER1 + player));
+        assert(player < num_players || !position.pieces[player]);
+    }
+    position.num_players = num_players;
+    position.to_move = to_move - PLAYER1;
+    position.hash = calcHashMultiBB(position);
+}
+
+ZobristHash calcHashMultiBB(const MultiPositionBB& position)
+{
+    ZobristHash hash = ZOBRIST_TURN_CODES[position.to_move] ^ ZOBRIST_NUM_PLAYERS_CODES[position.num_players];
+    for(int player = 0; player < position.num_players; ++player) {
+        for(Bitboard bits = position.pieces[player]; bits; bits &= bits - 1) {
+            hash ^= ZOBRIST_MULTI_CODES[player][lowestSetSquare(bits)];
+        }
+    }
+    return hash;
+}
+
+Player nextMultiPlayer(const Board& board, int num_players, Player player)
+{
+    MultiPositionBB position;
+    convBoardToMultiBB(board, num_players, player, position);
+    position.to_move = (position.to_move + 1) % num_players;
+    int mover = findMultiMoverBB(position, invertBitboard(occupiedMultiBB(position)));
+    return (mover < 0) ? PLAYER_NONE : Player(PLAYER1 + mover);
+}
+
+Player finishMultiGame(Board& board, int num_players)
+{
+    MultiPositionBB position;
+    convBoardToMultiBB(board, num_players, PLAYER1, position);
+    finishMultiGameBB(position);
+    int num_pieces[MAX_PLAYERS];
+    int most_pieces = 0;
+    for(int player = 0; player < num_players; ++player) {
+        board.setPieces(Player(PLAYER1 + player), position.pieces[player]);
+        num_pieces[player] = countSetBits(position.pieces[player]);
+        most_pieces = std::max(most_pieces, num_pieces[player]);
+    }
+    Player winner = PLAYER_NONE;
+    for(int player = 0; player < num_players; ++player) {
+        if(num_pieces[player] == most_pieces) {
+            if(winner != PLAYER_NONE) {
+                return PLAYER_NONE;
+            }
+            winner = Player(PLAYER1 + player);
+        }
+    }
+    return winner;
+}
+
+int searchMultiBB(const Board& board, int num_players, Player player, MultiStrategy strategy, Move& move_out,
+                  long long& nodes_searched)
+{
+    using namespace std::chrono;
+    MultiPositionBB position;
+    convBoardToMultiBB(board, num_players, player, position);
+    int root = position.to_move;
+
+    const SearchLimits& limits = getSearchLimits();
+    SearchBudget budget = makeSearchBudget(limits);
+    std::atomic<bool> stop(false);
+    SearchState ss;
+    ss.stop = &stop;
+    ss.budget = &budget;
+    ss.table_key = (strategy == MULTI_PARANOID) ? splitMix64(PARANOID_TABLE_KEY + root) : MAXN_TABLE_KEY;
+
+    int score = 0;
+    for(int depth = 1; depth <= limits.depth; ++depth) {
+        BitboardMove bbmove;
+        int iteration_score;
+        if(strategy == MULTI_PARANOID) {
+            iteration_score = searchParanoidBB(position, root, depth, -INFINITE_SCORE, INFINITE_SCORE, true, bbmove, ss);
+        } else {
+            int scores[MAX_PLAYERS];
+            searchMaxnBB(position, depth, -1, scores, bbmove, ss);
+            iteration_score = scores[root];
+        }
+        if(ss.isAborted()) {
+            break;
+        }
+        score = iteration_score;
+        convBitboardMoveToMove(board, player, bbmove, move_out);
+        ss.have_move = true;
+        // Deeper searches can't change a decided game
+        if(strategy == MULTI_PARANOID && std::abs(score) == WIN) {
+            break;
+        }
+        if(budget.timed && budget.checkClock() && steady_clock::now() >= budget.soft_deadline) {
+            break;
+        }
+    }
+    nodes_searched += ss.nodes_searched;
+    return score;
+}
+
+namespace
+{
+
+// Alpha-beta over root's score: root maximizes it, and everybody else
+// minimizes it together
+int searchParanoidBB(MultiPositionBB position, int root, int depth, int alpha, int beta, bool is_root, BitboardMove& move_out, SearchState& ss)
+{
+    ++ss.nodes_searched;
+    ++ss.stats.nodes[depth];
+    ss.checkBudget();
+    if(ss.isAborted()) {
+        return 0;
+    }
+    move_out = BitboardMove(BBMOVE_NONE, 0, 0);
+    if(depth == 0) {
+        return evalParanoidBB(position, root);
+    }
+
+    Bitboard bb_empty = invertBitboard(occupiedMultiBB(position));
+    int mover = findMultiMoverBB(position, bb_empty);
+    if(mover < 0) {
+        finishMultiGameBB(position);
+        return scoreFinishedParanoidBB(position, root);
+    }
+    setMultiTurnBB(position, mover);
+    Bitboard bb_me = position.pieces[mover];
+
+    ZobristHash tt_hash = position.hash ^ ss.table_key;
+    ZobristValue zv = getZobristValueBB(tt_hash);
+    ++ss.stats.tt_probes[depth];
+    if(zv.depth >= 0) {
+        ++ss.stats.tt_hits[depth];
+    }
+    // The root has to come up with a move
+    if(!is_root && zv.depth >= depth) {
+        if(zv.lower_bound >= beta || zv.lower_bound == zv.upper_bound) {
+            ++ss.stats.tt_cutoffs[depth];
+            return zv.lower_bound;
+        }
+        if(zv.upper_bound <= alpha) {
+            ++ss.stats.tt_cutoffs[depth];
+            return zv.upper_bound;
+        }
+    }
+    BitboardMove tt_move = probeMoveMultiBB(zv, bb_me, bb_empty);
+
+    bool maximizing = (mover == root);
+    int original_alpha = alpha;
+    int original_beta = beta;
+    int best_score = maximizing ? -INFINITE_SCORE : INFINITE_SCORE;
+    BitboardMove best_move(BBMOVE_NONE, 0, 0);
+    StagedMoveGenBB move_gen(bb_me, invertBitboard(bb_me | bb_empty), SQUARE_ORDER, JUMP_ORDER, tt_move);
+    BitboardMove bbmove = tt_move;
+    bool have_move = (tt_move.move_type != BBMOVE_NONE) || move_gen.next(bbmove);
+    while(have_move) {
+        MultiPositionBB child(position);
+        makeMoveMultiBB(bbmove, child);
+        BitboardMove child_move;
+        int score = searchParanoidBB(child, root, depth - 1, alpha, beta, false, child_move, ss);
+        if(ss.isAborted()) {
+            return 0;
+        }
+        if(maximizing ? score > best_score : score < best_score) {
+            best_score = score;
+            best_move = bbmove;
+        }
+        if(maximizing) {
+            alpha = std::max(alpha, score);
+        } else {
+            beta = std::min(beta, score);
+        }
+        if(alpha >= beta) {
+            break;
+        }
+        have_move = move_gen.next(bbmove);
+    }
+
+    ZobristValue result(-INFINITE_SCORE, INFINITE_SCORE, depth, best_move);
+    if(best_score > original_alpha) {
+        result.lower_bound = best_score;
+    }
+    if(best_score < original_beta) {
+        result.upper_bound = best_score;
+    }
+    setZobristValueBB(tt_hash, result);
+    move_out = best_move;
+    return best_score;
+}
+
+// Max^n with shallow pruning. parent_best is the best score the player who
+// moved into this position has found so far at the node above. Scores add up
+// to no more than MAXN_SCORE_SUM, so once the player here is sure of best,
+// that player can get no more than MAXN_SCORE_SUM - best here, and if that's
+// no better than parent_best, the rest of the moves can't matter. Pruning any
+// deeper than that isn't sound with more than two players. The table only
+// supplies a move to try first.
+void searchMaxnBB(MultiPositionBB position, int depth, int parent_best, int scores_out[MAX_PLAYERS], BitboardMove& move_out, SearchState& ss)
+{
+    ++ss.nodes_searched;
+    ++ss.stats.nodes[depth];
+    ss.checkBudget();
+    if(ss.isAborted()) {
+        return;
+    }
+    move_out = BitboardMove(BBMOVE_NONE, 0, 0);
+    if(depth == 0) {
+        evalMaxnBB(position, scores_out);
+        return;
+    }
+
+    Bitboard bb_empty = invertBitboard(occupiedMultiBB(position));
+    int mover = findMultiMoverBB(position, bb_empty);
+    if(mover < 0) {
+        finishMultiGameBB(position);
+        evalMaxnBB(position, scores_out);
+        return;
+    }
+    setMultiTurnBB(position, mover);
+    Bitboard bb_me = position.pieces[mover];
+
+    ZobristHash tt_hash = position.hash ^ ss.table_key;
+    ZobristValue zv = getZobristValueBB(tt_hash);
+    ++ss.stats.tt_probes[depth];
+    if(zv.depth >= 0) {
+        ++ss.stats.tt_hits[depth];
+    }
+    BitboardMove tt_move = probeMoveMultiBB(zv, bb_me, bb_empty);
+
+    int best_score = -1;
+    BitboardMove best_move(BBMOVE_NONE, 0, 0);
+    StagedMoveGenBB move_gen(bb_me, invertBitboard(bb_me | bb_empty), SQUARE_ORDER, JUMP_ORDER, tt_move);
+    BitboardMove bbmove = tt_move;
+    bool have_move = (tt_move.move_type != BBMOVE_NONE) || move_gen.next(bbmove);
+    while(have_move) {
+        MultiPositionBB child(position);
+        makeMoveMultiBB(bbmove, child);
+        int child_scores[MAX_PLAYERS];
+        BitboardMove child_move;
+        searchMaxnBB(child, depth - 1, best_score, child_scores, child_move, ss);
+        if(ss.isAborted()) {
+            return;
+        }
+        if(child_scores[mover] > best_score) {
+            best_score = child_scores[mover];
+            best_move = bbmove;
+            std::copy(child_scores, child_scores + MAX_PLAYERS, scores_out);
+        }
+        if(best_score >= MAXN_SCORE_SUM - parent_best) {
+            break;
+        }
+        have_move = move_gen.next(bbmove);
+    }
+
+    setZobristValueBB(tt_hash, ZobristValue(-INFINITE_SCORE, INFINITE_SCORE, depth, best_move));
+    move_out = best_move;
+}
+
+// The move in the table entry, if it's one bb_me can make; a collision can
+// leave any move there
+BitboardMove probeMoveMultiBB(const ZobristValue& zv, Bitboard bb_me, Bitboard bb_empty)
+{
+    BitboardMove bbmove = zv.best_move;
+    Bitboard square_bit = Bitboard(1) << bbmove.square;
+    if(zv.depth >= 0 && ((bbmove.move_type == BBMOVE_CLONE && (bb_empty & square_bit)
+                           && (BITBOARD_SURROUNDS[bbmove.square] & bb_me))
+                         || (bbmove.move_type == BBMOVE_JUMP && (bb_me & square_bit)
+                           && (BITBOARD_JUMPS[bbmove.square][bbmove.jump_type].dest_square & bb_empty))))
+    {
+        return bbmove;
+    }
+    return BitboardMove(BBMOVE_NONE, 0, 0);
+}
+
+// Root has won if nobody has as many pieces, and lost if somebody has more
+int scoreFinishedParanoidBB(const MultiPositionBB& position, int root)
+{
+    int num_pieces_root = countSetBits(position.pieces[root]);
+    int most_pieces_other = 0;
+    for(int player = 0; player < position.num_players; ++player) {
+        if(player != root) {
+            most_pieces_other = std::max(most_pieces_other, countSetBits(position.pieces[player]));
+        }
+    }
+    if(num_pieces_root > most_pieces_other) {
+        return WIN;
+    } else if(num_pieces_root < most_pieces_other) {
+        return LOSS;
+    }
+    return 0;
+}
+
+// Root's pieces less those of the strongest of the others, which with two
+// players is the usual count of pieces
+int evalParanoidBB(const MultiPositionBB& position, int root)
+{
+    int num_pieces_root = countSetBits(position.pieces[root]);
+    int most_pieces_other = 0;
+    int total_pieces = num_pieces_root;
+    for(int player = 0; player < position.num_players; ++player) {
+        if(player != root) {
+            int num_pieces = countSetBits(position.pieces[player]);
+            most_pieces_other = std::max(most_pieces_other, num_pieces);
+            total_pieces += num_pieces;
+        }
+    }
+    if(num_pieces_root == 0 || num_pieces_root == total_pieces || total_pieces == NUM_PLAYABLE_SQUARES) {
+        return scoreFinishedParanoidBB(position, root);
+    }
+    return num_pieces_root - most_pieces_other;
+}
+
+void evalMaxnBB(const MultiPositionBB& position, int scores_out[MAX_PLAYERS])
+{
+    int num_pieces[MAX_PLAYERS];
+    int total_pieces = 0;
+    for(int player = 0; player < MAX_PLAYERS; ++player) {
+        num_pieces[player] = countSetBits(position.pieces[player]);
+        total_pieces += num_pieces[player];
+    }
+    // The player to move always has a piece
+    for(int player = 0; player < MAX_PLAYERS; ++player) {
+        scores_out[player] = num_pieces[player] * MAXN_SCORE_SUM / total_pieces;
+    }
+}
+
+}
@@ -0,0 +1,161 @@
+#ifndef SPLOT_MULTIPLAYER_HPP
+#define SPLOT_MULTIPLAYER_HPP
+
+#include <cassert>
+#include <string>
+#include "Board.hpp"
+#include "moves.hpp"
+#include "bitboards.hpp"
+#include "zobrist.hpp"
+
+// Games of three or four players. The players take turns in order, player 1
+// first, and a player who can't move passes. A piece that lands next to other
+// players' pieces captures all of them, whoever they belong to. When the
+// player to move can't, and no more than one of the others can, the game is
+// over: as in the two-player game, the player who can still move fills every
+// empty square they can get to (see fillableSquares), and whoever has the most
+// pieces wins. With two players these are the usual rules.
+
+// How the search expects the other players to play. Paranoid search assumes
+// they're all out to get the player to move at the root, which makes it a game
+// of two sides, so alpha-beta works as usual. Max^n assumes each player makes
+// the most pieces they can for themselves; with more than two sides, only
+// shallow pruning is sound (see searchMaxnBB). Its scores are each player's
+// share of the pieces.
+enum MultiStrategy
+{
+    MULTI_PARANOID,
+    MULTI_MAXN,
+    NUM_MULTI_STRATEGIES
+};
+
+// As given to -strategy
+extern const char* const MULTI_STRATEGY_NAMES[NUM_MULTI_STRATEGIES];
+
+// Returns false if there's no such strategy
+bool findMultiStrategy(const std::string& name, MultiStrategy& strategy_out);
+
+// A position as a packed array of bitboards, one for each player, and whose
+// turn it is
+struct MultiPositionBB
+{
+    Bitboard pieces[MAX_PLAYERS];       // pieces[i] is player i + 1's; empty for players not in the game
+    int num_players;
+    int to_move;                        // 0 for player 1
+    ZobristHash hash;                   // See calcHashMultiBB
+};
+
+inline Bitboard occupiedMultiBB(const MultiPositionBB& position)
+{
+    return position.pieces[0] | position.pieces[1] | position.pieces[2] | position.pieces[3];
+}
+
+// Whose turn it is in position, once those who can't move have passed (0 for
+// player 1), or -1 if the game is over. Usually that's the player to move,
+// which takes one check.
+inline int findMultiMoverBB(const MultiPositionBB& position, Bitboard bb_empty)
+{
+    if(hasAnyMoveBB(position.pieces[position.to_move], bb_empty)) {
+        return position.to_move;
+    }
+    int mover = -1;
+    int player = position.to_move;
+    for(int i = 1; i < position.num_players; ++i) {
+        player = (player + 1 == position.num_players) ? 0 : player + 1;
+        if(hasAnyMoveBB(position.pieces[player], bb_empty)) {
+            if(mover >= 0) {
+                return mover;
+            }
+            mover = player;
+        }
+    }
+    return -1;
+}
+
+inline void setMultiTurnBB(MultiPositionBB& position, int player)
+{
+    position.hash ^= ZOBRIST_TURN_CODES[position.to_move] ^ ZOBRIST_TURN_CODES[player];
+    position.to_move = player;
+}
+
+// Plays bbmove for the player to move and passes the turn to the next player,
+// updating the hash as it goes
+inline void makeMoveMultiBB(BitboardMove bbmove, MultiPositionBB& position)
+{
+    int me = position.to_move;
+    const LookupTable<ZobristHash, NUM_SQUARES>& my_codes = ZOBRIST_MULTI_CODES[me];
+    Bitboard capture_radius;
+    ZobristHash hash = position.hash;
+    if(bbmove.move_type == BBMOVE_CLONE) {
+        position.pieces[me] |= Bitboard(1) << bbmove.square;
+        hash ^= my_codes[bbmove.square];
+        capture_radius = BITBOARD_SURROUNDS[bbmove.square];
+    } else {
+        assert(bbmove.move_type == BBMOVE_JUMP);
+        const BitboardJump& jump = BITBOARD_JUMPS[bbmove.square][bbmove.jump_type];
+        position.pieces[me] = (position.pieces[me] | jump.dest_square) & ~(Bitboard(1) << bbmove.square);
+        hash ^= my_codes[bbmove.square] ^ my_codes[lowestSetSquare(jump.dest_square)];
+        capture_radius = jump.capture_radius;
+    }
+    for(int player = 0; player < position.num_players; ++player) {
+        Bitboard captured = position.pieces[player] & capture_radius;
+        if(player == me || !captured) {
+            continue;
+        }
+        position.pieces[player] &= ~captured;
+        position.pieces[me] |= captured;
+        for(Bitboard bits = captured; bits; bits &= bits - 1) {
+            int square_num = lowestSetSquare(bits);
+            hash ^= ZOBRIST_MULTI_CODES[player][square_num] ^ my_codes[square_num];
+        }
+    }
+    int next = (me + 1 == position.num_players) ? 0 : me + 1;
+    position.hash = hash ^ ZOBRIST_TURN_CODES[me] ^ ZOBRIST_TURN_CODES[next];
+    position.to_move = next;
+}
+
+// Once the game is over, the one player who can still move, if any, fills
+// what they can of the board
+inline void finishMultiGameBB(MultiPositionBB& position)
+{
+    Bitboard bb_empty = invertBitboard(occupiedMultiBB(position));
+    for(int player = 0; player < position.num_players; ++player) {
+        if(hasAnyMoveBB(position.pieces[player], bb_empty)) {
+            position.pieces[player] |= fillableSquares(position.pieces[player], bb_empty);
+            return;
+        }
+    }
+}
+
+// The start position for num_players (2 to 4): one piece in each corner,
+// taken by the players in turn order going clockwise from a1, and with two
+// players the usual start (see initBoard). With three players the a7 corner
+// (on a 7x7 board) is left empty.
+void initMultiBoard(Board& board, int num_players);
+
+// to_move is the player whose turn it is. The board may have no pieces of
+// players beyond num_players.
+void convBoardToMultiBB(const Board& board, int num_players, Player to_move, MultiPositionBB& position);
+
+ZobristHash calcHashMultiBB(const MultiPositionBB& position);
+
+// The player who moves after player in board, passing over those who can't
+// move, or PLAYER_NONE if the game is over. Pass the last player to find who
+// moves first.
+Player nextMultiPlayer(const Board& board, int num_players, Player player);
+
+// When the game is over, fills the board as finishMultiGameBB does and
+// returns the winner, or PLAYER_NONE if two or more share the most pieces
+Player finishMultiGame(Board& board, int num_players);
+
+// Searches board, with player to move, to the depth of the search limits (see
+// setSearchLimits), deepening iteratively so that the time and node limits
+// can stop it; the piece counts are the evaluation, whatever the weights. Its
+// results share the transposition table, under keys of their own. One thread.
+// The score is the same as the two-player searches' (from player's side, and
+// WIN or LOSS once the game is decided) for paranoid search, and player's
+// expected share of the pieces, in thousandths, for max^n.
+int searchMultiBB(const Board& board, int num_players, Player player, MultiStrategy strategy, Move& move_out,
+                  long long& nodes_searched);
+
+#endif
@@ -0,0 +1,137 @@
+#include <cctype>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+
+#include "Board.hpp"
+#include "moves.hpp"
+#include "notation.hpp"
+
+using namespace std;
+
+namespace
+{
+
+bool parseSquare(const string& str, size_t pos, Coord& coord)
+{
+    if(str.size() < pos + 2) {
+        return false;
+    }
+    coord.x = tolower((unsigned char)str[pos]) - 'a';
+    coord.y = str[pos + 1] - '1';
+    return Board::isInRange(coord);
+}
+
+}
+
+string getStartFen()
+{
+    Board board;
+    initBoard(board);
+    swapPlayers(board);
+    string fen;
+    for(int y = BOARD_SIZE - 1; y >= 0; --y) {
+        int num_empty = 0;
+        for(int x = 0; x < BOARD_SIZE; ++x) {
+            char ch;
+            if(!Board::isPlayable(Coord(x, y))) {
+                ch = '-';
+            } else if(board(x, y) != EMPTY_SQUARE) {
+                ch = (board(x, y) == PLAYER1) ? 'x' : 'o';
+            } else {
+                ++num_empty;
+                continue;
+            }
+            if(num_empty > 0) {
+                fen += char('0' + num_empty);
+                num_empty = 0;
+            }
+            fen += ch;
+        }
+        if(num_empty > 0) {
+            fen += char('0' + num_empty);
+        }
+        fen += (y > 0) ? "/" : " x 0 1";
+    }
+    return fen;
+}
+
+string squareName(const Coord& coord)
+{
+    string name;
+    name += char('a' + coord.x);
+    name += char('1' + coord.y);
+    return name;
+}
+
+string moveName(const Move& move)
+{
+    if(abs(move.dst.x - move.src.x) <= 1 && abs(move.dst.y - move.src.y) <= 1) {
+        return squareName(move.dst);
+    }
+    return squareName(move.src) + squareName(move.dst);
+}
+
+bool parseMove(const Board& board, Player player, const string& str, Move& move)
+{
+    if(str.size() == 2) {
+        if(!parseSquare(str, 0, move.dst)) {
+            return false;
+        }
+        for(int y = move.dst.y - 1; y <= move.dst.y + 1; ++y) {
+            for(int x = move.dst.x - 1; x <= move.dst.x + 1; ++x) {
+                move.src = Coord(x, y);
+                if(Board::isInRange(move.src) && checkLegalMove(board, player, move)) {
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+    return str.size() == 4 && parseSquare(str, 0, move.src) && parseSquare(str, 2, move.dst)
+        && checkLegalMove(board, player, move);
+}
+
+bool parseFen(const string& fen, Board& board, Player& to_move)
+{
+    istringstream fields(fen);
+    string layout, side;
+    if(!(fields >> layout >> side)) {
+        return false;
+    }
+    int x = 0;
+    int y = BOARD_SIZE - 1;
+    for(char ch : layout) {
+        if(ch == '/') {
+            if(x != BOARD_SIZE || y == 0) {
+                return false;
+            }
+            x = 0;
+            --y;
+        } else if(ch >= '1' && ch <= '0' + BOARD_SIZE) {
+            for(int i = 0; i < ch - '0'; ++i) {
+                if(x >= BOARD_SIZE || !Board::isPlayable(Coord(x, y))) {
+                    return false;
+                }
+                board(x++, y) = EMPTY_SQUARE;
+            }
+        } else if(ch == 'x' || ch == 'o') {
+            if(x >= BOARD_SIZE || !Board::isPlayable(Coord(x, y))) {
+                return false;
+            }
+            board(x++, y) = (ch == 'x') ? PLAYER1 : PLAYER2;
+        } else if(ch == '-') {
+            if(x >= BOARD_SIZE || Board::isPlayable(Coord(x, y))) {
+                return false;
+            }
+            board(x++, y) = EMPTY_SQUARE;
+        } else {
+            return false;
+        }
+    }
+    if(x != BOARD_SIZE || y != 0 || (side != "x" && side != "o")) {
+        return false;
+    }
+    to_move = (side == "x") ? PLAYER1 : PLAYER2;
+    return true;
+}
@@ -0,0 +1,30 @@
+#ifndef SPLOT_NOTATION_HPP
+#define SPLOT_NOTATION_HPP
+
+#include <string>
+#include "Board.hpp"
+#include "moves.hpp"
+
+// Text forms of positions and moves, as used by the UAI protocol. Squares are
+// named as in the rest of the program: a1 is (0, 0).
+
+// Standard start position (x to move), for the board this program was built
+// for. In FEN rows run from the top rank down to rank 1; 'x' is player 1, 'o'
+// player 2 and '-' a blocked square.
+std::string getStartFen();
+
+std::string squareName(const Coord& coord);
+
+// A clone is written as just its destination, e.g. "b2"; a jump as source and
+// destination, e.g. "a1c3"
+std::string moveName(const Move& move);
+
+// Takes either form of a clone, since any neighbouring piece will do. Returns
+// false if the move isn't legal for player.
+bool parseMove(const Board& board, Player player, const std::string& str, Move& move);
+
+// The move counters are ignored. The blocked squares ('-') must be the ones
+// the program was built with (see SPLOT_BLOCKED_SQUARES).
+bool parseFen(const std::string& fen, Board& board, Player& to_move);
+
+#endif
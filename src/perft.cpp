@@ -0,0 +1,440 @@
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Board.hpp"
+#include "moves.hpp"
+#include "ai.hpp"
+#include "bitboards.hpp"
+#include "movegen_bb.hpp"
+#include "multiplayer.hpp"
+#include "bench.hpp"
+#include "perft.hpp"
+
+using namespace std;
+
+namespace
+{
+
+// Layouts are as for setupBoard
+const struct { const char* name; const char* layout; int num_players; Player player; } PERFT_POSITIONS[] = {
+    {"Start", "x.....o"
+              "......."
+              "......."
+              "......."
+              "......."
+              "......."
+              "o.....x", 2, PLAYER1},
+
+    {"Opening, after a1b2", "x.....o"
+                            ".x....."
+                            "......."
+                            "......."
+                            "......."
+                            "......."
+                            "o.....x", 2, PLAYER2},
+
+    {"Middlegame", "xxo...o"
+                   "xooo..."
+                   ".xx.o.."
+                   "..xx..."
+                   ".o.x.x."
+                   "oo...xx"
+                   "o....ox", 2, PLAYER1},
+
+    {"Nearly full", "xxxxooo"
+                    "xoxo.oo"
+                    "oxxoxxo"
+                    "ooxxxo."
+                    "xoooxxo"
+                    "xx.xooo"
+                    "oxxxxoo", 2, PLAYER2},
+
+    {"Three players, start", "x.....o"
+                             "......."
+                             "......."
+                             "......."
+                             "......."
+                             "......."
+                             "......3", 3, PLAYER1},
+
+    {"Three players, middlegame", "xx...oo"
+                                  "x3...o."
+                                  "..x...."
+                                  "...3o.."
+                                  "....3.."
+                                  "......3"
+                                  ".....33", 3, PLAYER2},
+
+    {"Four players, start", "x.....o"
+                            "......."
+                            "......."
+                            "......."
+                            "......."
+                            "......."
+                            "4.....3", 4, PLAYER1},
+
+    {"Four players, middlegame", "xx...oo"
+                                 "x.4..o."
+                                 "......."
+                                 "..x3o.."
+                                 "......."
+                                 "4...3.."
+                                 "44...33", 4, PLAYER3},
+
+    // Player 4 has no moves left and has to pass
+    {"Four players, nearly full", ".x.xoo3"
+                                  "xox3oo3"
+                                  "3.xxo33"
+                                  "oo3xxoo"
+                                  "x3o3ox3"
+                                  "oxo4444"
+                                  "3xx4444", 4, PLAYER3},
+};
+
+// Leaf counts under each root move, keyed by the move's name
+typedef map<string, long long> DivideResults;
+
+const vector<int>& identityOrder(int size)
+{
+    static const vector<int> square_order = [] {
+        vector<int> order(NUM_SQUARES);
+        for(int i = 0; i < NUM_SQUARES; ++i) {
+            order[i] = i;
+        }
+        return order;
+    }();
+    static const vector<int> jump_order = [] {
+        vector<int> order(NUM_JUMPS);
+        for(int i = 0; i < NUM_JUMPS; ++i) {
+            order[i] = i;
+        }
+        return order;
+    }();
+    assert(size == NUM_SQUARES || size == NUM_JUMPS);
+    return (size == NUM_SQUARES) ? square_order : jump_order;
+}
+
+Player otherPlayer(Player player)
+{
+    return (player == PLAYER1) ? PLAYER2 : PLAYER1;
+}
+
+// The rules of multiplayer.hpp, worked out from the Board: the next player
+// after player who can move, or PLAYER_NONE if the game is over
+Player nextPlayerBoard(const Board& board, int num_players, Player player)
+{
+    Player next = Player(player % num_players + PLAYER1);
+    if(hasLegalMove(board, next)) {
+        return next;
+    }
+    Player mover = PLAYER_NONE;
+    for(int i = 1; i < num_players; ++i) {
+        next = Player(next % num_players + PLAYER1);
+        if(hasLegalMove(board, next)) {
+            if(mover != PLAYER_NONE) {
+                return mover;
+            }
+            mover = next;
+        }
+    }
+    return PLAYER_NONE;
+}
+
+string squareName(int x, int y)
+{
+    return string(1, char('a' + x)) + char('1' + y);
+}
+
+// A clone is named by its destination alone, since it doesn't matter which
+// piece it came from; a jump by both squares
+string moveName(const Move& move)
+{
+    if(abs(move.dst.x - move.src.x) <= 1 && abs(move.dst.y - move.src.y) <= 1) {
+        return squareName(move.dst.x, move.dst.y);
+    }
+    return squareName(move.src.x, move.src.y) + squareName(move.dst.x, move.dst.y);
+}
+
+string moveNameBB(BitboardMove bbmove)
+{
+    int x = bbmove.square % BOARD_SIZE;
+    int y = bbmove.square / BOARD_SIZE;
+    if(bbmove.move_type == BBMOVE_CLONE) {
+        return squareName(x, y);
+    }
+    return squareName(x, y) + squareName(x + JUMP_COORDS[bbmove.jump_type].x, y + JUMP_COORDS[bbmove.jump_type].y);
+}
+
+// findAllPossibleMoves, keeping only the first clone into each square
+void findUniqueMoves(const Board& board, Player player, MoveList& moves)
+{
+    MoveList all_moves;
+    findAllPossibleMoves(board, player, all_moves);
+    bool cloned_into[BOARD_SIZE][BOARD_SIZE] = {};
+    for(const Move& move : all_moves) {
+        if(abs(move.dst.x - move.src.x) <= 1 && abs(move.dst.y - move.src.y) <= 1) {
+            if(cloned_into[move.dst.y][move.dst.x]) {
+                continue;
+            }
+            cloned_into[move.dst.y][move.dst.x] = true;
+        }
+        moves.push_back(move);
+    }
+}
+
+long long perftBoard(const Board& board, Player player, int depth)
+{
+    if(depth == 0) {
+        return 1;
+    }
+    MoveList moves;
+    findUniqueMoves(board, player, moves);
+    if(depth == 1) {
+        return moves.size();
+    }
+    long long nodes = 0;
+    for(const Move& move : moves) {
+        Board child(board);
+        makeMove(child, move);
+        nodes += perftBoard(child, otherPlayer(player), depth - 1);
+    }
+    return nodes;
+}
+
+// player must be able to move
+long long perftBoardMulti(const Board& board, int num_players, Player player, int depth)
+{
+    if(depth == 0) {
+        return 1;
+    }
+    MoveList moves;
+    findUniqueMoves(board, player, moves);
+    if(depth == 1) {
+        return moves.size();
+    }
+    long long nodes = 0;
+    for(const Move& move : moves) {
+        Board child(board);
+        makeMove(child, move);
+        Player next = nextPlayerBoard(child, num_players, player);
+        if(next != PLAYER_NONE) {
+            nodes += perftBoardMulti(child, num_players, next, depth - 1);
+        }
+    }
+    return nodes;
+}
+
+long long perftBB(Bitboard bb_me, Bitboard bb_him, int depth)
+{
+    if(depth == 0) {
+        return 1;
+    }
+    StagedMoveGenBB move_gen(bb_me, bb_him, identityOrder(NUM_SQUARES), identityOrder(NUM_JUMPS), BitboardMove(BBMOVE_NONE, 0, 0));
+    BitboardMove bbmove;
+    long long nodes = 0;
+    if(depth == 1) {
+        while(move_gen.next(bbmove)) {
+            ++nodes;
+        }
+        return nodes;
+    }
+    while(move_gen.next(bbmove)) {
+        Bitboard bb_me_after = bb_me;
+        Bitboard bb_him_after = bb_him;
+        makeMoveBB(bbmove, bb_me_after, bb_him_after);
+        nodes += perftBB(bb_him_after, bb_me_after, depth - 1);
+    }
+    return nodes;
+}
+
+// The player to move in position must be able to
+long long perftMultiBB(const MultiPositionBB& position, int depth)
+{
+    if(depth == 0) {
+        return 1;
+    }
+    Bitboard bb_me = position.pieces[position.to_move];
+    StagedMoveGenBB move_gen(bb_me, occupiedMultiBB(position) & ~bb_me, identityOrder(NUM_SQUARES), identityOrder(NUM_JUMPS),
+                             BitboardMove(BBMOVE_NONE, 0, 0));
+    BitboardMove bbmove;
+    long long nodes = 0;
+    if(depth == 1) {
+        while(move_gen.next(bbmove)) {
+            ++nodes;
+        }
+        return nodes;
+    }
+    while(move_gen.next(bbmove)) {
+        MultiPositionBB child(position);
+        makeMoveMultiBB(bbmove, child);
+        int mover = findMultiMoverBB(child, invertBitboard(occupiedMultiBB(child)));
+        if(mover >= 0) {
+            setMultiTurnBB(child, mover);
+            nodes += perftMultiBB(child, depth - 1);
+        }
+    }
+    return nodes;
+}
+
+// Counts the nodes under each root move, handing the root moves out to the
+// search threads as they become free. count_move(i) returns the count for root
+// move i.
+template<typename CountMoveFunc>
+vector<long long> divideAmongThreads(int num_moves, CountMoveFunc count_move)
+{
+    vector<long long> counts(num_moves);
+    atomic<int> next_move(0);
+    auto worker = [&]() {
+        for(int i = next_move++; i < num_moves; i = next_move++) {
+            counts[i] = count_move(i);
+        }
+    };
+    vector<thread> threads;
+    for(int i = 1; i < getNumSearchThreads(); ++i) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for(thread& t : threads) {
+        t.join();
+    }
+    return counts;
+}
+
+double divideBoard(const Board& board, int num_players, Player player, int depth, DivideResults& results)
+{
+    using namespace std::chrono;
+    steady_clock::time_point t1 = steady_clock::now();
+    MoveList moves;
+    findUniqueMoves(board, player, moves);
+    vector<long long> counts = divideAmongThreads(int(moves.size()), [&](int i) {
+        Board child(board);
+        makeMove(child, moves[i]);
+        if(num_players == 2) {
+            return perftBoard(child, otherPlayer(player), depth - 1);
+        }
+        Player next = nextPlayerBoard(child, num_players, player);
+        return (next == PLAYER_NONE) ? 0 : perftBoardMulti(child, num_players, next, depth - 1);
+    });
+    steady_clock::time_point t2 = steady_clock::now();
+    for(int i = 0; i < moves.size(); ++i) {
+        results[moveName(moves[i])] += counts[i];
+    }
+    return duration_cast<duration<double>>(t2 - t1).count();
+}
+
+// Two players get the two-bitboard generator, more get the packed one
+double divideBB(const Board& board, int num_players, Player player, int depth, DivideResults& results)
+{
+    using namespace std::chrono;
+    steady_clock::time_point t1 = steady_clock::now();
+    MultiPositionBB position;
+    convBoardToMultiBB(board, num_players, player, position);
+    Bitboard bb_me = position.pieces[position.to_move];
+    Bitboard bb_him = occupiedMultiBB(position) & ~bb_me;
+    vector<BitboardMove> moves;
+    StagedMoveGenBB move_gen(bb_me, bb_him, identityOrder(NUM_SQUARES), identityOrder(NUM_JUMPS), BitboardMove(BBMOVE_NONE, 0, 0));
+    BitboardMove bbmove;
+    while(move_gen.next(bbmove)) {
+        moves.push_back(bbmove);
+    }
+    vector<long long> counts = divideAmongThreads(int(moves.size()), [&](int i) {
+        if(num_players == 2) {
+            Bitboard bb_me_after = bb_me;
+            Bitboard bb_him_after = bb_him;
+            makeMoveBB(moves[i], bb_me_after, bb_him_after);
+            return perftBB(bb_him_after, bb_me_after, depth - 1);
+        }
+        MultiPositionBB child(position);
+        makeMoveMultiBB(moves[i], child);
+        int mover = findMultiMoverBB(child, invertBitboard(occupiedMultiBB(child)));
+        if(mover < 0) {
+            return 0LL;
+        }
+        setMultiTurnBB(child, mover);
+        return perftMultiBB(child, depth - 1);
+    });
+    steady_clock::time_point t2 = steady_clock::now();
+    for(size_t i = 0; i < moves.size(); ++i) {
+        results[moveNameBB(moves[i])] += counts[i];
+    }
+    return duration_cast<duration<double>>(t2 - t1).count();
+}
+
+long long totalNodes(const DivideResults& results)
+{
+    long long total = 0;
+    for(const auto& result : results) {
+        total += result.second;
+    }
+    return total;
+}
+
+}
+
+bool perft(const Board& board, Player player, int depth, int num_players)
+{
+    assert(depth > 0);
+    DivideResults board_results, bb_results;
+    double board_secs = divideBoard(board, num_players, player, depth, board_results);
+    double bb_secs = divideBB(board, num_players, player, depth, bb_results);
+
+    // Print every root move either generator came up with
+    DivideResults all_moves = board_results;
+    all_moves.insert(bb_results.begin(), bb_results.end());
+    bool match = true;
+    for(const auto& move : all_moves) {
+        long long board_count = board_results.count(move.first) ? board_results[move.first] : -1;
+        long long bb_count = bb_results.count(move.first) ? bb_results[move.first] : -1;
+        cout << "  " << left << setw(6) << move.first << right << setw(14) << bb_count;
+        if(board_count != bb_count) {
+            cout << "   MISMATCH: Board says " << board_count;
+            match = false;
+        }
+        cout << endl;
+    }
+
+    long long board_nodes = totalNodes(board_results);
+    long long bb_nodes = totalNodes(bb_results);
+    cout << "  Bitboard: " << bb_nodes << " nodes in " << fixed << setprecision(3) << bb_secs << "s";
+    if(bb_secs > 0) {
+        cout << " (" << (long long)(bb_nodes / bb_secs) << " nodes/sec)";
+    }
+    cout << endl << "  Board:    " << board_nodes << " nodes in " << board_secs << "s";
+    if(board_secs > 0) {
+        cout << " (" << (long long)(board_nodes / board_secs) << " nodes/sec)";
+    }
+    cout << defaultfloat << endl;
+    if(!match || board_nodes != bb_nodes) {
+        cout << "  MOVE GENERATORS DISAGREE" << endl;
+        return false;
+    }
+    return true;
+}
+
+bool perftSuite(int depth)
+{
+    bool all_match = true;
+    for(const auto& position : PERFT_POSITIONS) {
+        Board board;
+        if(!setupBoard(board, position.layout)) {
+            cout << position.name << ": doesn't fit this board, skipped" << endl << endl;
+            continue;
+        }
+        cout << position.name << ", player " << position.player - PLAYER1 + 1
+             << " to move, depth " << depth << ", " << getNumSearchThreads() << " thread(s)" << endl;
+        if(!perft(board, position.player, depth, position.num_players)) {
+            all_match = false;
+        }
+        cout << endl;
+    }
+    cout << (all_match ? "All positions agree" : "MISMATCHES FOUND") << endl;
+    return all_match;
+}
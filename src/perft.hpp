@@ -0,0 +1,24 @@
+#ifndef SPLOT_PERFT_HPP
+#define SPLOT_PERFT_HPP
+
+#include "Board.hpp"
+
+// Counts the leaf nodes of the game tree to the given depth, once with the
+// Board-based move generator (findAllPossibleMoves/makeMove) and once with the
+// bitboard one (StagedMoveGenBB/makeMoveBB), and prints the count under each
+// root move ("divide") along with nodes/sec for both. The root moves are split
+// among the search threads (see setNumSearchThreads).
+// A clone can come from any of the pieces next to its destination, but it's
+// only one move; the Board-based moves are deduplicated to match.
+// A player with no moves ends the game, as in the search. With more than two
+// players, the bitboard generator works on the packed bitboards of
+// multiplayer.hpp, and players with no moves pass as its rules say; a pass
+// isn't a move, so it doesn't take up a ply.
+// Returns false if the two generators disagree anywhere.
+bool perft(const Board& board, Player player, int depth, int num_players=2);
+
+// Runs perft on a fixed set of positions, skipping those that don't fit the
+// board (see setupBoard). Returns false on any mismatch.
+bool perftSuite(int depth);
+
+#endif
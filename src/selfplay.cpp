@@ -0,0 +1,396 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Board.hpp"
+#include "moves.hpp"
+#include "ai.hpp"
+#include "bitboards.hpp"
+#include "zobrist.hpp"
+#include "selfplay.hpp"
+
+using namespace std;
+
+extern thread_local mt19937 g_rng;
+
+namespace
+{
+
+const struct { const char* name; AiFuncPtr ai; } MATCH_AIS[] = {
+    {"random", random_move},
+    {"negamax", negamax_bb},
+    {"iterative", negamax_iterative_bb},
+    {"mtdf", mtdf_bb},
+    {"pvs", pvs_bb}
+};
+
+// Openings are this many random moves from the start position. The same seed
+// gives the same openings every time, so matches can be compared.
+const int MATCH_OPENING_PLIES = 4;
+const unsigned MATCH_OPENING_SEED = 1;
+
+// Jumps can go back and forth forever; a game that gets this long is scored
+// on the pieces each side has
+const int MATCH_MAX_PLIES = 400;
+
+// The SPRT isn't consulted until this many pairs are in, so a lucky start
+// can't end the match
+const int SPRT_MIN_PAIRS = 10;
+
+// Added to the count of each kind of pair when working out the statistics.
+// Without it, a match where every pair has come out the same (say, 2-0) has no
+// variance, and the SPRT could never decide.
+const double PAIR_PRIOR = 1e-3;
+
+// Print the standings every this many pairs
+const int MATCH_REPORT_INTERVAL = 20;
+
+// Each player's table key (see setSearchTableKey)
+const ZobristHash MATCH_TABLE_KEYS[2] = {0x9e3779b97f4a7c15ULL, 0xc2b2ae3d27d4eb4fULL};
+
+struct Opening
+{
+    Board board;
+    Player to_move;
+};
+
+// Totals for one player over the whole match
+struct SideStats
+{
+    long long nodes = 0;
+    double secs = 0;
+};
+
+struct MatchResults
+{
+    int wins = 0;                   // Games, from the first player's point of view
+    int draws = 0;
+    int losses = 0;
+    int pairs[5] = {};              // Pairs by the first player's points in them: 0, 1/2, 1, 3/2, 2
+    SideStats sides[2];
+};
+
+void makeOpenings(int count, vector<Opening>& openings)
+{
+    mt19937 rng(MATCH_OPENING_SEED);
+    set<string> seen;
+    int attempts = 0;
+    while(int(openings.size()) < count) {
+        Opening opening;
+        initBoard(opening.board);
+        opening.to_move = PLAYER1;
+        bool playable = true;
+        for(int ply = 0; ply < MATCH_OPENING_PLIES && playable; ++ply) {
+            MoveList moves;
+            findAllPossibleMoves(opening.board, opening.to_move, moves);
+            playable = !moves.empty();
+            if(playable) {
+                makeMove(opening.board, moves[rng() % moves.size()]);
+                opening.to_move = getOpponent(opening.to_move);
+            }
+        }
+        if(!playable || !hasLegalMove(opening.board, opening.to_move)) {
+            continue;
+        }
+        // Don't play an opening twice, unless we've run out of them
+        string key(1, char(opening.to_move));
+        for(int y = 0; y < BOARD_SIZE; ++y) {
+            for(int x = 0; x < BOARD_SIZE; ++x) {
+                key += char(opening.board(x, y));
+            }
+        }
+        if(seen.insert(key).second || ++attempts > 100 * count) {
+            openings.push_back(opening);
+        }
+    }
+}
+
+// players[0] plays player 1. Returns player 1's points: 1 for a win, 1/2 for
+// a draw, 0 for a loss.
+double playGame(const Opening& opening, const MatchPlayer* players[2], const ZobristHash keys[2], SideStats stats[2])
+{
+    using namespace std::chrono;
+
+    std::vector<int> square_order(NUM_SQUARES);
+    std::vector<int> jump_order(NUM_JUMPS);
+    for(int i = 0; i < NUM_SQUARES; ++i) {
+        square_order[i] = i;
+    }
+    for(int i = 0; i < NUM_JUMPS; ++i) {
+        jump_order[i] = i;
+    }
+
+    Board board(opening.board);
+    Player to_move = opening.to_move;
+    SearchLimits limits[2] = {players[0]->limits, players[1]->limits};
+    for(int ply = 0; ply < MATCH_MAX_PLIES; ++ply) {
+        if(!hasLegalMove(board, to_move)) {
+            // As in the search, the other player gets the rest of the board
+            Bitboard bb_player1, bb_player2;
+            convBoardToBitboards(board, bb_player1, bb_player2);
+            Bitboard bb_empty = invertBitboard(bb_player1 | bb_player2);
+            if(to_move == PLAYER1) {
+                bb_player2 |= fillableSquares(bb_player2, bb_empty);
+            } else {
+                bb_player1 |= fillableSquares(bb_player1, bb_empty);
+            }
+            convBitboardsToBoard(bb_player1, bb_player2, board);
+            break;
+        }
+
+        int side = (to_move == PLAYER1) ? 0 : 1;
+        setSearchConfig(*players[side]->config);
+        setSearchLimits(limits[side]);
+        setSearchTableKey(keys[side]);
+        newZobristGeneration();
+        Board search_board(board);
+        if(to_move == PLAYER1) {
+            swapPlayers(search_board);
+        }
+        Move move;
+        long long nodes_searched = 0;
+        steady_clock::time_point t1 = steady_clock::now();
+        players[side]->ai(search_board, square_order, jump_order, move, nodes_searched);
+        steady_clock::time_point t2 = steady_clock::now();
+        stats[side].nodes += nodes_searched;
+        stats[side].secs += duration_cast<duration<double>>(t2 - t1).count();
+        if(limits[side].move_time_ms == 0 && limits[side].clock_ms > 0) {
+            int elapsed_ms = int(duration_cast<milliseconds>(t2 - t1).count());
+            limits[side].clock_ms = max(1, limits[side].clock_ms - elapsed_ms) + limits[side].increment_ms;
+        }
+
+        makeMove(board, move);
+        to_move = getOpponent(to_move);
+    }
+
+    int p1_num_pieces = board.countPieces(PLAYER1);
+    int p2_num_pieces = board.countPieces(PLAYER2);
+    if(p1_num_pieces > p2_num_pieces) {
+        return 1;
+    } else if(p1_num_pieces < p2_num_pieces) {
+        return 0;
+    }
+    return 0.5;
+}
+
+double eloToScore(double elo)
+{
+    return 1 / (1 + pow(10, -elo / 400));
+}
+
+double scoreToElo(double score)
+{
+    return -400 * log10(1 / score - 1);
+}
+
+// Mean and variance of the first player's score per game, taken pair by pair
+// (the two games of a pair aren't independent, since they share an opening)
+int pairStats(const MatchResults& results, double& mean, double& variance)
+{
+    int num_pairs = 0;
+    double total = 0;
+    double sum = 0;
+    for(int i = 0; i < 5; ++i) {
+        num_pairs += results.pairs[i];
+        total += results.pairs[i] + PAIR_PRIOR;
+        sum += (results.pairs[i] + PAIR_PRIOR) * i / 4.0;
+    }
+    mean = sum / total;
+    variance = 0;
+    for(int i = 0; i < 5; ++i) {
+        variance += (results.pairs[i] + PAIR_PRIOR) * (i / 4.0 - mean) * (i / 4.0 - mean);
+    }
+    variance /= total;
+    return num_pairs;
+}
+
+// Log-likelihood ratio of H1 to H0, using the normal approximation to the
+// distribution of pair scores
+double calcLlr(const MatchResults& results, const MatchSettings& settings)
+{
+    double mean, variance;
+    int num_pairs = pairStats(results, mean, variance);
+    if(num_pairs == 0) {
+        return 0;
+    }
+    double s0 = eloToScore(settings.elo0);
+    double s1 = eloToScore(settings.elo1);
+    return num_pairs * (s1 - s0) * (2 * mean - s0 - s1) / (2 * variance);
+}
+
+string formatElo(double score)
+{
+    if(score <= 0) {
+        return "-inf";
+    } else if(score >= 1) {
+        return "+inf";
+    }
+    ostringstream out;
+    out << fixed << setprecision(1) << showpos << scoreToElo(score);
+    return out.str();
+}
+
+void printStandings(const MatchResults& results, double llr, double lower_bound, double upper_bound)
+{
+    double mean, variance;
+    int num_pairs = pairStats(results, mean, variance);
+    // 95% confidence
+    double margin = 1.96 * sqrt(variance / max(1, num_pairs));
+    streamsize precision = cout.precision();
+    cout << "Games " << 2 * num_pairs << ": +" << results.wins << " =" << results.draws << " -" << results.losses
+         << "  Elo " << formatElo(mean) << " [" << formatElo(mean - margin) << ", " << formatElo(mean + margin) << "]"
+         << "  LLR " << fixed << setprecision(2) << llr << " [" << lower_bound << ", " << upper_bound << "]"
+         << defaultfloat << setprecision(precision) << endl;
+}
+
+}
+
+bool parseMatchPlayer(const std::string& spec, const SearchLimits& base_limits, MatchPlayer& player)
+{
+    string ai_name = spec;
+    string config_name;
+    string eval_filename;
+    int depth = 0;
+    size_t equals = ai_name.find('=');
+    if(equals != string::npos) {
+        eval_filename = ai_name.substr(equals + 1);
+        ai_name.erase(equals);
+    }
+    size_t at = ai_name.find('@');
+    if(at != string::npos) {
+        depth = atoi(ai_name.c_str() + at + 1);
+        if(depth < 1 || depth > MAX_SEARCH_DEPTH) {
+            return false;
+        }
+        ai_name.erase(at);
+    }
+    size_t colon = ai_name.find(':');
+    if(colon != string::npos) {
+        config_name = ai_name.substr(colon + 1);
+        ai_name.erase(colon);
+    }
+
+    player.name = spec;
+    player.ai = nullptr;
+    for(const auto& match_ai : MATCH_AIS) {
+        if(ai_name == match_ai.name) {
+            player.ai = match_ai.ai;
+        }
+    }
+    player.config = config_name.empty() ? &getSearchConfig() : findSearchConfig(config_name);
+    player.limits = base_limits;
+    if(depth > 0) {
+        player.limits.depth = depth;
+    }
+    if(!eval_filename.empty() && !loadEvalWeights(eval_filename.c_str(), player.limits.eval_weights)) {
+        return false;
+    }
+    return player.ai && player.config;
+}
+
+void runMatch(const MatchPlayer& a, const MatchPlayer& b, const MatchSettings& settings)
+{
+    int num_pairs = max(1, settings.max_games / 2);
+    int concurrency = settings.concurrency;
+    if(concurrency <= 0) {
+        concurrency = max(1, int(thread::hardware_concurrency()));
+    }
+    concurrency = min(concurrency, num_pairs);
+    double lower_bound = log(settings.beta / (1 - settings.alpha));
+    double upper_bound = log((1 - settings.beta) / settings.alpha);
+
+    cout << a.name << " vs " << b.name << ": up to " << 2 * num_pairs << " games, " << concurrency << " at a time" << endl;
+    cout << "SPRT: Elo " << settings.elo0 << " vs " << settings.elo1 << ", alpha " << settings.alpha
+         << ", beta " << settings.beta << endl << endl;
+
+    vector<Opening> openings;
+    makeOpenings(num_pairs, openings);
+
+    MatchResults results;
+    mutex results_mutex;
+    atomic<int> next_pair(0);
+    atomic<bool> decided(false);
+    double llr = 0;
+    vector<thread> workers;
+    for(int i = 0; i < concurrency; ++i) {
+        workers.emplace_back([&]() {
+            g_rng.seed(random_device()());
+            while(!decided) {
+                int pair_num = next_pair++;
+                if(pair_num >= num_pairs) {
+                    break;
+                }
+                SideStats stats[2];
+                const MatchPlayer* a_first[2] = {&a, &b};
+                const ZobristHash a_first_keys[2] = {MATCH_TABLE_KEYS[0], MATCH_TABLE_KEYS[1]};
+                double a_points[2];
+                a_points[0] = playGame(openings[pair_num], a_first, a_first_keys, stats);
+                // Same opening, sides switched
+                SideStats switched_stats[2];
+                const MatchPlayer* b_first[2] = {&b, &a};
+                const ZobristHash b_first_keys[2] = {MATCH_TABLE_KEYS[1], MATCH_TABLE_KEYS[0]};
+                a_points[1] = 1 - playGame(openings[pair_num], b_first, b_first_keys, switched_stats);
+
+                lock_guard<mutex> lock(results_mutex);
+                for(double points : a_points) {
+                    if(points == 1) {
+                        ++results.wins;
+                    } else if(points == 0) {
+                        ++results.losses;
+                    } else {
+                        ++results.draws;
+                    }
+                }
+                ++results.pairs[int(2 * (a_points[0] + a_points[1]))];
+                results.sides[0].nodes += stats[0].nodes + switched_stats[1].nodes;
+                results.sides[0].secs += stats[0].secs + switched_stats[1].secs;
+                results.sides[1].nodes += stats[1].nodes + switched_stats[0].nodes;
+                results.sides[1].secs += stats[1].secs + switched_stats[0].secs;
+
+                // Pairs still being played when the SPRT decides are counted,
+                // but don't reopen the decision
+                int pairs_done = (results.wins + results.draws + results.losses) / 2;
+                if(!decided) {
+                    llr = calcLlr(results, settings);
+                    decided = pairs_done >= SPRT_MIN_PAIRS && (llr <= lower_bound || llr >= upper_bound);
+                }
+                if(pairs_done % MATCH_REPORT_INTERVAL == 0) {
+                    printStandings(results, llr, lower_bound, upper_bound);
+                }
+            }
+        });
+    }
+    for(thread& worker : workers) {
+        worker.join();
+    }
+
+    cout << endl;
+    printStandings(results, llr, lower_bound, upper_bound);
+    if(llr >= upper_bound) {
+        cout << "SPRT: H1 accepted; " << a.name << " is stronger by at least " << settings.elo1 << " Elo" << endl;
+    } else if(llr <= lower_bound) {
+        cout << "SPRT: H0 accepted; " << a.name << " is stronger by no more than " << settings.elo0 << " Elo" << endl;
+    } else {
+        cout << "SPRT: inconclusive" << endl;
+    }
+    const MatchPlayer* players[2] = {&a, &b};
+    for(int side = 0; side < 2; ++side) {
+        const SideStats& stats = results.sides[side];
+        cout << players[side]->name << ": " << stats.nodes << " nodes in " << stats.secs << " seconds of search";
+        if(stats.secs > 0) {
+            cout << " (" << (long long)(stats.nodes / stats.secs) << " nodes/sec per game)";
+        }
+        cout << endl;
+    }
+}
@@ -0,0 +1,46 @@
+#ifndef SPLOT_SELFPLAY_HPP
+#define SPLOT_SELFPLAY_HPP
+
+#include <string>
+#include "ai.hpp"
+
+// One side of a match: an AI and the settings it searches with
+struct MatchPlayer
+{
+    std::string name;
+    AiFuncPtr ai;
+    const SearchConfig* config;
+    SearchLimits limits;
+};
+
+struct MatchSettings
+{
+    int max_games = 1000;
+    int concurrency = 0;            // Games played at once; 0 means one per core
+
+    // SPRT: H0 is that the first player is elo0 stronger than the second, H1
+    // that it's elo1 stronger. alpha and beta are the chances of accepting H1
+    // when H0 is true and vice versa.
+    double elo0 = 0;
+    double elo1 = 10;
+    double alpha = 0.05;
+    double beta = 0.05;
+};
+
+// Reads a player given as AI[:CONFIG][@DEPTH][=EVAL], e.g. "mtdf:nullmove@6".
+// AI is random, negamax, iterative, mtdf or pvs; CONFIG is a name from
+// SEARCH_CONFIGS (default: the current config); EVAL is a weights file (see
+// loadEvalWeights). The player searches with base_limits, but with DEPTH and
+// EVAL if they're given. Returns false if spec doesn't make sense.
+bool parseMatchPlayer(const std::string& spec, const SearchLimits& base_limits, MatchPlayer& player);
+
+// Plays a and b against each other and prints the result: Elo with its 95%
+// error bars and each side's nodes/sec. Games come in pairs from the same
+// random opening, with each player taking each side once, and run
+// concurrently, each on its own thread with a single search thread (so
+// -threads doesn't apply). The match stops early once the SPRT accepts either
+// hypothesis. Both players share the transposition table, but under different
+// keys (see setSearchTableKey), so neither benefits from the other's searches.
+void runMatch(const MatchPlayer& a, const MatchPlayer& b, const MatchSettings& settings);
+
+#endif
@@ -0,0 +1,260 @@
+#include <algorithm>
+#include <cassert>
+#include <vector>
+
+#include "moves.hpp"
+#include "ai.hpp"
+#include "bitboards.hpp"
+#include "solver.hpp"
+
+namespace
+{
+
+// Above any margin
+const int SOLVER_INFINITY = NUM_SQUARES + 1;
+
+// The solver's table is only worth probing this far from the end; nearer the
+// leaves, searching is cheaper than a cache miss
+const int SOLVER_TT_MIN_EMPTIES = 3;
+
+// Ordering moves by the opponent's mobility costs a move generation per move,
+// which only pays off this far from the end
+const int FASTEST_FIRST_MIN_EMPTIES = 5;
+
+const int SOLVER_TABLE_BITS = 16;
+const unsigned char NO_SOURCE = 0xff;
+
+// The position is stored whole, so there are no false hits. How many jumps
+// led up to it counts as part of the position, since the same pieces can
+// score differently when the run of jumps is nearer its end.
+struct SolverEntry
+{
+    Bitboard me;
+    Bitboard him;
+    signed char lower_bound;
+    signed char upper_bound;
+    unsigned char source;           // Of the best move: NO_SOURCE for a clone
+    unsigned char dest;
+    unsigned char jumps_in_row;
+};
+
+// A clone if source is NO_SOURCE
+struct SolverMove
+{
+    unsigned char source;
+    unsigned char dest;
+    int sort_key;                   // Lower goes first
+};
+
+// Per thread, like the rest of the search's settings; cleared for each solve
+thread_local std::vector<SolverEntry> g_solver_table;
+
+inline SolverEntry& getSolverEntry(Bitboard bb_me, Bitboard bb_him, int jumps_in_row)
+{
+    Bitboard mixed = (bb_me * 0x9e3779b97f4a7c15ULL) ^ (bb_him * 0xc2b2ae3d27d4eb4fULL) ^ (Bitboard(jumps_in_row) * 0x165667b19e3779f9ULL);
+    return g_solver_table[mixed >> (64 - SOLVER_TABLE_BITS)];
+}
+
+inline void makeSolverMove(const SolverMove& move, Bitboard& bb_me, Bitboard& bb_him)
+{
+    Bitboard captured = BITBOARD_SURROUNDS[move.dest] & bb_him;
+    bb_me |= (Bitboard(1) << move.dest) | captured;
+    bb_him ^= captured;
+    if(move.source != NO_SOURCE) {
+        bb_me ^= Bitboard(1) << move.source;
+    }
+}
+
+// Every move: the clones, one for each square, then the jumps
+int generateSolverMoves(Bitboard bb_me, Bitboard bb_empty, SolverMove* moves)
+{
+    int num_moves = 0;
+    for(Bitboard targets = cloneTargets(bb_me, bb_empty); targets; targets &= targets - 1) {
+        moves[num_moves].source = NO_SOURCE;
+        moves[num_moves].dest = (unsigned char)lowestSetSquare(targets);
+        moves[num_moves].sort_key = 0;
+        ++num_moves;
+    }
+    for(Bitboard targets = moveTargets(bb_me, bb_empty); targets; targets &= targets - 1) {
+        int dest = lowestSetSquare(targets);
+        for(Bitboard sources = BITBOARD_JUMP_TARGETS[dest] & bb_me; sources; sources &= sources - 1) {
+            moves[num_moves].source = (unsigned char)lowestSetSquare(sources);
+            moves[num_moves].dest = (unsigned char)dest;
+            moves[num_moves].sort_key = 0;
+            ++num_moves;
+        }
+    }
+    return num_moves;
+}
+
+// Fastest first: the replies that leave the opponent the fewest squares to
+// move to are likeliest to be best, and have the smallest subtrees
+void orderByMobility(Bitboard bb_me, Bitboard bb_him, SolverMove* moves, int num_moves)
+{
+    for(int i = 0; i < num_moves; ++i) {
+        Bitboard bb_me_after = bb_me;
+        Bitboard bb_him_after = bb_him;
+        makeSolverMove(moves[i], bb_me_after, bb_him_after);
+        Bitboard bb_empty_after = invertBitboard(bb_me_after | bb_him_after);
+        moves[i].sort_key = countSetBits(moveTargets(bb_him_after, bb_empty_after));
+    }
+    std::stable_sort(moves, moves + num_moves, [](const SolverMove& a, const SolverMove& b) {
+        return a.sort_key < b.sort_key;
+    });
+}
+
+// Fail-soft alpha-beta on the final margin. jumps_in_row counts the plies
+// since the last clone. best_move_out is only given at the root.
+int solve(Bitboard bb_me, Bitboard bb_him, int alpha, int beta, int jumps_in_row, SearchState& ss, SolverMove* best_move_out)
+{
+    ++ss.nodes_searched;
+    ++ss.stats.solver_nodes;
+    ss.checkBudget();
+    if(ss.isAborted()) {
+        return 0;
+    }
+
+    Bitboard bb_empty = invertBitboard(bb_me | bb_him);
+    if(!hasAnyMoveBB(bb_me, bb_empty)) {
+        // The opponent gets the rest of the board
+        return finalMarginBB(bb_me, bb_him, bb_empty);
+    }
+    if(jumps_in_row == SOLVER_JUMP_LIMIT) {
+        // Over (see solver.hpp)
+        return countSetBits(bb_me) - countSetBits(bb_him);
+    }
+
+    int num_empty = countSetBits(bb_empty);
+    SolverEntry* entry = nullptr;
+    SolverMove tt_move = {NO_SOURCE, 0, 0};
+    bool have_tt_move = false;
+    if(num_empty >= SOLVER_TT_MIN_EMPTIES) {
+        entry = &getSolverEntry(bb_me, bb_him, jumps_in_row);
+        if(entry->me == bb_me && entry->him == bb_him && entry->jumps_in_row == jumps_in_row) {
+            // The root has to search its moves to know which is best
+            if(!best_move_out) {
+                if(entry->lower_bound >= beta) {
+                    return entry->lower_bound;
+                } else if(entry->upper_bound <= alpha) {
+                    return entry->upper_bound;
+                }
+                alpha = std::max(alpha, int(entry->lower_bound));
+                beta = std::min(beta, int(entry->upper_bound));
+            }
+            tt_move.source = entry->source;
+            tt_move.dest = entry->dest;
+            have_tt_move = true;
+        }
+    }
+
+    SolverMove moves[MAX_SOLVER_EMPTIES * (1 + NUM_JUMPS)];
+    int num_moves = generateSolverMoves(bb_me, bb_empty, moves);
+    if(num_empty >= FASTEST_FIRST_MIN_EMPTIES) {
+        orderByMobility(bb_me, bb_him, moves, num_moves);
+    }
+    if(have_tt_move) {
+        for(int i = 0; i < num_moves; ++i) {
+            if(moves[i].source == tt_move.source && moves[i].dest == tt_move.dest) {
+                std::rotate(moves, moves + i, moves + i + 1);
+                break;
+            }
+        }
+    }
+
+    int original_alpha = alpha;
+    int best_score = -SOLVER_INFINITY;
+    SolverMove best_move = moves[0];
+    for(int i = 0; i < num_moves; ++i) {
+        Bitboard bb_me_after = bb_me;
+        Bitboard bb_him_after = bb_him;
+        makeSolverMove(moves[i], bb_me_after, bb_him_after);
+        int jumps_after = (moves[i].source == NO_SOURCE) ? 0 : jumps_in_row + 1;
+        int score = -solve(bb_him_after, bb_me_after, -beta, -alpha, jumps_after, ss, nullptr);
+        if(ss.isAborted()) {
+            return 0;
+        }
+        if(score > best_score) {
+            best_score = score;
+            best_move = moves[i];
+            if(score > alpha) {
+                alpha = score;
+                if(score >= beta) {
+                    break;
+                }
+            }
+        }
+    }
+
+    if(entry) {
+        entry->me = bb_me;
+        entry->him = bb_him;
+        entry->lower_bound = (signed char)(best_score > original_alpha ? best_score : -SOLVER_INFINITY);
+        entry->upper_bound = (signed char)(best_score < beta ? best_score : SOLVER_INFINITY);
+        entry->jumps_in_row = (unsigned char)jumps_in_row;
+        entry->source = best_move.source;
+        entry->dest = best_move.dest;
+    }
+    if(best_move_out) {
+        *best_move_out = best_move;
+    }
+    return best_score;
+}
+
+BitboardMove convSolverMove(const SolverMove& move)
+{
+    if(move.source == NO_SOURCE) {
+        return BitboardMove(BBMOVE_CLONE, move.dest, 0);
+    }
+    for(int jump_num = 0; jump_num < NUM_JUMPS; ++jump_num) {
+        if(BITBOARD_JUMPS[move.source][jump_num].dest_square == (Bitboard(1) << move.dest)) {
+            return BitboardMove(BBMOVE_JUMP, move.source, jump_num);
+        }
+    }
+    assert(false);
+    return BitboardMove(BBMOVE_NONE, 0, 0);
+}
+
+}
+
+bool solveEndgameBB(Bitboard bb_me, Bitboard bb_him, bool exact_margin, BitboardMove& move_out, int& margin, SearchState& ss)
+{
+    Bitboard bb_empty = invertBitboard(bb_me | bb_him);
+    int num_empty = countSetBits(bb_empty);
+    assert(num_empty <= MAX_SOLVER_EMPTIES);
+    move_out = BitboardMove(BBMOVE_NONE, 0, 0);
+    if(!hasAnyMoveBB(bb_me, bb_empty)) {
+        margin = finalMarginBB(bb_me, bb_him, bb_empty);
+        return true;
+    }
+
+    g_solver_table.assign(size_t(1) << SOLVER_TABLE_BITS, SolverEntry());
+
+    // A narrow window around 0 tells a win from a draw or a loss first. That's
+    // much cheaper than the margin, and it fills the table for finding the
+    // margin, which is then narrowed down with more null windows, each
+    // halving the range it can be in.
+    SolverMove best_move;
+    int score = solve(bb_me, bb_him, -1, 1, 0, ss, &best_move);
+    if(exact_margin && score != 0) {
+        int lower = (score > 0) ? score : -SOLVER_INFINITY;
+        int upper = (score > 0) ? SOLVER_INFINITY : score;
+        while(lower < upper && !ss.isAborted()) {
+            int test = lower + (upper - lower + 1) / 2;
+            SolverMove move;
+            int result = solve(bb_me, bb_him, test - 1, test, 0, ss, &move);
+            if(result >= test) {
+                lower = result;
+                best_move = move;
+            } else {
+                upper = result;
+            }
+        }
+        score = lower;
+    }
+    if(ss.isAborted()) {
+        return false;
+    }
+    margin = exact_margin ? score : (score > 0) - (score < 0);
+    move_out = convSolverMove(best_move);
+    return true;
+}
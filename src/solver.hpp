@@ -0,0 +1,45 @@
+#ifndef SPLOT_SOLVER_HPP
+#define SPLOT_SOLVER_HPP
+
+#include "moves.hpp"
+#include "bitboards.hpp"
+#include "ai.hpp"
+
+// Endgame solver. Once few enough squares are empty, the game can be played out
+// to the end instead of stopping at a depth and guessing with evalPositionBB.
+// The solver only knows final margins: how many more pieces the player to move
+// ends up with than the opponent, once the board is full or a player is stuck
+// (the opponent then gets every empty square they can reach, as in the search;
+// see fillableSquares).
+// Moves are found from the empty squares rather than the pieces, and the
+// solver has a small transposition table of its own, per thread, so it leaves
+// the main one alone.
+
+// Every move is searched, jumps included. A jump doesn't bring the end any
+// closer, and nothing in the rules says what a game that's jumped around
+// forever is worth, so the solver adds a rule of its own, like chess's
+// fifty-move rule: a line that goes SOLVER_JUMP_LIMIT plies without a clone
+// ends there, and the pieces on the board are counted, leaving the empty
+// squares to nobody. Every line then ends, and so does every solve, with a
+// margin that's exact under that rule. It only depends on the position and
+// how many jumps led up to it, which keeps the table exact too. Repeated
+// positions need no rule of their own: a position can only come round again
+// in a run of jumps, which the limit ends. The count starts at 0 at the root.
+
+// Up to this many empty squares: the most benchEndgameSolver finds it can
+// solve in seconds rather than minutes. The solver's move lists are sized for it.
+const int MAX_SOLVER_EMPTIES = 5;
+
+// Long enough for both sides to jump twice, say out of the way and back
+// again. It should be even, so that a run ends after the side that started it
+// has been answered; odd limits are much slower to solve.
+const int SOLVER_JUMP_LIMIT = 4;
+
+// bb_me is to move. Finds the exact margin if exact_margin is set, or else only
+// whether bb_me wins (margin 1), draws (0) or loses (margin -1), which is quicker. Counts
+// nodes and obeys the budget in ss. Returns false if the solve was stopped;
+// margin and move_out are garbage then. move_out is BBMOVE_NONE if bb_me has
+// no move.
+bool solveEndgameBB(Bitboard bb_me, Bitboard bb_him, bool exact_margin, BitboardMove& move_out, int& margin, SearchState& ss);
+
+#endif
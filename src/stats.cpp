@@ -0,0 +1,133 @@
+#include <iomanip>
+#include <locale>
+#include <sstream>
+
+#include "ai.hpp"
+#include "stats.hpp"
+
+using namespace std;
+
+namespace
+{
+
+// One past the deepest depth any node was searched at
+int depthsUsed(const SearchStats& stats)
+{
+    int num_depths = MAX_SEARCH_DEPTH + 1;
+    while(num_depths > 0 && stats.nodes[num_depths - 1] == 0) {
+        --num_depths;
+    }
+    return num_depths;
+}
+
+void writeJsonArray(ostream& out, const long long* counts, int size)
+{
+    out << "[";
+    for(int i = 0; i < size; ++i) {
+        out << (i > 0 ? "," : "") << counts[i];
+    }
+    out << "]";
+}
+
+double percent(long long part, long long whole)
+{
+    return whole > 0 ? 100.0 * part / whole : 0.0;
+}
+
+}
+
+void writeSearchStatsJson(ostream& out, const SearchStats& stats, const char* engine, int depth, int score, double secs,
+                          bool ponder_hit)
+{
+    int num_depths = depthsUsed(stats);
+    // Built on the side so that out's locale (which may add thousands
+    // separators) can't get into the numbers
+    ostringstream line;
+    line.imbue(locale::classic());
+    line << "{\"engine\":\"" << engine << "\""
+         << ",\"config\":\"" << getSearchConfig().name << "\""
+         << ",\"threads\":" << getNumSearchThreads()
+         << ",\"depth\":" << depth
+         << ",\"score\":" << score
+         << ",\"secs\":" << secs
+         << ",\"ponder_hit\":" << (ponder_hit ? "true" : "false")
+         << ",\"nodes\":" << stats.totalNodes()
+         << ",\"nodes_by_depth\":";
+    writeJsonArray(line, stats.nodes, num_depths);
+    line << ",\"solver_nodes\":" << stats.solver_nodes << ",\"tt_probes\":";
+    writeJsonArray(line, stats.tt_probes, num_depths);
+    line << ",\"tt_hits\":";
+    writeJsonArray(line, stats.tt_hits, num_depths);
+    line << ",\"tt_cutoffs\":";
+    writeJsonArray(line, stats.tt_cutoffs, num_depths);
+    line << ",\"futility_prunes\":" << stats.futility_prunes
+         << ",\"frontier_batches\":" << stats.frontier_batches
+         << ",\"cutoffs_by_move\":";
+    writeJsonArray(line, stats.cutoffs_by_move, NUM_CUTOFF_MOVE_SLOTS);
+    line << ",\"cutoffs_by_stage\":{";
+    for(int stage = 0; stage < NUM_CUTOFF_STAGES; ++stage) {
+        line << (stage > 0 ? "," : "") << "\"" << CUTOFF_STAGE_NAMES[stage] << "\":" << stats.cutoffs_by_stage[stage];
+    }
+    line << "},\"root_searches\":" << stats.root_searches << ",\"iterations\":[";
+    for(int i = 0; i < stats.num_iterations; ++i) {
+        const IterationStats& iteration = stats.iterations[i];
+        line << (i > 0 ? "," : "")
+             << "{\"depth\":" << iteration.depth
+             << ",\"nodes\":" << iteration.nodes
+             << ",\"root_searches\":" << iteration.root_searches
+             << ",\"secs\":" << iteration.secs
+             << ",\"completed\":" << (iteration.completed ? "true" : "false") << "}";
+    }
+    line << "]}";
+    out << line.str() << endl;
+}
+
+void printSearchStats(ostream& out, const SearchStats& stats)
+{
+    out << "depth        nodes    TT probes   hit rate   TT cutoffs" << endl;
+    for(int depth = depthsUsed(stats) - 1; depth >= 0; --depth) {
+        out << setw(5) << depth
+            << setw(13) << stats.nodes[depth]
+            << setw(13) << stats.tt_probes[depth]
+            << setw(10) << fixed << setprecision(1) << percent(stats.tt_hits[depth], stats.tt_probes[depth]) << "%"
+            << setw(13) << stats.tt_cutoffs[depth]
+            << defaultfloat << endl;
+    }
+    if(stats.solver_nodes > 0) {
+        out << "Endgame solver: " << stats.solver_nodes << " nodes" << endl;
+    }
+    out << "Futility prunes: " << stats.futility_prunes
+        << "; frontier nodes evaluated in one pass: " << stats.frontier_batches << endl;
+
+    long long num_cutoffs = 0;
+    for(int stage = 0; stage < NUM_CUTOFF_STAGES; ++stage) {
+        num_cutoffs += stats.cutoffs_by_stage[stage];
+    }
+    out << "Beta cutoffs: " << num_cutoffs << fixed << setprecision(1) << endl << "  by move:";
+    for(int slot = 0; slot < NUM_CUTOFF_MOVE_SLOTS; ++slot) {
+        out << " " << slot + 1 << (slot + 1 == NUM_CUTOFF_MOVE_SLOTS ? "+ " : " ")
+            << percent(stats.cutoffs_by_move[slot], num_cutoffs) << "%";
+    }
+    out << endl << "  by stage:";
+    for(int stage = 0; stage < NUM_CUTOFF_STAGES; ++stage) {
+        out << " " << CUTOFF_STAGE_NAMES[stage] << " " << percent(stats.cutoffs_by_stage[stage], num_cutoffs) << "%";
+    }
+    out << defaultfloat << endl;
+
+    if(stats.num_iterations > 0) {
+        // The effective branching factor is how many times more nodes an
+        // iteration took than the one before it
+        out << "iteration        nodes   root searches      secs    EBF" << endl;
+        for(int i = 0; i < stats.num_iterations; ++i) {
+            const IterationStats& iteration = stats.iterations[i];
+            out << setw(9) << iteration.depth
+                << setw(13) << iteration.nodes
+                << setw(16) << iteration.root_searches
+                << setw(10) << fixed << setprecision(3) << iteration.secs;
+            if(i > 0 && iteration.completed && stats.iterations[i - 1].nodes > 0) {
+                out << setw(7) << setprecision(2) << double(iteration.nodes) / stats.iterations[i - 1].nodes;
+            }
+            out << (iteration.completed ? "" : "  (stopped)") << defaultfloat << endl;
+        }
+    }
+}
@@ -0,0 +1,24 @@
+#ifndef SPLOT_STATS_HPP
+#define SPLOT_STATS_HPP
+
+#include <ostream>
+#include "ai.hpp"
+
+// Writes a search's stats (as from getLastSearchStats) as one line of JSON,
+// for dashboards to collect. The config and thread count are the calling
+// thread's.
+//   {"engine":ENGINE,"config":..,"threads":..,"depth":DEPTH,"score":SCORE,
+//    "secs":SECS,"ponder_hit":PONDER_HIT,"nodes":..,"nodes_by_depth":[..],"solver_nodes":..,
+//    "tt_probes":[..],"tt_hits":[..],"tt_cutoffs":[..],"futility_prunes":..,
+//    "frontier_batches":..,"cutoffs_by_move":[..],"cutoffs_by_stage":{..},
+//    "root_searches":..,"iterations":[{"depth":..,"nodes":..,
+//    "root_searches":..,"secs":..,"completed":..},..]}
+// Arrays "by depth" start at depth 0 and stop at the deepest with any nodes.
+void writeSearchStatsJson(std::ostream& out, const SearchStats& stats, const char* engine, int depth, int score, double secs,
+                          bool ponder_hit=false);
+
+// The same for people: where the nodes went, how the table and the move
+// ordering did, and each iteration with its effective branching factor.
+void printSearchStats(std::ostream& out, const SearchStats& stats);
+
+#endif
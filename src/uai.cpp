@@ -0,0 +1,324 @@
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <locale>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Board.hpp"
+#include "moves.hpp"
+#include "ai.hpp"
+#include "bitboards.hpp"
+#include "zobrist.hpp"
+#include "notation.hpp"
+#include "book.hpp"
+#include "uai.hpp"
+
+using namespace std;
+
+namespace
+{
+
+// The searches the GUI can pick with the Algorithm option
+const struct { const char* name; AiFuncPtr ai; } UAI_ALGORITHMS[] = {
+    {"mtdf", mtdf_bb},
+    {"pvs", pvs_bb}
+};
+
+// Reported (in centipawns, like everything else) for a game the search has
+// found to be won; the piece counts themselves never come near it
+const int UAI_WIN_SCORE = 100000;
+
+// The search runs on its own thread so that "stop" and "isready" can be
+// answered while it's going. Both threads write to cout, so every line goes
+// through sendLine.
+mutex g_output_mutex;
+atomic<bool> g_stop_request(false);
+thread g_search_thread;
+AiFuncPtr g_search_ai = mtdf_bb;
+
+bool g_try_huge_pages = true;
+Board g_board;
+Player g_to_move = PLAYER1;
+
+void sendLine(const string& line)
+{
+    lock_guard<mutex> lock(g_output_mutex);
+    cout << line << endl;
+}
+
+int uaiScore(int score)
+{
+    if(score >= WIN) {
+        return UAI_WIN_SCORE;
+    } else if(score <= LOSS) {
+        return -UAI_WIN_SCORE;
+    }
+    return score * 100 / getSearchLimits().eval_weights.weights[EVAL_PIECES];
+}
+
+// Iteration callback. Only the main search thread's nodes are counted.
+void reportIteration(const Board&, const Move&, int depth, int score, long long nodes, double secs, const vector<Move>& pv)
+{
+    ostringstream line;
+    line << "info depth " << depth << " score cp " << uaiScore(score) << " nodes " << nodes;
+    if(secs > 0) {
+        line << " nps " << (long long)(nodes / secs);
+    }
+    line << " time " << (long long)(secs * 1000) << " pv";
+    for(const Move& pv_move : pv) {
+        line << " " << moveName(pv_move);
+    }
+    sendLine(line.str());
+}
+
+void stopSearch()
+{
+    if(g_search_thread.joinable()) {
+        g_stop_request = true;
+        g_search_thread.join();
+    }
+}
+
+// position startpos|fen <fen> [moves <move>...]
+void handlePosition(istringstream& args)
+{
+    string token;
+    args >> token;
+    string fen;
+    if(token == "startpos") {
+        fen = getStartFen();
+        args >> token;
+    } else if(token == "fen") {
+        while(args >> token && token != "moves") {
+            fen += token + " ";
+        }
+    } else {
+        sendLine("info string Expected startpos or fen");
+        return;
+    }
+
+    Board board;
+    Player to_move;
+    if(!parseFen(fen, board, to_move)) {
+        sendLine("info string Bad or unsupported FEN: " + fen);
+        return;
+    }
+    if(token == "moves") {
+        while(args >> token) {
+            if(token != "0000") {
+                Move move;
+                if(!parseMove(board, to_move, token, move)) {
+                    sendLine("info string Illegal move: " + token);
+                    return;
+                }
+                makeMove(board, move);
+            }
+            to_move = getOpponent(to_move);
+        }
+    }
+    g_board = board;
+    g_to_move = to_move;
+}
+
+// go [depth N] [nodes N] [movetime MS] [xtime MS] [otime MS] [xinc MS] [oinc MS] [infinite]
+// btime/wtime/binc/winc are accepted for x and o, as some GUIs send them.
+// Plain "go" is the same as "go infinite".
+void handleGo(istringstream& args)
+{
+    stopSearch();
+
+    // The evaluation and the solver stay as configured; how long to search is
+    // up to the GUI
+    SearchLimits limits = getSearchLimits();
+    limits.depth = MAX_SEARCH_DEPTH;
+    limits.nodes = 0;
+    limits.move_time_ms = 0;
+    limits.pondering = nullptr;
+    bool infinite = true;
+    int clock_ms[2] = {0, 0};
+    int increment_ms[2] = {0, 0};
+    string token;
+    while(args >> token) {
+        long long value = 0;
+        if(token != "infinite" && !(args >> value)) {
+            break;
+        }
+        int ms = int(max(0LL, value));
+        if(token == "depth") {
+            limits.depth = min(max(1, int(value)), MAX_SEARCH_DEPTH);
+        } else if(token == "nodes") {
+            limits.nodes = max(0LL, value);
+        } else if(token == "movetime") {
+            limits.move_time_ms = ms;
+        } else if(token == "xtime" || token == "btime") {
+            clock_ms[0] = ms;
+        } else if(token == "otime" || token == "wtime") {
+            clock_ms[1] = ms;
+        } else if(token == "xinc" || token == "binc") {
+            increment_ms[0] = ms;
+        } else if(token == "oinc" || token == "winc") {
+            increment_ms[1] = ms;
+        }
+        infinite = infinite && token == "infinite";
+    }
+    int side = (g_to_move == PLAYER1) ? 0 : 1;
+    limits.clock_ms = clock_ms[side];
+    limits.increment_ms = increment_ms[side];
+    limits.stop_request = &g_stop_request;
+
+    Board board(g_board);
+    if(g_to_move == PLAYER1) {
+        swapPlayers(board);
+    }
+
+    // Search settings are per thread, so hand ours over
+    const SearchConfig* config = &getSearchConfig();
+    int num_threads = getNumSearchThreads();
+    AiFuncPtr ai = g_search_ai;
+    g_stop_request = false;
+    g_search_thread = thread([board, infinite, limits, config, num_threads, ai]() {
+        setSearchLimits(limits);
+        setSearchConfig(*config);
+        setNumSearchThreads(num_threads);
+        string best_move = "0000";
+        Move move;
+        int book_score, book_depth;
+        if(!infinite && probeBook(board, move, book_score, book_depth)) {
+            // Infinite searches are for analysis, so they don't use the book
+            sendLine("info depth " + to_string(book_depth) + " score cp " + to_string(uaiScore(book_score))
+                     + " pv " + moveName(move) + " string book move");
+            best_move = moveName(move);
+        } else if(hasLegalMove(board, PLAYER2)) {
+            vector<int> square_order(NUM_SQUARES);
+            vector<int> jump_order(NUM_JUMPS);
+            for(int i = 0; i < NUM_SQUARES; ++i) {
+                square_order.at(i) = i;
+            }
+            for(int i = 0; i < NUM_JUMPS; ++i) {
+                jump_order.at(i) = i;
+            }
+            newZobristGeneration();
+            long long nodes_searched = 0;
+            ai(board, square_order, jump_order, move, nodes_searched);
+            best_move = moveName(move);
+        }
+        // An infinite search may only answer once it's told to stop
+        while(infinite && !g_stop_request) {
+            this_thread::sleep_for(chrono::milliseconds(1));
+        }
+        sendLine("bestmove " + best_move);
+    });
+}
+
+// setoption name <name> value <value>
+void handleSetOption(istringstream& args)
+{
+    string token, name, value;
+    args >> token;
+    while(args >> token && token != "value") {
+        name += (name.empty() ? "" : " ") + token;
+    }
+    args >> value;
+    transform(name.begin(), name.end(), name.begin(), ::tolower);
+
+    stopSearch();
+    if(name == "hash") {
+        if(!resizeZobristTable(getZobristEntriesForMegabytes(max(1, atoi(value.c_str()))), g_try_huge_pages)) {
+            sendLine("info string Couldn't allocate the transposition table");
+        }
+    } else if(name == "threads") {
+        setNumSearchThreads(max(1, atoi(value.c_str())));
+    } else if(name == "config") {
+        const SearchConfig* config = findSearchConfig(value);
+        if(config) {
+            setSearchConfig(*config);
+        } else {
+            sendLine("info string Unknown config: " + value);
+        }
+    } else if(name == "algorithm") {
+        AiFuncPtr ai = nullptr;
+        for(const auto& algorithm : UAI_ALGORITHMS) {
+            if(value == algorithm.name) {
+                ai = algorithm.ai;
+            }
+        }
+        if(ai) {
+            g_search_ai = ai;
+        } else {
+            sendLine("info string Unknown algorithm: " + value);
+        }
+    } else {
+        sendLine("info string Unknown option: " + name);
+    }
+}
+
+void sendId()
+{
+    sendLine("id name Splot");
+    sendLine("id author furrykef");
+    size_t hash_mb = getZobristTableEntries() * sizeof(ZobristEntry) / 0x100000;
+    sendLine("option name Hash type spin default " + to_string(hash_mb) + " min 1 max 65536");
+    sendLine("option name Threads type spin default " + to_string(getNumSearchThreads()) + " min 1 max 256");
+    string config_option = "option name Config type combo default " + string(getSearchConfig().name);
+    for(int i = 0; i < NUM_SEARCH_CONFIGS; ++i) {
+        config_option += " var " + string(SEARCH_CONFIGS[i].name);
+    }
+    sendLine(config_option);
+    string algorithm_option = "option name Algorithm type combo default " + string(UAI_ALGORITHMS[0].name);
+    for(const auto& algorithm : UAI_ALGORITHMS) {
+        algorithm_option += " var " + string(algorithm.name);
+    }
+    sendLine(algorithm_option);
+    sendLine("uaiok");
+}
+
+}
+
+void runUai(bool try_huge_pages)
+{
+    // The protocol wants plain numbers, without thousands separators
+    cout.imbue(locale::classic());
+    g_try_huge_pages = try_huge_pages;
+    Player to_move;
+    parseFen(getStartFen(), g_board, to_move);
+    g_to_move = to_move;
+    setIterationCallback(reportIteration);
+
+    string line;
+    while(getline(cin, line)) {
+        istringstream args(line);
+        string command;
+        if(!(args >> command)) {
+            continue;
+        }
+        if(command == "uai") {
+            sendId();
+        } else if(command == "isready") {
+            sendLine("readyok");
+        } else if(command == "uainewgame") {
+            stopSearch();
+            initZobristTable();
+        } else if(command == "setoption") {
+            handleSetOption(args);
+        } else if(command == "position") {
+            handlePosition(args);
+        } else if(command == "go") {
+            handleGo(args);
+        } else if(command == "stop") {
+            stopSearch();
+        } else if(command == "quit") {
+            break;
+        } else {
+            sendLine("info string Unknown command: " + command);
+        }
+    }
+    stopSearch();
+    setIterationCallback(nullptr);
+}
@@ -0,0 +1,13 @@
+#ifndef SPLOT_UAI_HPP
+#define SPLOT_UAI_HPP
+
+// Headless mode: talks the UAI protocol (the Ataxx take on chess's UCI) on
+// stdin/stdout, so GUIs and tournament managers can run the engine. Searches
+// with mtdf_bb (or pvs_bb) under the current search config, limits and thread
+// count, which the GUI can change with setoption; each go command says how
+// long to search, in place of the limits' depth, nodes and time. Returns when
+// it reads "quit" or stdin ends.
+// try_huge_pages is used when the GUI resizes the transposition table.
+void runUai(bool try_huge_pages);
+
+#endif
@@ -1,57 +1,347 @@
+#include <atomic>
 #include <cassert>
+#include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include <functional>
+#include <vector>
 #include "zobrist.hpp"
 
-const size_t ZOBRIST_TABLE_SIZE = 64 * 0x100000;
+// Fresh memory reads as zeroes, which packZobristValue guarantees are all-invalid entries
+ZobristBucket* zobrist_table = nullptr;
+size_t zobrist_bucket_mask = 0;
+PageSize zobrist_page_size = PAGES_NORMAL;
+bool zobrist_try_huge_pages = true;
 
-ZobristValue zobrist_table[ZOBRIST_TABLE_SIZE];
+// Bumped before every search. Each entry records the generation that wrote it,
+// so results left over from earlier searches can be recognized and replaced
+// without ever having to wipe the table. Atomic since games played side by
+// side (see selfplay.hpp) share the table and each bumps it.
+std::atomic<unsigned char> zobrist_generation(0);
 
-// XORed into hash when it's player 2's turn (@TODO@ -- codes for player 3, player 4)
-const ZobristHash PLAYER2_TURN_CODE = 0x431D89EC63B226D7LL;
+namespace
+{
+
+const int ZOBRIST_NUM_FRAGMENTS = (NUM_SQUARES + ZOBRIST_FRAGMENT_BITS - 1) / ZOBRIST_FRAGMENT_BITS;
+const int ZOBRIST_FRAGMENT_VALUES = 1 << ZOBRIST_FRAGMENT_BITS;
+const Bitboard ZOBRIST_FRAGMENT_MASK = ZOBRIST_FRAGMENT_VALUES - 1;
+
+typedef LookupTable<LookupTable<LookupTable<ZobristHash, ZOBRIST_FRAGMENT_VALUES>, ZOBRIST_NUM_FRAGMENTS>, 2> ZobristFragmentTable;
+
+// ZOBRIST_CODES_BB[player][fragment_num][bits] is the hash of a bitboard whose
+// only pieces are given by bits, starting at square fragment_num * ZOBRIST_FRAGMENT_BITS.
+// Each entry is built from the one with its lowest bit cleared, so it's one XOR apiece.
+constexpr ZobristFragmentTable makeZobristCodesBB()
+{
+    ZobristFragmentTable codes = {};
+    for(int player_num = 0; player_num < 2; ++player_num) {
+        for(int fragment_num = 0; fragment_num < ZOBRIST_NUM_FRAGMENTS; ++fragment_num) {
+            for(int bits = 1; bits < ZOBRIST_FRAGMENT_VALUES; ++bits) {
+                int lowest_bit = 0;
+                while(!(bits & (1 << lowest_bit))) {
+                    ++lowest_bit;
+                }
+                int square_num = fragment_num * ZOBRIST_FRAGMENT_BITS + lowest_bit;
+                ZobristHash code = square_num < NUM_SQUARES ? ZOBRIST_CODES[player_num][square_num] : 0;
+                codes[player_num][fragment_num][bits] = codes[player_num][fragment_num][bits & (bits - 1)] ^ code;
+            }
+        }
+    }
+    return codes;
+}
+
+constexpr ZobristFragmentTable ZOBRIST_CODES_BB = makeZobristCodesBB();
+
+static_assert(INFINITE_SCORE <= 0x7fff, "bounds are packed into 16 bits");
+
+// Packs everything but the hash into 64 bits so a slot can be written with two stores.
+// Depth is stored off by one so that an all-zero slot has depth -1, i.e. is invalid.
+std::uint64_t packZobristValue(const ZobristValue& value, unsigned char generation)
+{
+    return std::uint64_t(std::uint16_t(value.lower_bound))
+         | std::uint64_t(std::uint16_t(value.upper_bound)) << 16
+         | std::uint64_t(std::uint8_t(value.depth + 1)) << 32
+         | std::uint64_t(value.best_move.move_type) << 40
+         | std::uint64_t(value.best_move.square) << 42
+         | std::uint64_t(value.best_move.jump_type) << 48
+         | std::uint64_t(generation) << 56;
+}
+
+ZobristValue unpackZobristValue(std::uint64_t data)
+{
+    BitboardMove best_move(BitboardMoveType((data >> 40) & 0x3), (data >> 42) & 0x3f, (data >> 48) & 0xff);
+    return ZobristValue(std::int16_t(data & 0xffff), std::int16_t((data >> 16) & 0xffff), int((data >> 32) & 0xff) - 1, best_move);
+}
+
+unsigned char unpackGeneration(std::uint64_t data)
+{
+    return (unsigned char)(data >> 56);
+}
+
+const std::uint64_t ZOBRIST_GENERATION_MASK = std::uint64_t(0xff) << 56;
 
+// Snapshots are written this many entries at a time
+const size_t ZOBRIST_FILE_BUFFER_ENTRIES = 1 << 16;
+
+// When loading a snapshot, the bucket for the entry this far ahead is
+// prefetched, so the cache misses overlap instead of coming one at a time
+const size_t ZOBRIST_LOAD_PREFETCH_DISTANCE = 16;
+
+// Whether an entry from a snapshot could have been written by this program.
+// The move is only checked for being a move at all; whether it's legal
+// depends on the position, which is checked when the entry is used.
+bool isValidStoredValue(const ZobristValue& value)
+{
+    if(value.depth < 0 || value.depth > INFINITE_PLY
+        || value.lower_bound < -INFINITE_SCORE || value.lower_bound > INFINITE_SCORE
+        || value.upper_bound < -INFINITE_SCORE || value.upper_bound > INFINITE_SCORE)
+    {
+        return false;
+    }
+    switch(value.best_move.move_type) {
+      case BBMOVE_NONE:     return true;
+      case BBMOVE_CLONE:    return value.best_move.square < NUM_SQUARES;
+      case BBMOVE_JUMP:     return value.best_move.square < NUM_SQUARES && value.best_move.jump_type < NUM_JUMPS;
+      default:              return false;
+    }
+}
+
+void writeEntry(ZobristEntry& entry, ZobristHash hash, const ZobristValue& value)
+{
+    std::uint64_t data = packZobristValue(value, zobrist_generation);
+    entry.hash_xor_data.store(hash ^ data, std::memory_order_relaxed);
+    entry.data.store(data, std::memory_order_relaxed);
+}
+
+}
+
+bool resizeZobristTable(size_t num_entries, bool try_huge_pages)
+{
+    assert(num_entries >= ZOBRIST_BUCKET_SIZE && (num_entries & (num_entries - 1)) == 0);
+    if(zobrist_table) {
+        freeLargeBlock(zobrist_table, getZobristTableEntries() * sizeof(ZobristEntry), zobrist_page_size);
+    }
+    size_t num_buckets = num_entries / ZOBRIST_BUCKET_SIZE;
+    zobrist_table = static_cast<ZobristBucket*>(allocateLargeBlock(num_buckets * sizeof(ZobristBucket), try_huge_pages, zobrist_page_size));
+    zobrist_bucket_mask = zobrist_table ? num_buckets - 1 : 0;
+    zobrist_try_huge_pages = try_huge_pages;
+    return zobrist_table != nullptr;
+}
+
+size_t getZobristEntriesForMegabytes(size_t megabytes)
+{
+    size_t num_entries = ZOBRIST_BUCKET_SIZE;
+    while(num_entries * 2 * sizeof(ZobristEntry) <= megabytes * 0x100000) {
+        num_entries *= 2;
+    }
+    return num_entries;
+}
+
+size_t getZobristTableEntries()
+{
+    return zobrist_table ? (zobrist_bucket_mask + 1) * ZOBRIST_BUCKET_SIZE : 0;
+}
+
+PageSize getZobristTablePageSize()
+{
+    return zobrist_page_size;
+}
+
+// Only needed to forget everything (e.g. for benchmarks); searches should use
+// newZobristGeneration instead.
+// Rather than writing over the whole table, we hand it back to the OS and get
+// fresh (zeroed, uncommitted) memory in its place.
 void initZobristTable()
 {
-    // Mark everything in the table as invalid
-    for(ZobristValue& value : zobrist_table) {
-        value = ZobristValue();
+    size_t num_entries = getZobristTableEntries();
+    if(num_entries == 0) {
+        num_entries = getZobristEntriesForMegabytes(DEFAULT_ZOBRIST_TABLE_MB);
     }
+    resizeZobristTable(num_entries, zobrist_try_huge_pages);
+}
+
+void newZobristGeneration()
+{
+    if(!zobrist_table) {
+        initZobristTable();
+    }
+    ++zobrist_generation;
 }
 
 // player_sign is 1 for AI, -1 for human
 // Remember, depth of -1 signifies the whole ZobristValue is invalid
 ZobristValue getZobristValueBB(ZobristHash hash)
 {
-    ZobristValue& value = zobrist_table[hash % ZOBRIST_TABLE_SIZE];
-    if(value.full_hash != hash) {
-        // The short hash (i.e. mod ZOBRIST_TABLE_SIZE) collided, but the full hash did not.
-        // That means this result is spurious; invalidate it.
-        // @TODO@ -- is it really wise to clear entry in the actual table?
-        // Sometimes the AI does read the transposition table without writing it.
-        value = ZobristValue();
-        value.full_hash = hash;
+    ZobristValue value;
+    value.full_hash = hash;
+    for(const ZobristEntry& entry : getZobristBucket(hash).entries) {
+        std::uint64_t hash_xor_data = entry.hash_xor_data.load(std::memory_order_relaxed);
+        std::uint64_t data = entry.data.load(std::memory_order_relaxed);
+        if((hash_xor_data ^ data) == hash) {
+            value = unpackZobristValue(data);
+            value.full_hash = hash;
+            break;
+        }
     }
+    // If nothing matched, the position isn't in the table, or another thread was
+    // writing its entry as we read it. Either way we report an empty entry. We
+    // never touch the table here; other threads may be relying on what's there.
     return value;
 }
 
+// An existing entry for the same position is always refreshed. Otherwise the
+// result goes in the shallowest depth-preferred entry if it's at least as deep
+// (results left over from earlier searches count as shallowest of all; they're
+// still used when probing, since they are as valid now as they were then).
+// Failing that, it goes in the always-replace entry.
 void setZobristValueBB(ZobristHash hash, const ZobristValue& value)
 {
-    zobrist_table[hash % ZOBRIST_TABLE_SIZE] = value;
+    ZobristBucket& bucket = getZobristBucket(hash);
+    ZobristEntry* victim = &bucket.entries[ZOBRIST_ALWAYS_REPLACE];
+    int victim_depth = INFINITE_PLY + 1;
+    for(int i = 0; i < ZOBRIST_BUCKET_SIZE; ++i) {
+        ZobristEntry& entry = bucket.entries[i];
+        std::uint64_t data = entry.data.load(std::memory_order_relaxed);
+        if((entry.hash_xor_data.load(std::memory_order_relaxed) ^ data) == hash) {
+            writeEntry(entry, hash, value);
+            return;
+        }
+        if(i != ZOBRIST_ALWAYS_REPLACE) {
+            int depth = -1;
+            if(unpackGeneration(data) == zobrist_generation) {
+                depth = unpackZobristValue(data).depth;
+            }
+            if(depth < victim_depth) {
+                victim = &entry;
+                victim_depth = depth;
+            }
+        }
+    }
+    if(victim_depth > value.depth) {
+        victim = &bucket.entries[ZOBRIST_ALWAYS_REPLACE];
+    }
+    writeEntry(*victim, hash, value);
 }
 
 ZobristHash calcHashBB(Bitboard player1, Bitboard player2, int player_sign)
 {
     ZobristHash hash = 0;
-    hash ^= ZOBRIST_CODES_BB[0][0][0xffff & player1];
-    hash ^= ZOBRIST_CODES_BB[0][1][0xffff & (player1 >> 16)];
-    hash ^= ZOBRIST_CODES_BB[0][2][0xffff & (player1 >> 32)];
-    hash ^= ZOBRIST_CODES_BB[0][3][0xffff & (player1 >> 48)];
-    hash ^= ZOBRIST_CODES_BB[1][0][0xffff & player2];
-    hash ^= ZOBRIST_CODES_BB[1][1][0xffff & (player2 >> 16)];
-    hash ^= ZOBRIST_CODES_BB[1][2][0xffff & (player2 >> 32)];
-    hash ^= ZOBRIST_CODES_BB[1][3][0xffff & (player2 >> 48)];
+    for(int fragment_num = 0; fragment_num < ZOBRIST_NUM_FRAGMENTS; ++fragment_num) {
+        int shift = fragment_num * ZOBRIST_FRAGMENT_BITS;
+        hash ^= ZOBRIST_CODES_BB[0][fragment_num][ZOBRIST_FRAGMENT_MASK & (player1 >> shift)];
+        hash ^= ZOBRIST_CODES_BB[1][fragment_num][ZOBRIST_FRAGMENT_MASK & (player2 >> shift)];
+    }
     if(player_sign == 1) {
         hash ^= PLAYER2_TURN_CODE;
     }
     return hash;
 }
+
+ZobristHash calcCanonicalHashBB(Bitboard player1, Bitboard player2, int player_sign, int& symmetry)
+{
+    Bitboard canonical1, canonical2;
+    symmetry = canonicalizeBitboards(player1, player2, canonical1, canonical2);
+    return calcHashBB(canonical1, canonical2, player_sign);
+}
+
+std::uint64_t getZobristHashScheme()
+{
+    // FNV-1a style, so codes that merely trade places still change it. The
+    // board's size is in the number of codes.
+    std::uint64_t scheme = PLAYER2_TURN_CODE ^ BLOCKED_SQUARE_MASK;
+    for(int player_num = 0; player_num < 2; ++player_num) {
+        for(int square_num = 0; square_num < NUM_SQUARES; ++square_num) {
+            scheme = (scheme ^ ZOBRIST_CODES[player_num][square_num]) * 0x100000001B3LL;
+        }
+    }
+    return scheme;
+}
+
+bool saveZobristTable(const char* filename, int min_depth, size_t& num_saved)
+{
+    num_saved = 0;
+    FILE* file = fopen(filename, "wb");
+    if(!file) {
+        return false;
+    }
+    ZobristFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, ZOBRIST_FILE_MAGIC, sizeof(header.magic));
+    header.version = ZOBRIST_FILE_VERSION;
+    header.entry_layout = ZOBRIST_ENTRY_LAYOUT;
+    header.byte_order = ZOBRIST_BYTE_ORDER_MARK;
+    header.hash_scheme = getZobristHashScheme();
+    // The count is filled in at the end
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+
+    std::vector<ZobristFileEntry> buffer;
+    buffer.reserve(ZOBRIST_FILE_BUFFER_ENTRIES);
+    size_t num_buckets = zobrist_table ? zobrist_bucket_mask + 1 : 0;
+    for(size_t bucket_num = 0; bucket_num < num_buckets && ok; ++bucket_num) {
+        for(const ZobristEntry& entry : zobrist_table[bucket_num].entries) {
+            std::uint64_t data = entry.data.load(std::memory_order_relaxed);
+            int depth = unpackZobristValue(data).depth;
+            if(depth < 0 || depth < min_depth) {
+                continue;
+            }
+            ZobristFileEntry file_entry;
+            file_entry.hash = entry.hash_xor_data.load(std::memory_order_relaxed) ^ data;
+            file_entry.data = data & ~ZOBRIST_GENERATION_MASK;
+            buffer.push_back(file_entry);
+        }
+        if(buffer.size() + ZOBRIST_BUCKET_SIZE > ZOBRIST_FILE_BUFFER_ENTRIES || bucket_num + 1 == num_buckets) {
+            ok = fwrite(buffer.data(), sizeof(ZobristFileEntry), buffer.size(), file) == buffer.size();
+            num_saved += buffer.size();
+            buffer.clear();
+        }
+    }
+
+    header.num_entries = num_saved;
+    ok = ok && fseek(file, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, file) == 1;
+    ok = (fclose(file) == 0) && ok;
+    return ok;
+}
+
+bool loadZobristTable(const char* filename, size_t& num_loaded)
+{
+    num_loaded = 0;
+    size_t bytes = 0;
+    const void* view = mapFile(filename, bytes);
+    if(!view) {
+        return false;
+    }
+    const ZobristFileHeader* header = static_cast<const ZobristFileHeader*>(view);
+    if(bytes < sizeof(ZobristFileHeader) || memcmp(header->magic, ZOBRIST_FILE_MAGIC, sizeof(ZOBRIST_FILE_MAGIC)) != 0
+        || header->version != ZOBRIST_FILE_VERSION
+        || header->entry_layout != ZOBRIST_ENTRY_LAYOUT
+        || header->byte_order != ZOBRIST_BYTE_ORDER_MARK
+        || header->hash_scheme != getZobristHashScheme()
+        || header->num_entries != (bytes - sizeof(ZobristFileHeader)) / sizeof(ZobristFileEntry)
+        || (bytes - sizeof(ZobristFileHeader)) % sizeof(ZobristFileEntry) != 0)
+    {
+        unmapFile(view, bytes);
+        return false;
+    }
+    if(!zobrist_table) {
+        initZobristTable();
+    }
+    if(!zobrist_table) {
+        unmapFile(view, bytes);
+        return false;
+    }
+
+    const ZobristFileEntry* entries = reinterpret_cast<const ZobristFileEntry*>(header + 1);
+    size_t num_entries = size_t(header->num_entries);
+    for(size_t i = 0; i < num_entries; ++i) {
+        if(i + ZOBRIST_LOAD_PREFETCH_DISTANCE < num_entries) {
+            prefetchZobristBucket(entries[i + ZOBRIST_LOAD_PREFETCH_DISTANCE].hash);
+        }
+        ZobristValue value = unpackZobristValue(entries[i].data);
+        if(isValidStoredValue(value)) {
+            setZobristValueBB(entries[i].hash, value);
+            ++num_loaded;
+        }
+    }
+    unmapFile(view, bytes);
+    return true;
+}
@@ -1,12 +1,17 @@
 #ifndef SPLOT_ZOBRIST_HPP
 #define SPLOT_ZOBRIST_HPP
 
+#include <atomic>
 #include <cstdint>
 #include <unordered_map>
+#ifdef _MSC_VER
+#include <xmmintrin.h>
+#endif
 #include "Board.hpp"
 #include "moves.hpp"
 #include "bitboards.hpp"
 #include "ai.hpp"
+#include "largepages.hpp"
 
 typedef std::uint64_t ZobristHash;
 
@@ -14,14 +19,14 @@ typedef std::uint64_t ZobristHash;
 struct ZobristValue
 {
     ZobristValue()
-        : lower_bound(-INFINITY),
-          upper_bound(INFINITY),
+        : lower_bound(-INFINITE_SCORE),
+          upper_bound(INFINITE_SCORE),
           depth(-1),
           best_move(BitboardMove(BBMOVE_NONE, 0, 0))
     {
     }
 
-    ZobristValue(short lower_bound_, short upper_bound_, int depth_, BitboardMove best_move_=BitboardMove(BBMOVE_NONE, 0, 0))
+    ZobristValue(int lower_bound_, int upper_bound_, int depth_, BitboardMove best_move_=BitboardMove(BBMOVE_NONE, 0, 0))
         : lower_bound(lower_bound_),
           upper_bound(upper_bound_),
           depth(depth_),
@@ -29,20 +34,265 @@ struct ZobristValue
     {
     }
 
+    // The table only has room for 16 bits of each bound, which is enough for
+    // any score up to INFINITE_SCORE (see packZobristValue)
     ZobristHash full_hash;
-    short lower_bound;
-    short upper_bound;
+    int lower_bound;
+    int upper_bound;
     signed char depth;                      // Use -1 to signify invalid
     BitboardMove best_move;
 };
 #pragma pack()
 
+// A slot in the transposition table. The table is shared by all search threads
+// without any locking, so a slot can be read while another thread is halfway
+// through writing it. To catch this, the hash is stored XORed with the packed
+// value: a torn read won't XOR back to the hash we're looking for and is simply
+// treated as a miss.
+struct ZobristEntry
+{
+    std::atomic<std::uint64_t> hash_xor_data;
+    std::atomic<std::uint64_t> data;
+};
+
+// The table is made of buckets the size of a cache line. A position may be
+// stored in any entry of its bucket, so a probe never touches more than one
+// cache line. The first entries are depth-preferred: they only give way to
+// results at least as deep, or to anything once they're left over from an
+// earlier search. The last entry always takes whatever didn't fit elsewhere,
+// so the newest shallow results still have somewhere to go.
+const int ZOBRIST_BUCKET_SIZE = 4;
+const int ZOBRIST_ALWAYS_REPLACE = ZOBRIST_BUCKET_SIZE - 1;
+
+struct alignas(64) ZobristBucket
+{
+    ZobristEntry entries[ZOBRIST_BUCKET_SIZE];
+};
+
+const size_t DEFAULT_ZOBRIST_TABLE_MB = 1024;
+
+// Snapshots (see saveZobristTable) leave out entries shallower than this by
+// default. Most of the table is shallow entries, which are quick to search
+// again.
+const int DEFAULT_ZOBRIST_SAVE_DEPTH = 4;
+
+// The table always has a power-of-two number of buckets; zobrist_bucket_mask is that number minus one
+extern ZobristBucket* zobrist_table;
+extern size_t zobrist_bucket_mask;
+
+inline ZobristBucket& getZobristBucket(ZobristHash hash)
+{
+    return zobrist_table[hash & zobrist_bucket_mask];
+}
+
+// Call as soon as the hash of a position to be probed is known, so the bucket
+// is on its way into the cache while we do other work.
+inline void prefetchZobristBucket(ZobristHash hash)
+{
+#ifdef _MSC_VER
+    _mm_prefetch(reinterpret_cast<const char*>(&getZobristBucket(hash)), _MM_HINT_T0);
+#else
+    __builtin_prefetch(&getZobristBucket(hash));
+#endif
+}
+
+// Sizes the table to num_entries, which must be a power of two no smaller than
+// ZOBRIST_BUCKET_SIZE. Everything in the table is lost. Must not be called
+// during a search. If this is never called, the first search gets a table of
+// DEFAULT_ZOBRIST_TABLE_MB.
+// Returns false (leaving no table) if the memory can't be had.
+bool resizeZobristTable(size_t num_entries, bool try_huge_pages=true);
+
+// Largest power-of-two number of entries that fits in the given number of megabytes
+size_t getZobristEntriesForMegabytes(size_t megabytes);
+
+size_t getZobristTableEntries();
+PageSize getZobristTablePageSize();
+
 void initZobristTable();
+void newZobristGeneration();
+
+// Table snapshot file: a ZobristFileHeader, then num_entries ZobristFileEntries
+// in the machine's byte order. An entry is a table slot as it is in memory
+// (see ZobristEntry), minus the generation, so loading is just a matter of
+// finding each one a bucket. Positions go in under whatever hash they were
+// stored under, table key included (see setSearchTableKey).
+const char ZOBRIST_FILE_MAGIC[8] = {'S', 'P', 'L', 'T', 'T', 'A', 'B', 'L'};
+const std::uint32_t ZOBRIST_FILE_VERSION = 1;
+
+// Must change whenever the packing of a slot does (see packZobristValue)
+const std::uint32_t ZOBRIST_ENTRY_LAYOUT = 1;
+
+// Written as is; reads back as something else on a machine of the other byte order
+const std::uint32_t ZOBRIST_BYTE_ORDER_MARK = 0x01020304;
+
+struct ZobristFileHeader
+{
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t entry_layout;
+    std::uint32_t byte_order;
+    std::uint32_t reserved;
+    std::uint64_t hash_scheme;          // See getZobristHashScheme
+    std::uint64_t num_entries;
+};
+
+struct ZobristFileEntry
+{
+    ZobristHash hash;
+    std::uint64_t data;                 // Packed as in the table, with the generation zeroed
+};
+
+static_assert(sizeof(ZobristFileHeader) == 40 && sizeof(ZobristFileEntry) == 16, "snapshot layout is part of the file format");
+
+// A fingerprint of the hash codes and the blocked squares. Snapshots are only
+// any good to a program that hashes positions the same way on the same board.
+std::uint64_t getZobristHashScheme();
+
+// Writes every entry with a depth of at least min_depth to filename, so the
+// deep results can outlive the process. Must not be called during a search.
+// Returns false if the file can't be written.
+bool saveZobristTable(const char* filename, int min_depth, size_t& num_saved);
+
+// Adds the entries of a snapshot written by saveZobristTable to the table,
+// allocating it first if need be, as if the current search had stored them.
+// The file is memory-mapped and read straight through. Entries whose fields
+// are out of range are dropped; moves are checked against the position when
+// they're used, as with any entry. Must not be called during a search.
+// Returns false, adding nothing, if the file can't be read or comes from an
+// incompatible version.
+bool loadZobristTable(const char* filename, size_t& num_loaded);
 ZobristValue getZobristValueBB(ZobristHash hash);
 void setZobristValueBB(ZobristHash hash, const ZobristValue& value);
 ZobristHash calcHashBB(Bitboard player1, Bitboard player2, int player_sign);
 
-extern const ZobristHash ZOBRIST_CODES[2][NUM_SQUARES];
-extern const ZobristHash ZOBRIST_CODES_BB[2][4][0x10000];
+// The hash of the position's canonical image (see canonicalizeBitboards), which
+// is the same for all images of a position. symmetry is set to the symmetry
+// that takes the position to its canonical image.
+ZobristHash calcCanonicalHashBB(Bitboard player1, Bitboard player2, int player_sign, int& symmetry);
+
+// True random numbers generated with HotBits: http://www.fourmilab.ch/hotbits/
+// One for each player on each square of a 7x7 board.
+const int NUM_HOTBITS_CODES = 49;
+constexpr LookupTable<LookupTable<ZobristHash, NUM_HOTBITS_CODES>, 2> ZOBRIST_HOTBITS_CODES = {{
+    {{0xA4B992578B5B3456LL, 0xF330A30C9D0730D9LL, 0xB3E85D8D02B651F1LL, 0x573510FFF1D1F459LL, 0xED1AEE5209AF033DLL,
+      0xFA38FBC2CB4792E9LL, 0x36EFBF736EEF226BLL, 0x11FF729BC72587A6LL, 0xF76844CEE5CFFD46LL, 0x81B69742FDF65311LL,
+      0xF9B3F146F21B28FALL, 0x7B21F2EB7BDAB97ELL, 0xBCA3C499F196C1EBLL, 0x964031EBA47FBB2BLL, 0xF023A91ED963BA6ELL,
+      0x8BA8183A38D4B9D9LL, 0xFC03E2F903B3E48FLL, 0xB558C2B52F644F25LL, 0xF516A6AB6FCE4BB1LL, 0x33611E32EE3FC9D8LL,
+      0x9507F661546B9800LL, 0xDE593C442E032002LL, 0x83C2BD47E38ECEBFLL, 0xC8922212ECB30D57LL, 0xF813503AFE497776LL,
+      0x2B78DF97032DA10ELL, 0x2698FD5B97495A66LL, 0xB0CF0E39CC9A879ALL, 0x945C16AE586C10A2LL, 0xD5722B36A59F17FBLL,
+      0xCAEE5BD9374402FDLL, 0x2FAFC38E53C62926LL, 0xF0CA14E075B6FA38LL, 0x3F156942D16FB555LL, 0xB7A1962E378C4D9ALL,
+      0x1EF8EFCECC037F02LL, 0x1C9B68D26CD8FC4DLL, 0xDF06DE55036678C6LL, 0xBD0A763B7430BBABLL, 0xE415426270218010LL,
+      0xFE1AB2F22F514F39LL, 0x36956AC566C725BDLL, 0x34613723B5FCAB2FLL, 0x1B42202AB7A6744ELL, 0x24EAC324AD759F43LL,
+      0xC309A33D13C5955ALL, 0xFB1D0417BF02CCC0LL, 0x848ABD77A6C220D5LL, 0x4812B8944701C8E8LL}},
+    {{0xD9AE6A4E6583BD30LL, 0x70E216DD31C98AECLL, 0x339C23151BA2B545LL, 0xDC0A792B26A8721CLL, 0xA1850E0102E9BC19LL,
+      0x9EA4F6559019C42FLL, 0x30DC375B8402DE77LL, 0x24C417C393D2D28FLL, 0xB37BD74950098B48LL, 0x444D37D19D9F4CE8LL,
+      0x28DBCBF4DC921453LL, 0x4139983678F19AC4LL, 0x08196401FDDE3DD5LL, 0x4C6D89FDD450D209LL, 0xD15BF0A129B6C39FLL,
+      0xEE0E9FBB6AE450FBLL, 0xB747B112812BE75FLL, 0xCF4248576AFC6B91LL, 0xBD588171D1A0FA86LL, 0xC3018ABD5D4BA7E7LL,
+      0x2BC2E72AF052C597LL, 0xDAD519E74E02FC61LL, 0x48EF9808BF97BAF9LL, 0xD818E726BB5800F6LL, 0x3ACDB8D8C295B948LL,
+      0xE558506F1ECC9FA8LL, 0x8C54B57960C398B0LL, 0x0B47447208A63BC8LL, 0xF3E190A6E309C035LL, 0x6A338B19C28D810CLL,
+      0x975037209DE7C464LL, 0x44FFC7127AEB0CF2LL, 0xCAD98E38BF6E2439LL, 0xE21839E7F474A876LL, 0x8E133351F3A03746LL,
+      0x48A9006BFDD06CF1LL, 0x2326D156C5158C6DLL, 0xA439594E6AC0FBBFLL, 0x88DBB962A6A90167LL, 0x96538736374BD5C3LL,
+      0x90A43EBDEE961048LL, 0x70D451C2F0CFE557LL, 0x19064D64D8D4BEF8LL, 0x1CE9063FBADD8A20LL, 0x5D876EF94A5B67A1LL,
+      0x4699437680BAF525LL, 0xBA4F2292119B0FE1LL, 0xD1F06E24324D4786LL, 0x1DB29BC2DB4959FELL}}
+}};
+
+// A step of SplitMix64, for codes beyond the HotBits ones
+constexpr ZobristHash splitMix64(std::uint64_t x)
+{
+    x += 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+// A board of up to 7x7 takes as many of the HotBits codes as it needs; an
+// 8x8 one makes up the rest from them
+constexpr LookupTable<LookupTable<ZobristHash, NUM_SQUARES>, 2> makeZobristCodes()
+{
+    LookupTable<LookupTable<ZobristHash, NUM_SQUARES>, 2> codes = {};
+    for(int player_num = 0; player_num < 2; ++player_num) {
+        for(int square_num = 0; square_num < NUM_SQUARES; ++square_num) {
+            codes[player_num][square_num] = square_num < NUM_HOTBITS_CODES
+                ? ZOBRIST_HOTBITS_CODES[player_num][square_num]
+                : splitMix64(ZOBRIST_HOTBITS_CODES[player_num][square_num - NUM_HOTBITS_CODES]);
+        }
+    }
+    return codes;
+}
+
+constexpr LookupTable<LookupTable<ZobristHash, NUM_SQUARES>, 2> ZOBRIST_CODES = makeZobristCodes();
+
+// XORed into hash when it's player 2's turn
+const ZobristHash PLAYER2_TURN_CODE = 0x431D89EC63B226D7LL;
+
+// Games of more than two players (see multiplayer.hpp) hash players 1 and 2
+// as above; players 3 and 4 get codes of their own made from theirs
+constexpr LookupTable<LookupTable<ZobristHash, NUM_SQUARES>, MAX_PLAYERS> makeMultiZobristCodes()
+{
+    LookupTable<LookupTable<ZobristHash, NUM_SQUARES>, MAX_PLAYERS> codes = {};
+    for(int player_num = 0; player_num < MAX_PLAYERS; ++player_num) {
+        for(int square_num = 0; square_num < NUM_SQUARES; ++square_num) {
+            codes[player_num][square_num] = player_num < 2
+                ? ZOBRIST_CODES[player_num][square_num]
+                : splitMix64(ZOBRIST_CODES[player_num - 2][square_num] + player_num);
+        }
+    }
+    return codes;
+}
+
+constexpr LookupTable<LookupTable<ZobristHash, NUM_SQUARES>, MAX_PLAYERS> ZOBRIST_MULTI_CODES = makeMultiZobristCodes();
+
+// XORed into the hash when it's each player's turn. Players 1 and 2 have the
+// same codes as in calcHashBB.
+constexpr LookupTable<ZobristHash, MAX_PLAYERS> ZOBRIST_TURN_CODES = {{
+    0, PLAYER2_TURN_CODE, splitMix64(PLAYER2_TURN_CODE), splitMix64(PLAYER2_TURN_CODE + 1)
+}};
+
+// XORed into the hash for the number of players, so that a game of three
+// and one of four never share positions. Two players get 0, which makes a
+// two-player position hash the same as it does with calcHashBB.
+constexpr LookupTable<ZobristHash, MAX_PLAYERS + 1> ZOBRIST_NUM_PLAYERS_CODES = {{
+    0, 0, 0, splitMix64(PLAYER2_TURN_CODE + 2), splitMix64(PLAYER2_TURN_CODE + 3)
+}};
+
+// calcHashBB looks up the hash of each player's bitboard this many bits at a
+// time. 16-bit fragments mean fewer lookups, but the tables take 4 MB, which
+// crowds everything else out of L2. Since full hashes are only computed at the
+// root now (see updateHashBB), 8-bit fragments (28 KB of tables) are the
+// better deal. Must divide 64.
+// (16-bit tables take more compile-time evaluation than compilers allow by
+// default: build with -fconstexpr-ops-limit=1000000000 on GCC, or a higher
+// /constexpr:steps on MSVC.)
+const int ZOBRIST_FRAGMENT_BITS = 8;
+
+// What a capture does to the hash: the square leaves one player and joins the other
+constexpr LookupTable<ZobristHash, NUM_SQUARES> makeZobristFlipCodes()
+{
+    LookupTable<ZobristHash, NUM_SQUARES> flip_codes = {};
+    for(int square_num = 0; square_num < NUM_SQUARES; ++square_num) {
+        flip_codes[square_num] = ZOBRIST_CODES[0][square_num] ^ ZOBRIST_CODES[1][square_num];
+    }
+    return flip_codes;
+}
+
+constexpr LookupTable<ZobristHash, NUM_SQUARES> ZOBRIST_FLIP_CODES = makeZobristFlipCodes();
+
+// Works out the hash after a move from the hash before it and what the move
+// changed, which is cheaper than calcHashBB. me is 0 if player 1 moved, 1
+// if player 2 did. me_changed is every square that the mover gained or lost
+// (the piece placed, the source square vacated by a jump, and the captures);
+// captured is the squares taken from the opponent.
+inline ZobristHash updateHashBB(ZobristHash hash, int me, Bitboard me_changed, Bitboard captured)
+{
+    for(Bitboard bits = me_changed & ~captured; bits; bits &= bits - 1) {
+        hash ^= ZOBRIST_CODES[me][lowestSetSquare(bits)];
+    }
+    for(Bitboard bits = captured; bits; bits &= bits - 1) {
+        hash ^= ZOBRIST_FLIP_CODES[lowestSetSquare(bits)];
+    }
+    // The turn passes to the other player
+    return hash ^ PLAYER2_TURN_CODE;
+}
 
 #endif